@@ -0,0 +1,41 @@
+-- PassFlow migration: VARCHAR(30) event/segment times to DATETIME(3) with
+-- day partitioning (see database_schema.sql)
+-- Run once against an existing database:
+--   mysql buslocal < database_migrate_datetime.sql
+-- Existing rows go to partition p0 (everything before today); PassFlow
+-- trims p0 by date and creates the daily partitions from today on.
+
+USE buslocal;
+
+-- Native time columns; 'YYYY-MM-DD HH:MM:SS.mmm' strings convert as is
+ALTER TABLE events
+    MODIFY event_time DATETIME(3) NOT NULL COMMENT 'Timestamp of event',
+    DROP INDEX idx_event_type,
+    ADD INDEX idx_event_type_time (event_type, event_time),
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (id, event_time);
+
+ALTER TABLE video_segments
+    MODIFY start_time DATETIME(3) NOT NULL COMMENT 'Video segment start time',
+    MODIFY stop_time DATETIME(3) NOT NULL COMMENT 'Video segment stop time',
+    DROP INDEX idx_camera_id,
+    ADD INDEX idx_camera_start_time (camera_id, start_time),
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (id, start_time);
+
+-- Partition bounds must be constants: build the statements with today's date
+SET @p0 = TO_DAYS(CURDATE());
+
+SET @sql = CONCAT('ALTER TABLE events PARTITION BY RANGE (TO_DAYS(event_time)) (',
+                  'PARTITION p0 VALUES LESS THAN (', @p0, '), ',
+                  'PARTITION pmax VALUES LESS THAN MAXVALUE)');
+PREPARE stmt FROM @sql;
+EXECUTE stmt;
+DEALLOCATE PREPARE stmt;
+
+SET @sql = CONCAT('ALTER TABLE video_segments PARTITION BY RANGE (TO_DAYS(start_time)) (',
+                  'PARTITION p0 VALUES LESS THAN (', @p0, '), ',
+                  'PARTITION pmax VALUES LESS THAN MAXVALUE)');
+PREPARE stmt FROM @sql;
+EXECUTE stmt;
+DEALLOCATE PREPARE stmt;
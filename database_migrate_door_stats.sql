@@ -0,0 +1,20 @@
+-- PassFlow migration: add the door_stats summary table (see
+-- database_schema.sql) to a database created before it existed
+--   mysql buslocal < database_migrate_door_stats.sql
+
+USE buslocal;
+
+-- Door activity per door and time bucket (hourly by default), kept up to
+-- date by PassFlow as doors open and close; reports read these rows
+-- instead of scanning events. Not partitioned: one row per door and hour
+CREATE TABLE IF NOT EXISTS door_stats (
+    door INT NOT NULL COMMENT 'Door number',
+    bucket_start DATETIME NOT NULL COMMENT 'Start of the bucket (local time)',
+    bucket_seconds INT NOT NULL COMMENT 'Bucket length',
+    open_count INT NOT NULL DEFAULT 0 COMMENT 'Door openings starting in the bucket',
+    open_ms BIGINT NOT NULL DEFAULT 0 COMMENT 'Time the door was open within the bucket',
+    max_open_ms BIGINT NOT NULL DEFAULT 0 COMMENT 'Longest opening starting in the bucket',
+    cover_open_count INT NOT NULL DEFAULT 0 COMMENT 'Cover openings',
+    PRIMARY KEY (door, bucket_start, bucket_seconds),
+    INDEX idx_bucket_start (bucket_start)
+);
@@ -0,0 +1,10 @@
+-- PassFlow migration: record the encoder settings of each clip in
+-- video_segments (see database_schema.sql). Until this is applied PassFlow
+-- stores segments without them.
+--   mysql buslocal < database_migrate_transcode.sql
+
+USE buslocal;
+
+ALTER TABLE video_segments
+    ADD COLUMN IF NOT EXISTS encoding VARCHAR(64) NOT NULL DEFAULT '' COMMENT 'Encoder settings chosen for the clip'
+    AFTER filename;
@@ -0,0 +1,65 @@
+#ifndef CLIP_COALESCER_H
+#define CLIP_COALESCER_H
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "Timeline.h"
+
+// Turns raw door edges into clip windows, one per boarding:
+//  - an open shorter than the glitch threshold is dropped (bounce)
+//  - a window is held until its stop time; if the door re-opens before
+//    then, the next window is merged into it instead of emitted separately
+// Not thread-safe: driven from the MainControl receiver thread only.
+class ClipCoalescer {
+public:
+    struct Clip {
+        int door;
+        Timeline::Instant start;
+        Timeline::Instant stop;
+    };
+
+    struct Counters {
+        uint64_t emitted = 0;     // Clip windows handed to VideoControl
+        uint64_t merged = 0;      // Close edges folded into a pending window
+        uint64_t suppressed = 0;  // Open/close pairs dropped as glitches
+    };
+
+    explicit ClipCoalescer(std::chrono::milliseconds glitchThreshold = std::chrono::milliseconds(300));
+
+    void configure(int doors);
+    void setGlitchThreshold(std::chrono::milliseconds threshold) { glitchThreshold_ = threshold; }
+    std::chrono::milliseconds glitchThreshold() const { return glitchThreshold_; }
+
+    void doorOpened(int door, Timeline::Instant now);
+
+    // Returns false if the open period was dropped as a glitch
+    bool doorClosed(int door, Timeline::Instant now,
+                    std::chrono::seconds beginDelay, std::chrono::seconds endDelay);
+
+    // Windows whose stop time has passed while the door stayed closed
+    std::vector<Clip> poll(Timeline::Instant now);
+
+    // All pending windows, regardless of stop time (shutdown)
+    std::vector<Clip> flush();
+
+    // No door open and no window waiting to be polled
+    bool idle() const;
+
+    const Counters& counters() const { return counters_; }
+
+private:
+    struct DoorWindow {
+        bool open = false;
+        Timeline::Instant openTime;
+        bool pending = false;
+        Clip clip{};
+    };
+
+    std::vector<DoorWindow> doors_;
+    std::vector<Clip> ready_;  // Replaced pending windows not yet polled
+    std::chrono::milliseconds glitchThreshold_;
+    Counters counters_;
+};
+
+#endif // CLIP_COALESCER_H
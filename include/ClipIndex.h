@@ -0,0 +1,74 @@
+#ifndef CLIP_INDEX_H
+#define CLIP_INDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <limits>
+#include <cstdint>
+#include <chrono>
+#include <shared_mutex>
+
+// In-memory index of recorded files per camera: extracted clips (CamN) and
+// source recordings (CamNSource), each with the wall-clock span it covers.
+// Entries are kept sorted by start time together with the longest span in
+// the series, so an overlap query is a binary search plus a scan of the
+// hits (clips and sources are minutes long, never days). Thread-safe.
+class ClipIndex {
+public:
+    enum class Kind { Clip, Source };
+
+    struct Entry {
+        int cameraId;
+        Kind kind;
+        int64_t startUs;  // Wall time, microseconds since the epoch
+        int64_t endUs;    // OPEN_END while the source is still recording
+        std::string path;
+    };
+
+    static constexpr int64_t OPEN_END = std::numeric_limits<int64_t>::max();
+
+    static int64_t wallUs(std::chrono::system_clock::time_point tp);
+
+    // Door served by a camera, for door queries
+    void setCameraDoor(int cameraId, int doorId);
+    std::vector<int> camerasForDoor(int doorId) const;
+
+    void add(const Entry& entry);
+
+    // End an open source recording
+    void close(int cameraId, const std::string& path, int64_t endUs);
+
+    // Move the start of a source recording to its first sample (the file
+    // is created when ffmpeg is spawned, footage begins once it connects)
+    void setStart(int cameraId, const std::string& path, int64_t startUs);
+
+    // Entries of cameraId (-1 = all cameras) overlapping [fromUs, toUs],
+    // ordered by camera then start time
+    std::vector<Entry> query(int cameraId, int64_t fromUs, int64_t toUs, bool includeSources) const;
+
+    // Forget entries that ended before endUs (their files were cleaned up)
+    size_t removeBefore(int cameraId, Kind kind, int64_t endUs);
+
+    size_t size() const;
+
+    // Index the .mp4 files under dir (recursively). Clip names carry their
+    // start and stop time; source names their start time, with the end
+    // taken from the file's MP4 index. Returns the number of entries added.
+    size_t scanDirectory(int cameraId, Kind kind, const std::string& dir);
+
+private:
+    struct Series {
+        std::vector<Entry> entries;  // Sorted by startUs
+        int64_t maxSpanUs = 0;       // Longest closed entry
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::map<std::pair<int, Kind>, Series> series_;
+    std::map<int, int> cameraDoors_;
+
+    static void querySeries(const Series& series, int64_t fromUs, int64_t toUs, std::vector<Entry>& out);
+};
+
+#endif // CLIP_INDEX_H
@@ -0,0 +1,81 @@
+#ifndef CLIP_JOB_JOURNAL_H
+#define CLIP_JOB_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "Logger.h"
+
+// Append-only record of accepted clip requests ([ClipJobs] Journal), so
+// clips not yet cut when the daemon stops (crash, update, ignition off)
+// are cut at the next start.
+//
+// One line per event, tab separated, each written with a single append:
+//   Q camera door startUs stopUs output   request accepted
+//   S output                              extraction started
+//   D output                              finished (written, or given up)
+// Times are wall clock in microseconds since the epoch. A job is
+// unfinished while its Q line has no D line. The output name identifies
+// the job, so accepting the same clip twice or redoing a job is harmless.
+// A torn last line is ignored. open() rewrites the file with only the
+// unfinished jobs; at run time it is emptied once no job is outstanding
+// and it has grown past COMPACT_BYTES. A job started MAX_ATTEMPTS times
+// without finishing is given up, so a clip that takes the daemon down
+// cannot do so on every start. Thread-safe.
+class ClipJobJournal {
+public:
+    struct Job {
+        int cameraId = 0;
+        int doorId = 0;
+        int64_t startUs = 0;
+        int64_t stopUs = 0;
+        std::string outputFile;
+        int attempts = 0;  // Starts recorded before open()
+    };
+
+    static constexpr int MAX_ATTEMPTS = 3;
+    static constexpr int64_t COMPACT_BYTES = 64 * 1024;
+
+    explicit ClipJobJournal(std::shared_ptr<Logger> logger);
+    ~ClipJobJournal();
+
+    ClipJobJournal(const ClipJobJournal&) = delete;
+    ClipJobJournal& operator=(const ClipJobJournal&) = delete;
+
+    // Create the file, or read back and compact an existing one
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    // Unfinished jobs found by open(), oldest first; empties the list
+    std::vector<Job> takePending();
+
+    // Record a new request; false if a job for the same output is outstanding.
+    // The line is synced before returning unless deferSync is set, in
+    // which case the caller runs sync() off its own thread
+    bool accepted(const Job& job, bool deferSync = false);
+    // Sync the requests written since the last sync; one call covers
+    // every request accepted before it
+    void sync();
+    void started(const std::string& outputFile);
+    void finished(const std::string& outputFile);
+
+private:
+    std::shared_ptr<Logger> logger_;
+    mutable std::mutex mutex_;
+    std::mutex syncMutex_;   // Keeps fd_ open while sync() waits on the disk
+    std::string path_;
+    int fd_;
+    int64_t size_;
+    bool unsynced_;          // Requests written with a deferred sync
+    std::map<std::string, int> outstanding_;  // Output -> attempts
+    std::vector<Job> pending_;
+
+    bool appendLocked(const std::string& line, bool sync);
+    static std::string jobLine(const Job& job);
+};
+
+#endif // CLIP_JOB_JOURNAL_H
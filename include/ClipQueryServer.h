@@ -0,0 +1,47 @@
+#ifndef CLIP_QUERY_SERVER_H
+#define CLIP_QUERY_SERVER_H
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include "ClipIndex.h"
+#include "Logger.h"
+
+// Local query API over the clip index on a Unix stream socket. One request
+// per line, key=value words:
+//   door=N | camera=N          (default: all cameras)
+//   from=TIME to=TIME          or  at=TIME [window=SECONDS] (default 300)
+//   sources=1                  include source recordings
+// TIME is "YYYY-MM-DDTHH:MM:SS[.mmm]" or "HH:MM[:SS]" for today. The reply
+// is one line per file: camera, clip|source, start, end, path
+// (tab-separated), then "OK <count> <lookup microseconds>" or "ERR <reason>".
+class ClipQueryServer {
+private:
+    std::shared_ptr<Logger> logger_;
+    std::shared_ptr<ClipIndex> index_;
+    std::string socketPath_;
+    int listenFd_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+
+    void acceptLoop();
+    void serve(int fd);
+
+public:
+    static constexpr size_t MAX_REQUEST = 1024;
+
+    ClipQueryServer(std::shared_ptr<Logger> logger, std::shared_ptr<ClipIndex> index);
+    ~ClipQueryServer();
+
+    bool start(const std::string& socketPath);
+    void stop();
+
+    // Answer one request line (without the newline)
+    static std::string handle(const ClipIndex& index, const std::string& request);
+
+    // Client side: send request to the server at socketPath, return the reply
+    static bool query(const std::string& socketPath, const std::string& request, std::string& reply);
+};
+
+#endif // CLIP_QUERY_SERVER_H
@@ -0,0 +1,137 @@
+#ifndef CLIP_UPLOADER_H
+#define CLIP_UPLOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "Common.h"
+#include "Logger.h"
+#include "ConfigIni.h"
+
+// Background upload of finished clips to the depot over plain HTTP/1.1
+// ([Upload] URL). Each clip logged to video_segments is queued; up to
+// Concurrency connections send them in ChunkKB pieces, together held to
+// MaxKBps.
+//
+// Resumable protocol (after tus), one resource per clip at
+// <URL>/<source>/<CamN>/<date>/<file>:
+//   HEAD   -> 200 with "Upload-Offset: n", the bytes the depot holds;
+//             404 when it holds none
+//   PATCH  "Upload-Offset: n", "Upload-Length: size", the chunk as the
+//          body, "Upload-Checksum: crc32 <hex>" of the chunk and, with
+//          the last chunk, "Upload-CRC32: <hex>" of the whole file
+//          -> 204 with the new "Upload-Offset"; 409 (offset mismatch) or
+//             460 (checksum mismatch) with the depot's offset, from
+//             which the upload continues
+// Chunks go out with sendfile(); the CRC-32 is taken from the same page
+// cache pages through a read-only mapping, so clip data is never copied
+// through user space. The queue and the confirmed offset and running
+// CRC-32 of each started clip are kept in [Upload] State, so an upload
+// cut off by a lost link or a restart continues where the depot stopped.
+//
+// The power mode sets the pace: MaxKBps while Active, ParkedMaxKBps while
+// Parked, and nothing on Battery, where uploads stop after the chunk in
+// flight and continue from there on the next mode change.
+class ClipUploader
+{
+public:
+    struct Stats
+    {
+        uint64_t filesSent = 0;
+        uint64_t bytesSent = 0;      // Acknowledged by the depot
+        uint64_t filesDropped = 0;   // Missing locally or refused by the depot
+        uint64_t failures = 0;       // Connection or server errors, retried
+        size_t queued = 0;
+    };
+
+    static constexpr size_t SLICE_BYTES = 64 * 1024;  // Unit of the bandwidth cap
+    static constexpr std::chrono::seconds CONNECT_TIMEOUT{5};
+    static constexpr std::chrono::seconds IO_TIMEOUT{15};
+
+    explicit ClipUploader(std::shared_ptr<Logger> logger);
+    ~ClipUploader();
+
+    ClipUploader(const ClipUploader &) = delete;
+    ClipUploader &operator=(const ClipUploader &) = delete;
+
+    // Apply [Upload] (URL, Source, MaxKBps, ParkedMaxKBps, Concurrency,
+    // ChunkKB, RetrySeconds, State) and read back the saved queue
+    void configure(const ConfigIni &config);
+    bool enabled() const { return !host_.empty(); }
+
+    // Queue a finished clip (no-op when disabled or already queued)
+    void enqueue(const std::string &path);
+
+    void start();
+    void stop();
+
+    void setPowerMode(PowerMode mode);
+
+    Stats stats() const;
+
+private:
+    struct Item
+    {
+        std::string path;
+        int64_t offset = 0;   // Confirmed by the depot
+        uint32_t crc = 0;     // CRC-32 of the first offset bytes
+    };
+    struct Connection;  // Keep-alive HTTP connection, defined in ClipUploader.cpp
+    struct Response;
+
+    enum class Result { Done, Retry, Drop };
+
+    std::shared_ptr<Logger> logger_;
+
+    // [Upload] settings
+    std::string host_;
+    std::string port_;
+    std::string basePath_;
+    std::string source_;
+    int64_t bytesPerSecond_;        // 0: unlimited
+    int64_t parkedBytesPerSecond_;  // 0: unlimited
+    int concurrency_;
+    int64_t chunkBytes_;
+    std::chrono::seconds retryInterval_;
+    std::string statePath_;
+
+    mutable std::mutex mutex_;  // Guards everything below
+    std::condition_variable cv_;
+    std::deque<Item> queue_;
+    std::set<std::string> busy_;    // Paths being sent
+    std::set<int> sockets_;         // Open connections, shut down by stop()
+    bool running_;
+    PowerMode powerMode_;
+    std::chrono::steady_clock::time_point retryAt_;  // Depot unreachable until then
+    double tokens_;                                  // Bandwidth bucket, bytes
+    std::chrono::steady_clock::time_point refilledAt_;
+    Stats stats_;
+    std::string lastError_;
+    std::vector<std::thread> workers_;
+
+    void workerLoop();
+    Result upload(Connection &conn, Item &item);
+    bool request(Connection &conn, const std::string &method, const std::string &remote,
+                 const std::string &headers, int bodyFd, int64_t bodyOffset, int64_t bodyLength,
+                 Response &response);
+    bool openConnection(Connection &conn);
+    void closeConnection(Connection &conn);
+    bool acquireBandwidth(size_t bytes);
+    int64_t rateLocked() const;
+    bool waitWhilePaused();
+    void finishItemLocked(const Item &item, Result result);
+    void failed(const std::string &error);
+    void saveProgress(const Item &item, int64_t sentBytes);
+    void loadStateLocked();
+    void saveStateLocked(bool sync);
+    std::string remotePath(const std::string &path) const;
+};
+
+#endif // CLIP_UPLOADER_H
@@ -0,0 +1,74 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "Timeline.h"
+
+// Time source for component loops (polls, ticks, retention, clip timing).
+// Components get Clock::real() by default; replay and tests pass a
+// SimulatedClock so a day of traffic runs in seconds.
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    virtual Timeline::Instant now() const = 0;
+
+    // Wall-clock time for log lines, filenames and retention
+    virtual std::chrono::system_clock::time_point wallNow() const = 0;
+
+    virtual void sleepUntil(Timeline::Instant deadline) = 0;
+
+    // Condition variable wait bounded by a deadline on this clock;
+    // returns pred() at exit
+    virtual bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                           Timeline::Instant deadline, const std::function<bool()>& pred) = 0;
+
+    void sleepFor(Timeline::Clock::duration duration) { sleepUntil(now() + duration); }
+
+    bool waitFor(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                 Timeline::Clock::duration duration, const std::function<bool()>& pred) {
+        return waitUntil(lock, cv, now() + duration, pred);
+    }
+
+    // Shared process-wide real clock
+    static std::shared_ptr<Clock> real();
+};
+
+class RealClock : public Clock {
+public:
+    Timeline::Instant now() const override;
+    std::chrono::system_clock::time_point wallNow() const override;
+    void sleepUntil(Timeline::Instant deadline) override;
+    bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                   Timeline::Instant deadline, const std::function<bool()>& pred) override;
+};
+
+// Virtual time that moves only when advanced by its driver. Instants are on
+// the same timeline as the real clock, so they format to wall time normally.
+// Sleepers wake once the time passes their deadline; waiters on other
+// condition variables re-check the virtual deadline every millisecond.
+class SimulatedClock : public Clock {
+public:
+    explicit SimulatedClock(Timeline::Instant start);
+
+    Timeline::Instant now() const override;
+    std::chrono::system_clock::time_point wallNow() const override;
+    void sleepUntil(Timeline::Instant deadline) override;
+    bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv,
+                   Timeline::Instant deadline, const std::function<bool()>& pred) override;
+
+    // Move time forward (never backwards) and wake sleepers
+    void advanceTo(Timeline::Instant instant);
+    void advance(Timeline::Clock::duration duration);
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    Timeline::Instant now_;
+};
+
+#endif // CLOCK_H
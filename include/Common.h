@@ -8,10 +8,17 @@
 #include <sstream>
 #include <variant>
 #include <cstdint>
+#include <array>
+#include <optional>
+#include <cstdlib>
+#include <cstdio>
+#include "Timeline.h"
 
 // SystemStatus structure matching the USB protocol
 // Sent as 2 bytes: SystemStatus followed by ~SystemStatus (for validation)
 // Bit values: 0=OPENED/OFF, 1=CLOSED/ON
+// The bitfields below describe the default 2-door layout. Buses with more
+// doors remap the bits through StatusBitMap (see below).
 #pragma pack(push, 1)
 struct SystemStatus_t {
     uint8_t door_0      : 1;    // Door 0 state: 0=OPENED, 1=CLOSED
@@ -49,6 +56,46 @@ struct SystemStatus_t {
 };
 #pragma pack(pop)
 
+// Maximum number of doors addressable through the 8-bit status frame
+constexpr int MAX_DOORS = 8;
+
+// Meaning of a single bit in the SystemStatus byte
+enum class StatusBitKind : uint8_t {
+    Unused,
+    Door,        // 0=OPENED, 1=CLOSED
+    Cover,       // 0=OPENED, 1=CLOSED
+    MainSupply,  // 0=OFF, 1=ON
+    Ignition     // 0=OFF, 1=ON
+};
+
+struct StatusBitRole {
+    StatusBitKind kind = StatusBitKind::Unused;
+    uint8_t index = 0;  // Door/cover number for Door and Cover bits
+    
+    bool operator==(const StatusBitRole& other) const {
+        return kind == other.kind && index == other.index;
+    }
+    
+    bool operator!=(const StatusBitRole& other) const {
+        return !(*this == other);
+    }
+};
+
+// Bit number (0 = LSB) -> role
+using StatusBitMap = std::array<StatusBitRole, 8>;
+
+// Default layout matching the SystemStatus_t bitfields
+inline StatusBitMap defaultStatusBitMap() {
+    StatusBitMap map;
+    map[0] = {StatusBitKind::Door, 0};
+    map[1] = {StatusBitKind::Door, 1};
+    map[2] = {StatusBitKind::Cover, 0};
+    map[3] = {StatusBitKind::Cover, 1};
+    map[4] = {StatusBitKind::MainSupply, 0};
+    map[5] = {StatusBitKind::Ignition, 0};
+    return map;
+}
+
 // Legacy commands received from peripherals (kept for backward compatibility)
 enum class ReceivedCommand : uint8_t {
     Door0_Open = 0x01,
@@ -86,37 +133,95 @@ enum class PeripheralCommand : uint8_t {
     Light1ON = 0x1F,
     Light1OFF = 0x20,
     FanON = 0x21,
-    FanOFF = 0x22
+    FanOFF = 0x22,
+    Cam2ON = 0x23,
+    Cam2OFF = 0x24,
+    Cam3ON = 0x25,
+    Cam3OFF = 0x26,
+    Light2ON = 0x27,
+    Light2OFF = 0x28,
+    Light3ON = 0x29,
+    Light3OFF = 0x2A
+};
+
+// Camera and light commands belonging to one door
+struct DoorCommands {
+    PeripheralCommand camOn;
+    PeripheralCommand camOff;
+    PeripheralCommand lightOn;
+    PeripheralCommand lightOff;
 };
 
+// Peripheral commands for a door, if the peripheral board has outputs for it
+inline std::optional<DoorCommands> doorCommands(int door) {
+    static constexpr DoorCommands table[] = {
+        {PeripheralCommand::Cam0ON, PeripheralCommand::Cam0OFF,
+         PeripheralCommand::Light0ON, PeripheralCommand::Light0OFF},
+        {PeripheralCommand::Cam1ON, PeripheralCommand::Cam1OFF,
+         PeripheralCommand::Light1ON, PeripheralCommand::Light1OFF},
+        {PeripheralCommand::Cam2ON, PeripheralCommand::Cam2OFF,
+         PeripheralCommand::Light2ON, PeripheralCommand::Light2OFF},
+        {PeripheralCommand::Cam3ON, PeripheralCommand::Cam3OFF,
+         PeripheralCommand::Light3ON, PeripheralCommand::Light3OFF},
+    };
+    if (door < 0 || door >= static_cast<int>(sizeof(table) / sizeof(table[0]))) {
+        return std::nullopt;
+    }
+    return table[door];
+}
+
+// Power state of the bus, from the ignition and main supply bits
+enum class PowerMode : uint8_t {
+    Active,   // Ignition on, or a door used recently: full readiness
+    Parked,   // Ignition off, main supply on: recording paused, deferred work runs
+    Battery   // Ignition and main supply off: recording and uploads paused
+};
+
+inline const char* powerModeName(PowerMode mode) {
+    switch (mode) {
+    case PowerMode::Active:
+        return "Active";
+    case PowerMode::Parked:
+        return "Parked";
+    case PowerMode::Battery:
+        return "Battery";
+    }
+    return "Unknown";
+}
+
 // Inter-thread message types
 enum class MessageType {
     StartStop,
     PeripheralCommand,
+    PowerMode,
     Shutdown
 };
 
 // Structure for StartStop message
 struct StartStopMessage {
-    int cameraId;  // 0 or 1
-    std::chrono::system_clock::time_point startTime;
-    std::chrono::system_clock::time_point stopTime;
+    int doorId;  // Door whose cameras should produce the clip
+    Timeline::Instant startTime;
+    Timeline::Instant stopTime;
+};
+
+// Structure for PowerMode message
+struct PowerModeMessage {
+    PowerMode mode;
+    Timeline::Instant since;  // Status frame (or door edge) that caused the change
 };
 
 // Generic message structure
 struct Message {
     MessageType type;
-    std::variant<std::monostate, StartStopMessage, PeripheralCommand> data;
+    std::variant<std::monostate, StartStopMessage, PeripheralCommand, PowerModeMessage> data;
     
     Message() : type(MessageType::Shutdown), data(std::monostate{}) {}
     
-    static Message createStartStop(int camId, 
-                                   std::chrono::system_clock::time_point start,
-                                   std::chrono::system_clock::time_point stop) {
+    static Message createStartStop(int doorId, Timeline::Instant start, Timeline::Instant stop) {
         Message msg;
         msg.type = MessageType::StartStop;
         StartStopMessage ssMsg;
-        ssMsg.cameraId = camId;
+        ssMsg.doorId = doorId;
         ssMsg.startTime = start;
         ssMsg.stopTime = stop;
         msg.data = ssMsg;
@@ -130,6 +235,13 @@ struct Message {
         return msg;
     }
     
+    static Message createPowerMode(PowerMode mode, Timeline::Instant since) {
+        Message msg;
+        msg.type = MessageType::PowerMode;
+        msg.data = PowerModeMessage{mode, since};
+        return msg;
+    }
+    
     static Message createShutdown() {
         Message msg;
         msg.type = MessageType::Shutdown;
@@ -138,6 +250,18 @@ struct Message {
     }
 };
 
+// Monotonic reference point for boot timing; first called early in main()
+inline std::chrono::steady_clock::time_point processStartTime() {
+    static const auto start = std::chrono::steady_clock::now();
+    return start;
+}
+
+// Milliseconds elapsed since processStartTime()
+inline long long millisSinceStart() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - processStartTime()).count();
+}
+
 // Utility function to format timestamp
 inline std::string formatTimestamp(const std::chrono::system_clock::time_point& tp) {
     auto time_t = std::chrono::system_clock::to_time_t(tp);
@@ -150,6 +274,35 @@ inline std::string formatTimestamp(const std::chrono::system_clock::time_point&
     return ss.str();
 }
 
+// Format an instant of the internal timeline as wall-clock time
+inline std::string formatTimestamp(const Timeline::Instant& instant) {
+    return formatTimestamp(Timeline::toWall(instant));
+}
+
+// Parse local time "YYYY-MM-DD HH:MM:SS[.mmm]" as written by formatTimestamp();
+// the date/time separator may also be 'T' or '_' and the time separators '-'
+// (clip filenames)
+inline bool parseTimestamp(const std::string& text, std::chrono::system_clock::time_point& tp) {
+    std::tm tm{};
+    char sep[3];
+    int ms = 0;
+    int n = std::sscanf(text.c_str(), "%4d-%2d-%2d%c%2d%c%2d%c%2d.%3d",
+                        &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &sep[0], &tm.tm_hour,
+                        &sep[1], &tm.tm_min, &sep[2], &tm.tm_sec, &ms);
+    if (n < 9) {
+        return false;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    std::time_t time = std::mktime(&tm);
+    if (time == static_cast<std::time_t>(-1)) {
+        return false;
+    }
+    tp = std::chrono::system_clock::from_time_t(time) + std::chrono::milliseconds(n == 10 ? ms : 0);
+    return true;
+}
+
 // Utility function to get current date string
 inline std::string getCurrentDateString() {
     auto now = std::chrono::system_clock::now();
@@ -169,4 +322,37 @@ inline std::string getDatetimeFilename(const std::string& suffix) {
     return ss.str();
 }
 
+// Expand a leading '~' to $HOME
+inline std::string expandHomePath(const std::string& path) {
+    if (!path.empty() && path[0] == '~') {
+        const char* home = getenv("HOME");
+        if (home) {
+            return std::string(home) + path.substr(1);
+        }
+    }
+    return path;
+}
+
+// CRC-32 (IEEE 802.3) over a buffer; pass the previous result to continue
+inline uint32_t crc32(const void* data, size_t length, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
 #endif // COMMON_H
@@ -0,0 +1,31 @@
+#ifndef CONFIG_INI_H
+#define CONFIG_INI_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+// Minimal reader for ~/PassFlow/config.ini
+// Format: [Section] headers, "Key = Value" lines, '#' or ';' comments
+class ConfigIni {
+private:
+    std::map<std::string, std::map<std::string, std::string>> sections_;
+    std::string path_;
+
+public:
+    ConfigIni() = default;
+
+    // Load file; returns false if it cannot be opened (all getters then return defaults)
+    bool load(const std::string& path);
+
+    const std::string& path() const { return path_; }
+    bool hasSection(const std::string& section) const;
+    std::vector<std::string> sectionNames() const;
+
+    std::string getString(const std::string& section, const std::string& key,
+                          const std::string& defaultValue = "") const;
+    int getInt(const std::string& section, const std::string& key, int defaultValue) const;
+    bool getBool(const std::string& section, const std::string& key, bool defaultValue) const;
+};
+
+#endif // CONFIG_INI_H
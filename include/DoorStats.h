@@ -0,0 +1,49 @@
+#ifndef DOOR_STATS_H
+#define DOOR_STATS_H
+
+#include <map>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include "StorageBackend.h"
+
+// Door activity per door and time bucket (one hour by default, aligned to
+// local midnight), accumulated as edges arrive so reports read a handful
+// of summary rows instead of scanning events. takePending() hands out what
+// was added since the previous call, one delta record per touched bucket.
+// Not thread-safe: driven from the MainControl receiver thread only.
+class DoorStats {
+public:
+    explicit DoorStats(std::chrono::seconds bucket = std::chrono::hours(1));
+
+    // Bucket length; must divide a day (call before the first edge)
+    void setBucket(std::chrono::seconds bucket);
+    std::chrono::seconds bucket() const { return bucket_; }
+
+    // A completed open period. It counts in the bucket it started in; the
+    // open time is split over every bucket it spans
+    void doorOpenPeriod(int door, std::chrono::system_clock::time_point opened,
+                        std::chrono::system_clock::time_point closed);
+
+    void coverOpened(int cover, std::chrono::system_clock::time_point at);
+
+    std::vector<DoorStatsRecord> takePending();
+    bool empty() const { return pending_.empty(); }
+
+private:
+    struct Totals {
+        int openCount = 0;
+        int64_t openMs = 0;
+        int64_t maxOpenMs = 0;
+        int coverOpenCount = 0;
+    };
+
+    std::chrono::seconds bucket_;
+    std::map<std::pair<int, int64_t>, Totals> pending_;  // (door, bucket start ms) -> delta
+
+    // Start of the bucket containing ms (milliseconds since the epoch)
+    int64_t bucketStart(int64_t ms) const;
+};
+
+#endif // DOOR_STATS_H
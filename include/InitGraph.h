@@ -0,0 +1,57 @@
+#ifndef INIT_GRAPH_H
+#define INIT_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "Logger.h"
+
+// Startup dependency graph: each phase runs on its own thread as soon as
+// the phases it depends on have succeeded, and its timing is recorded for
+// the boot report.
+class InitGraph {
+public:
+    using Task = std::function<bool()>;
+
+private:
+    enum class State { Pending, Running, Done, Failed, Skipped };
+
+    struct Phase {
+        std::string name;
+        std::vector<std::string> deps;
+        Task task;
+        bool required;
+        State state = State::Pending;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+    };
+
+    std::shared_ptr<Logger> logger_;
+    std::vector<Phase> phases_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    const Phase* find(const std::string& name) const;
+    void runPhase(Phase* phase);
+    static const char* stateName(State state);
+
+public:
+    explicit InitGraph(std::shared_ptr<Logger> logger);
+
+    // Register a phase; a failed required phase makes run() return false.
+    // Phases depending on a failed phase are skipped.
+    void add(const std::string& name, std::vector<std::string> deps, Task task,
+             bool required = true);
+
+    // Run all phases, returns once every phase has finished or been skipped
+    bool run();
+
+    // Log start offset (relative to process start) and duration per phase
+    void logReport();
+};
+
+#endif // INIT_GRAPH_H
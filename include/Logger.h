@@ -7,22 +7,18 @@
 #include <filesystem>
 #include <chrono>
 #include "Common.h"
+#include "Clock.h"
 
 class Logger {
 private:
     std::ofstream logFile_;
     mutable std::mutex mutex_;
     std::string logDir_;
+    std::shared_ptr<Clock> clock_;
     
 public:
-    Logger(const std::string& logDir = "~/PassFlow/Log") : logDir_(logDir) {
-        // Expand ~ to home directory
-        if (logDir_[0] == '~') {
-            const char* home = getenv("HOME");
-            if (home) {
-                logDir_ = std::string(home) + logDir_.substr(1);
-            }
-        }
+    Logger(const std::string& logDir = "~/PassFlow/Log", std::shared_ptr<Clock> clock = Clock::real())
+        : logDir_(expandHomePath(logDir)), clock_(std::move(clock)) {
         
         // Create log directory if it doesn't exist
         std::filesystem::create_directories(logDir_);
@@ -45,7 +41,7 @@ public:
     // Log a command with timestamp
     void logCommand(const std::string& command) {
         std::lock_guard<std::mutex> lock(mutex_);
-        auto now = std::chrono::system_clock::now();
+        auto now = clock_->wallNow();
         logFile_ << formatTimestamp(now) << " - " << command << std::endl;
         logFile_.flush();
     }
@@ -53,15 +49,21 @@ public:
     // Log general message
     void log(const std::string& message) {
         std::lock_guard<std::mutex> lock(mutex_);
-        auto now = std::chrono::system_clock::now();
+        auto now = clock_->wallNow();
         logFile_ << formatTimestamp(now) << " - " << message << std::endl;
         logFile_.flush();
     }
     
+    // Flush buffered output to the file
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        logFile_.flush();
+    }
+    
     // Log error message
     void logError(const std::string& error) {
         std::lock_guard<std::mutex> lock(mutex_);
-        auto now = std::chrono::system_clock::now();
+        auto now = clock_->wallNow();
         logFile_ << formatTimestamp(now) << " - ERROR: " << error << std::endl;
         logFile_.flush();
     }
@@ -6,17 +6,51 @@
 #include <atomic>
 #include <memory>
 #include <map>
+#include <array>
+#include <vector>
 #include <chrono>
+#include <mutex>
 #include "Common.h"
 #include "MessageQueue.h"
 #include "Logger.h"
 #include "MySqlComm.h"
+#include "ClipCoalescer.h"
+#include "PowerPolicy.h"
+#include "DoorStats.h"
+#include "Clock.h"
+#include "Reactor.h"
+#include "StatusShm.h"
+#include "StatusJournal.h"
+
+// Per-door state tracked between open and close edges
+struct DoorState {
+    Timeline::Instant openTime;
+    bool open = false;
+    uint64_t opens = 0;
+};
+
+// Bits that changed between two status frames, resolved to their roles
+struct StatusChangeList {
+    uint8_t count = 0;
+    std::array<uint8_t, 8> bits{};
+    std::array<StatusBitRole, 8> roles{};
+};
+
+// Serial link losses and how long each took to recover, from the failed
+// read to the first valid status frame on the reopened port
+struct SerialLinkCounters {
+    uint64_t losses = 0;
+    uint64_t recoveries = 0;
+    int64_t lastRecoveryMs = 0;
+    int64_t maxRecoveryMs = 0;
+};
 
 class MainControl {
 private:
     std::shared_ptr<Logger> logger_;
     std::shared_ptr<MessageQueue<Message>> videoControlQueue_;
     std::shared_ptr<MySqlComm> dbComm_;
+    std::shared_ptr<Clock> clock_;
     MessageQueue<PeripheralCommand> outgoingQueue_;
     
     std::thread receiverThread_;
@@ -25,31 +59,90 @@ private:
     
     int serialFd_;
     std::string serialPort_;
+    std::mutex serialMutex_;  // Guards serialFd_ against the sender while reopening
+    
+    // Hotplug: a lost port is reopened when a ttyUSB node appears in /dev
+    // (inotify), with a timed retry in case the event is missed
+    int inotifyFd_;
+    bool linkUp_;
+    bool awaitingResync_;
+    Timeline::Instant linkLostAt_;
+    Timeline::Instant nextReopen_;
+    SerialLinkCounters linkCounters_;
     
-    // Door state tracking with timestamps
-    std::chrono::system_clock::time_point door0OpenTime_;
-    std::chrono::system_clock::time_point door1OpenTime_;
-    bool door0Open_ = false;
-    bool door1Open_ = false;
+    // Status byte waiting for its inverted copy
+    uint8_t pendingByte_;
+    bool havePendingByte_;
+    
+    // Reactor runtime: serial reads, ticks and writes on the loop thread
+    // instead of receiverThread_/senderThread_
+    Reactor* reactor_;
+    Reactor::TimerId tickTimer_;
+    Timeline::Instant nextResync_;
+    Timeline::Instant nextStatsFlush_;
+    
+    // Door state tracking with timestamps, indexed by door number
+    std::vector<DoorState> doors_;
+    
+    // SystemStatus bit layout and the dispatch table derived from it,
+    // indexed by (oldByte ^ newByte)
+    StatusBitMap statusBits_;
+    std::array<StatusChangeList, 256> dispatchTable_;
+    uint8_t ignitionMask_;    // 0: no ignition bit, power policy off
+    uint8_t mainSupplyMask_;  // 0: no main supply bit, taken as on
     
     // SystemStatus tracking
     SystemStatus_t currentStatus_;
     SystemStatus_t previousStatus_;
     
-    // Delays for video recording (read from DB)
-    int stopBeginDelay_ = 5;  // seconds before door open
-    int stopEndDelay_ = 5;    // seconds after door close
+    // Delays for video recording (read from DB, may change at runtime)
+    std::atomic<int> stopBeginDelay_{5};  // seconds before door open
+    std::atomic<int> stopEndDelay_{5};    // seconds after door close
+    
+    // Debounces door edges and merges overlapping clip windows
+    ClipCoalescer coalescer_;
+    
+    // Active / Parked / Battery from the ignition and main supply bits
+    PowerPolicy power_;
+    
+    // Per-door, per-bucket activity, flushed to door_stats every STATS_FLUSH_INTERVAL
+    DoorStats doorStats_;
+    
+    // Live status for other processes, republished on every frame
+    std::unique_ptr<StatusShmWriter> statusShm_;
+    uint64_t framesReceived_;
+    
+    // Binary history of status changes
+    std::unique_ptr<StatusJournal> journal_;
     
     // Private methods
-    bool findCH340Device();
-    bool openSerialPort();
+    bool findCH340Device(bool verbose = true);
+    bool openSerialPort(bool verbose = true);
     void configureSerialPort();
+    void watchDevices();
+    bool drainDeviceEvents();
+    void onLinkLost(const std::string& reason);
+    bool reopenSerialPort();
+    void watchSerial();
     void receiverLoop();
     void senderLoop();
+    int readSerial();
+    void tick(Timeline::Instant now);
+    void writeCommand(uint8_t byte);
+    void checkWallClock();
     
     // New SystemStatus processing
     void processSystemStatus(const SystemStatus_t& newStatus);
-    void compareAndLogChanges(const SystemStatus_t& oldStatus, const SystemStatus_t& newStatus);
+    void buildDispatchTable();
+    void handleStatusChange(const StatusBitRole& role, bool bitSet,
+                            Timeline::Instant now);
+    void onDoorOpened(int door, Timeline::Instant now);
+    void onDoorClosed(int door, Timeline::Instant now);
+    void emitClips(const std::vector<ClipCoalescer::Clip>& clips);
+    void flushStats();
+    void onPowerModeChanged(PowerMode from, const std::string& reason, Timeline::Instant now);
+    void armTick(std::chrono::milliseconds interval);
+    void publishStatus(Timeline::Instant now);
     bool validateStatusMessage(uint8_t status, uint8_t invStatus);
     
     // Legacy command processing (kept for compatibility)
@@ -57,20 +150,64 @@ private:
     std::string getCommandName(ReceivedCommand cmd);
     
 public:
+    static constexpr std::chrono::seconds STATS_FLUSH_INTERVAL{60};
+    // Clip windows are polled at this interval in the reactor runtime
+    static constexpr std::chrono::milliseconds TICK_INTERVAL{250};
+    // ...and in low power, where the threaded runtime also stops polling
+    // the serial port and sleeps until the next byte arrives
+    static constexpr std::chrono::milliseconds LOW_POWER_TICK{1000};
+    // Retry opening a lost port this often even without a /dev event
+    static constexpr std::chrono::milliseconds REOPEN_INTERVAL{500};
+    
     MainControl(std::shared_ptr<Logger> logger, 
                 std::shared_ptr<MessageQueue<Message>> videoControlQueue,
-                std::shared_ptr<MySqlComm> dbComm);
+                std::shared_ptr<MySqlComm> dbComm,
+                std::shared_ptr<Clock> clock = Clock::real());
     ~MainControl();
     
     bool initialize();
+    
+    // Run on reactor instead of own threads (call before start)
+    void setReactor(Reactor* reactor) { reactor_ = reactor; }
+    
     void start();
     void stop();
     
     // Send command to peripheral
     void sendCommand(PeripheralCommand cmd);
     
+    // Feed one SystemStatus frame without the serial port (log replay);
+    // the frame is stamped with the injected clock
+    void injectStatus(uint8_t status);
+    
+    // Emit clip windows that are due, or all of them when flushing
+    void pollClips(bool flush = false);
+    
+    const ClipCoalescer::Counters& clipCounters() const { return coalescer_.counters(); }
+    const SerialLinkCounters& linkCounters() const { return linkCounters_; }
+    PowerMode powerMode() const { return power_.mode(); }
+    
     // Update settings from database
     void updateSettings(int stopBeginDelay, int stopEndDelay);
+    
+    // Configure door count and SystemStatus bit layout (call before start)
+    void configureDoors(int doors, const StatusBitMap& statusBits);
+    
+    // Door open periods shorter than this are ignored (call before start)
+    void setGlitchThreshold(std::chrono::milliseconds threshold);
+    
+    // Enter low power after the ignition has been off this long; 0: never
+    // (call before start)
+    void setLowPowerAfter(std::chrono::seconds after);
+    
+    // Length of the door_stats buckets; must divide a day (call before start)
+    void setStatsBucket(std::chrono::seconds bucket);
+    
+    // Publish live status in the named shared-memory segment (call before start)
+    bool setStatusSharedMemory(const std::string& name);
+    
+    // Append status changes to a binary journal (call before start)
+    bool setStatusJournal(const std::string& path);
 };
 
 #endif // MAIN_CONTROL_H
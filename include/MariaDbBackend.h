@@ -0,0 +1,85 @@
+#ifndef MARIADB_BACKEND_H
+#define MARIADB_BACKEND_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+// Try different include paths for MySQL/MariaDB
+#if __has_include(<mariadb/mysql.h>)
+#include <mariadb/mysql.h>
+#elif __has_include(<mysql/mysql.h>)
+#include <mysql/mysql.h>
+#elif __has_include(<mysql.h>)
+#include <mysql.h>
+#else
+#error "MySQL/MariaDB header not found. Install libmariadb-dev or libmysqlclient-dev"
+#endif
+#include "StorageBackend.h"
+#include "Logger.h"
+#include "ConfigIni.h"
+
+// Storage on the local MariaDB server
+class MariaDbBackend : public StorageBackend
+{
+private:
+    std::shared_ptr<Logger> logger_;
+    MYSQL *connection_;
+    mutable std::mutex mutex_;
+
+    // Database connection parameters
+    std::string host_;
+    std::string user_;
+    std::string password_;
+    std::string database_;
+    unsigned int port_;
+
+    // video_segments.encoding exists (added by database_migrate_transcode.sql)
+    std::atomic<bool> segmentEncoding_;
+
+    bool executeQuery(const std::string &query, unsigned long long *affectedRows = nullptr);
+    MYSQL_RES *executeSelectQuery(const std::string &query);
+    bool rotatePartitions(const std::string &table, const std::string &column,
+                          const std::string &cutoff, const std::string &today);
+    std::string escapeString(const std::string &str);
+    void loadCameras(AppSettings &settings);
+    void loadStatusBits(AppSettings &settings);
+    void loadRemoteAddresses(AppSettings &settings);
+    void detectSchema();
+
+public:
+    // Day partitions are created this many days ahead
+    static constexpr int PARTITION_DAYS_AHEAD = 2;
+    // Rows deleted per statement where whole partitions cannot be dropped
+    static constexpr int DELETE_CHUNK = 5000;
+
+    MariaDbBackend(std::shared_ptr<Logger> logger);
+    ~MariaDbBackend();
+
+    // Apply [Database] Host/User/Password/Name/Port
+    void configure(const ConfigIni &config);
+
+    const char *name() const override { return "mariadb"; }
+
+    bool connect() override;
+    void disconnect() override;
+    bool hasConnection() const override;
+    bool isConnected() const override;
+
+    WriteStatus write(const StorageRecord &record) override;
+
+    bool loadSettings(AppSettings &settings, std::string &stamp) override;
+    bool readSettingsStamp(std::string &stamp) override;
+
+    bool readSince(RecordTable table, int64_t afterId, size_t limit,
+                   std::vector<StoredRecord> &rows) override;
+    bool lastId(RecordTable table, int64_t &id) override;
+    bool readDoorStats(const std::string &from, const std::string &to,
+                       std::vector<DoorStatsRecord> &rows) override;
+
+    bool applyRetention(std::chrono::system_clock::time_point cutoff,
+                        std::chrono::system_clock::time_point now) override;
+};
+
+#endif // MARIADB_BACKEND_H
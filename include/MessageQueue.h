@@ -5,7 +5,9 @@
 #include <mutex>
 #include <condition_variable>
 #include <optional>
+#include <functional>
 #include "Common.h"
+#include "Clock.h"
 
 template<typename T>
 class MessageQueue {
@@ -14,19 +16,47 @@ private:
     mutable std::mutex mutex_;
     std::condition_variable cv_;
     bool shutdown_ = false;
+    std::shared_ptr<Clock> clock_;
+    std::function<void()> pushListener_;
+
+    void notifyListener() {
+        std::function<void()> listener;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            listener = pushListener_;
+        }
+        if (listener) {
+            listener();
+        }
+    }
 
 public:
+    explicit MessageQueue(std::shared_ptr<Clock> clock = Clock::real()) : clock_(std::move(clock)) {}
+
     // Push message to queue
     void push(const T& message) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push(message);
-        cv_.notify_one();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push(message);
+            cv_.notify_one();
+        }
+        notifyListener();
     }
 
     void push(T&& message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push(std::move(message));
+            cv_.notify_one();
+        }
+        notifyListener();
+    }
+
+    // Called after every push, for consumers that wait in an event loop
+    // instead of in pop() (empty function to remove)
+    void setPushListener(std::function<void()> listener) {
         std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push(std::move(message));
-        cv_.notify_one();
+        pushListener_ = std::move(listener);
     }
 
     // Pop message from queue (blocking)
@@ -47,7 +77,7 @@ public:
     std::optional<T> tryPop(std::chrono::milliseconds timeout) {
         std::unique_lock<std::mutex> lock(mutex_);
         
-        if (!cv_.wait_for(lock, timeout, [this] { return !queue_.empty() || shutdown_; })) {
+        if (!clock_->waitFor(lock, cv_, timeout, [this] { return !queue_.empty() || shutdown_; })) {
             return std::nullopt;
         }
         
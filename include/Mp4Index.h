@@ -0,0 +1,77 @@
+#ifndef MP4INDEX_H
+#define MP4INDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+// Minimal ISO-BMFF (MP4) index reader
+// Maps the file read-only and walks moov/moof boxes in place to get
+// duration, creation time and keyframe timestamps without ffprobe.
+// Works on fragmented files that are still being written: a trailing
+// incomplete box is ignored.
+class Mp4Index {
+public:
+    struct Track {
+        uint32_t id = 0;
+        uint32_t timescale = 0;
+        std::string handler;            // "vide", "soun", ...
+        std::string codec;              // Sample entry type: "avc1", "hvc1", "mp4a", ...
+        uint16_t width = 0;
+        uint16_t height = 0;
+        std::vector<uint8_t> codecConfig; // avcC/hvcC record (SPS/PPS), empty if absent
+        uint64_t durationTicks = 0;     // From mdhd, or end of the last fragment
+        uint64_t sampleCount = 0;
+        uint64_t firstDecodeTicks = 0;   // Decode time of the first sample
+        std::vector<uint64_t> keyframes; // Decode times in track ticks
+
+        // Defaults from trex, used by fragments
+        uint32_t defaultSampleDuration = 0;
+        uint32_t defaultSampleFlags = 0;
+    };
+
+    bool open(const std::string& path);
+
+    const std::string& error() const { return error_; }
+    bool fragmented() const { return fragments_ > 0; }
+    size_t fragmentCount() const { return fragments_; }
+    const std::map<uint32_t, Track>& tracks() const { return tracks_; }
+
+    // First video track, nullptr if there is none
+    const Track* videoTrack() const;
+
+    // Longest track duration in microseconds
+    int64_t durationUs() const;
+    // Unix time of mvhd creation_time in microseconds, 0 if not set
+    int64_t creationTimeUs() const;
+    // Decode time of the first video sample in microseconds; the
+    // timeline of the file starts here
+    int64_t firstSampleUs() const;
+    // Keyframe timestamps of the video track in microseconds
+    std::vector<int64_t> keyframesUs() const;
+    // Latest keyframe at or before the given offset, 0 if none
+    int64_t keyframeAtOrBefore(int64_t offsetUs) const;
+
+private:
+    std::string error_;
+    uint32_t movieTimescale_ = 0;
+    uint64_t movieDuration_ = 0;
+    uint64_t creationTime_ = 0;     // Seconds since 1904-01-01
+    size_t fragments_ = 0;
+    uint64_t maxSamples_ = 0;       // Per track, bounded by the file size
+    std::map<uint32_t, Track> tracks_;
+
+    // Decode time where the next fragment of each track continues
+    // when it carries no tfdt box
+    std::map<uint32_t, uint64_t> fragmentEnd_;
+
+    void parseBoxes(const uint8_t* begin, const uint8_t* end, Track* track);
+    void parseTraf(const uint8_t* begin, const uint8_t* end);
+    void parseSampleTable(const uint8_t* stts, const uint8_t* sttsEnd,
+                          const uint8_t* stss, const uint8_t* stssEnd, Track& track);
+    static int64_t toUs(uint64_t ticks, uint32_t timescale);
+};
+
+#endif // MP4INDEX_H
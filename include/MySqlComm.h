@@ -5,29 +5,17 @@
 #include <vector>
 #include <memory>
 #include <mutex>
-// Try different include paths for MySQL/MariaDB
-#if __has_include(<mariadb/mysql.h>)
-#include <mariadb/mysql.h>
-#elif __has_include(<mysql/mysql.h>)
-#include <mysql/mysql.h>
-#elif __has_include(<mysql.h>)
-#include <mysql.h>
-#else
-#error "MySQL/MariaDB header not found. Install libmariadb-dev or libmysqlclient-dev"
-#endif
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
 #include "Logger.h"
-
-// Application settings read from database
-struct AppSettings
-{
-    int doors;                                  // Number of doors (and cameras)
-    int stopBeginDelay;                         // Seconds before DOOR_OPEN to start video
-    int stopEndDelay;                           // Seconds after DOOR_CLOSE to stop video
-    int daysBeforeDeleteVideo;                  // Days to keep video files
-    std::string cam0String;                     // Connection string for Camera 0
-    std::string cam1String;                     // Connection string for Camera 1
-    std::vector<std::string> remoteDBAddresses; // Remote DB addresses for replication
-};
+#include "ConfigIni.h"
+#include "StorageBackend.h"
+#include "Replicator.h"
+#include "ClipUploader.h"
 
 // SystemStatus structure matching the USB protocol
 // Sent as 2 bytes: SystemStatus followed by ~SystemStatus
@@ -44,69 +32,150 @@ struct AppSettings
 #pragma pack(pop)
 
 // Event types for logging to database
+// Door and cover events carry the door/cover number separately
 enum class EventType
 {
-    Door0Open,
-    Door0Close,
-    Door1Open,
-    Door1Close,
-    Cover0Open,
-    Cover0Close,
-    Cover1Open,
-    Cover1Close,
+    DoorOpen,
+    DoorClose,
+    CoverOpen,
+    CoverClose,
     MainSupplyOn,
     MainSupplyOff,
     IgnitionOn,
     IgnitionOff
 };
 
+// Database access for the rest of PassFlow: settings snapshots, event and
+// segment logging. The database itself is a StorageBackend (MariaDB or
+// embedded SQLite) chosen by configure().
 class MySqlComm
 {
 private:
     std::shared_ptr<Logger> logger_;
-    MYSQL *connection_;
-    mutable std::mutex mutex_;
+    std::unique_ptr<StorageBackend> backend_;
+    std::unique_ptr<Replicator> replicator_;  // Pushes events/segments to remoteDB
+    ClipUploader uploader_;                   // Sends logged clips to the depot
+    mutable std::mutex mutex_;  // Serializes writes and the spool
 
-    // Database connection parameters
-    std::string host_;
-    std::string user_;
-    std::string password_;
-    std::string database_;
-    unsigned int port_;
+    std::string cachePath_;  // Local binary settings cache
 
-    // Cached settings
-    AppSettings settings_;
-    bool settingsLoaded_;
+    // Writes issued while the database is unreachable
+    static constexpr size_t MAX_PENDING_WRITES = 10000;
+    std::deque<StorageRecord> pendingWrites_;
+    size_t droppedWrites_ = 0;
+
+public:
+    // Called with (previous, current) snapshot whenever settings are republished
+    using SettingsListener = std::function<void(const std::shared_ptr<const AppSettings> &,
+                                                const std::shared_ptr<const AppSettings> &)>;
+
+private:
+    // Current settings snapshot. Snapshots are immutable and replaced as a
+    // whole (RCU style): readers atomically grab the pointer and never lock.
+    std::shared_ptr<const AppSettings> settings_;
+    std::string settingsStamp_;  // settings.updated_at of the published snapshot
+    std::vector<SettingsListener> listeners_;
+    std::mutex listenerMutex_;
+
+    // Background watcher polling settings.updated_at
+    std::thread watcherThread_;
+    std::mutex watcherMutex_;
+    std::condition_variable watcherCv_;
+    std::atomic<bool> watcherRunning_;
 
     // Private methods
     bool connect();
     void disconnect();
-    bool executeQuery(const std::string &query);
-    MYSQL_RES *executeSelectQuery(const std::string &query);
-    std::string escapeString(const std::string &str);
-    std::string eventTypeToString(EventType event);
+    bool writeRecord(const StorageRecord &record);
+    std::string eventTypeToString(EventType event, int index);
+    void publishSettings(std::shared_ptr<const AppSettings> next, const std::string &stamp);
+    bool settingsChanged();
+    void spoolWrite(const StorageRecord &record);
+    void settingsWatcherLoop(std::chrono::seconds interval);
+
+    static constexpr std::chrono::seconds RECONNECT_INTERVAL{2};
+    static constexpr std::chrono::minutes RETENTION_INTERVAL{30};
+
+    std::mutex retentionMutex_;
+    std::chrono::steady_clock::time_point lastRetention_;
 
 public:
     MySqlComm(std::shared_ptr<Logger> logger);
     ~MySqlComm();
 
+    // Apply [Database] section of config.ini (backend, connection, cache path)
+    // [Replication] and [Upload]
+    void configure(const ConfigIni &config);
+
+    // Name of the active storage backend
+    const char *backendName() const { return backend_->name(); }
+
     // Initialize connection to database
     bool initialize();
 
+    // Publish settings from the local cache, or from config.ini when there is
+    // no cache. Returns false if neither yields a usable camera.
+    bool loadLocalSettings(const ConfigIni &config);
+
+    // Replay writes spooled while the database was unreachable and make
+    // buffered backend writes durable
+    size_t flushPendingWrites();
+    size_t pendingWriteCount() const;
+
     // Load all settings from database
     bool loadSettings();
 
-    // Get cached settings
-    const AppSettings &getSettings() const { return settings_; }
+    // Get the current settings snapshot (lock-free, safe to keep)
+    std::shared_ptr<const AppSettings> getSettings() const { return std::atomic_load(&settings_); }
+
+    // Register a callback for settings reloads (runs on the watcher thread)
+    void addSettingsListener(SettingsListener listener);
+
+    // Connect in the background if needed, then poll settings.updated_at
+    // and republish settings when it changes
+    void startSettingsWatcher(std::chrono::seconds interval);
+    void stopSettingsWatcher();
+
+    // Replicate new events and video segments to the remoteDB addresses
+    // in the background; replicateOnce() runs a single pass in the caller
+    void startReplication();
+    void stopReplication();
+    bool replicateOnce();
+    std::vector<Replicator::RemoteStatus> replicationStatus() const;
+
+    // Upload clips logged with logVideoSegment() to the [Upload] depot in
+    // the background (no-op without a URL)
+    void startUploads();
+    void stopUploads();
+    ClipUploader::Stats uploadStats() const;
 
-    // Log event to database
-    bool logEvent(EventType event, const std::string &timestamp);
+    // Pace uploads for the bus power mode; entering low power also makes
+    // spooled and buffered writes durable while there is still power
+    void setPowerMode(PowerMode mode);
+
+    // Drop events and video segments older than days (called with the
+    // video file cleanup; runs at most once per RETENTION_INTERVAL)
+    void applyRetention(int days, std::chrono::system_clock::time_point now);
+
+    // Stored video segments with id > afterId, for rebuilding the clip index
+    bool readVideoSegments(int64_t afterId, size_t limit, std::vector<StoredRecord> &rows);
+
+    // Log event to database (index = door/cover number, ignored otherwise)
+    bool logEvent(EventType event, int index, const std::string &timestamp);
 
     // Log video segment info to database
     bool logVideoSegment(int cameraId,
                          const std::string &startTime,
                          const std::string &stopTime,
-                         const std::string &filename);
+                         const std::string &filename,
+                         const std::string &encoding = "");
+
+    // Add door activity deltas to the door_stats summary
+    bool logDoorStats(const std::vector<DoorStatsRecord> &records);
+
+    // Summary rows with from <= bucket_start < to
+    bool readDoorStats(const std::string &from, const std::string &to,
+                       std::vector<DoorStatsRecord> &rows);
 
     // Check connection status
     bool isConnected() const;
@@ -0,0 +1,64 @@
+#ifndef POWER_POLICY_H
+#define POWER_POLICY_H
+
+#include <string>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "Common.h"
+#include "Timeline.h"
+
+// Power mode of the bus from the ignition and main supply bits:
+//  - Active while the ignition is on; ignition ON switches back at once
+//  - once the ignition has been off for lowPowerAfter with no door used,
+//    Parked (main supply on) or Battery (main supply off)
+// Door use counts as activity: a door opening brings a parked bus back
+// to Active, which lasts until lowPowerAfter past the end of its clip
+// window, so boarding with the engine off is still recorded. Until the first frame the bus is
+// Active. Not thread-safe: driven from the MainControl receiver thread only.
+class PowerPolicy {
+public:
+    // Target from the ignition ON frame to every camera recording again
+    static constexpr std::chrono::seconds WAKE_LATENCY{3};
+
+    explicit PowerPolicy(std::chrono::seconds lowPowerAfter = std::chrono::seconds(120));
+
+    // 0 keeps the bus Active whatever the ignition does
+    void setLowPowerAfter(std::chrono::seconds after) { lowPowerAfter_ = after; }
+    std::chrono::seconds lowPowerAfter() const { return lowPowerAfter_; }
+
+    // Each of these returns true if the mode changed
+
+    // Current ignition and main supply state, on every status frame
+    bool update(bool ignition, bool mainSupply, Timeline::Instant now);
+
+    // A door was opened, or is open or has a clip window pending
+    bool activity(Timeline::Instant now);
+
+    // Enter low power once the ignition has been off long enough
+    bool poll(Timeline::Instant now);
+
+    PowerMode mode() const { return mode_; }
+    bool lowPower() const { return mode_ != PowerMode::Active; }
+    bool ignition() const { return ignition_; }
+    bool mainSupply() const { return mainSupply_; }
+
+    // Time spent in each mode and number of wakes, for the stop log
+    std::string summary(Timeline::Instant now) const;
+
+private:
+    std::chrono::seconds lowPowerAfter_;
+    PowerMode mode_;
+    Timeline::Instant since_;     // Of the current mode
+    Timeline::Instant idleSince_; // Ignition OFF edge or last door activity
+    bool started_;
+    bool ignition_;
+    bool mainSupply_;
+    std::array<std::chrono::milliseconds, 3> timeIn_;
+    uint64_t wakes_;
+
+    PowerMode target(Timeline::Instant now) const;
+    bool apply(Timeline::Instant now);
+};
+
+#endif // POWER_POLICY_H
@@ -0,0 +1,35 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/types.h>
+
+// Child process helpers used for ffmpeg. Children are started directly
+// (no shell), with a clean signal mask, so they can be signalled and
+// reaped by pid.
+namespace Process {
+
+// Start args[0] with args; stdin is /dev/null. Returns pid or -1.
+// A positive niceness runs the child that much below the daemon's CPU
+// priority and at the lowest best-effort I/O priority.
+pid_t spawn(const std::vector<std::string>& args, int niceness = 0);
+
+// Non-blocking: true if the child has exited (and reaps it)
+bool hasExited(pid_t pid, int* exitStatus = nullptr);
+
+// Wait until the child exits or the deadline passes; true if it exited
+bool waitUntil(pid_t pid, std::chrono::steady_clock::time_point deadline,
+               int* exitStatus = nullptr);
+
+// Ask the child to finish (signal), wait up to the deadline, then SIGKILL.
+// Returns true if it exited before the deadline.
+bool stop(pid_t pid, int signal, std::chrono::steady_clock::time_point deadline);
+
+// Run to completion and return the exit status (-1 if it could not start)
+int run(const std::vector<std::string>& args, int niceness = 0);
+
+}
+
+#endif // PROCESS_H
@@ -0,0 +1,88 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <csignal>
+#include <sys/types.h>
+#include "Logger.h"
+
+// Single-threaded event loop on epoll for the reactor runtime
+// ([System] Runtime = reactor). Readable descriptors, timers (timerfd),
+// signals (signalfd), child exits (pidfd) and callbacks posted from other
+// threads (eventfd) are all dispatched on the thread that calls run().
+// Registration is thread-safe; callbacks must not block for long.
+class Reactor {
+public:
+    using Callback = std::function<void()>;
+    using FdCallback = std::function<void(uint32_t events)>;
+    using TimerId = int;
+
+    explicit Reactor(std::shared_ptr<Logger> logger);
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // False if epoll/eventfd could not be created
+    bool valid() const { return epollFd_ >= 0 && wakeFd_ >= 0; }
+
+    // Level-triggered; the fd stays owned by the caller
+    bool addFd(int fd, uint32_t events, FdCallback callback);
+    void removeFd(int fd);
+
+    // Fire at when (steady clock), then every interval if it is non-zero.
+    // Returns -1 on failure
+    TimerId addTimer(std::chrono::steady_clock::time_point when, Callback callback,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(0));
+    void cancelTimer(TimerId id);
+
+    // Deliver signals (already blocked in every thread) through signalfd
+    bool addSignals(const sigset_t& signals, std::function<void(int)> callback);
+
+    // Call callback once after pid has exited (the child is not reaped).
+    // Uses pidfd; on kernels without it the exit is polled once a second
+    bool watchChild(pid_t pid, Callback callback);
+
+    // Run callback on the loop thread (thread-safe)
+    void post(Callback callback);
+
+    // Dispatch until stop()
+    void run();
+    void stop();
+
+    bool inLoopThread() const { return std::this_thread::get_id() == loopThread_.load(); }
+
+private:
+    struct Handler {
+        FdCallback callback;
+        bool ownsFd;          // Timer, signal and pidfd descriptors are closed on removal
+        uint32_t generation;  // Of this registration, carried in its epoll events
+    };
+
+    std::shared_ptr<Logger> logger_;
+    int epollFd_;
+    int wakeFd_;
+    std::atomic<bool> running_;
+    std::atomic<std::thread::id> loopThread_;
+
+    std::mutex mutex_;
+    std::map<int, std::shared_ptr<Handler>> handlers_;  // By fd
+    std::map<TimerId, int> timers_;                     // Timer id -> timerfd
+    TimerId nextTimerId_;
+    uint32_t nextGeneration_;
+    std::vector<Callback> posted_;
+
+    bool add(int fd, uint32_t events, FdCallback callback, bool ownsFd);
+    void remove(int fd);
+    void runPosted();
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,20 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <string>
+#include "ConfigIni.h"
+
+// Offline replay of a recorded service day. SystemStatus frames are read
+// from a status journal or a PassFlow log ("Received valid SystemStatus:
+// 0xNN" lines) and fed through MainControl on a SimulatedClock, so door
+// edges, debouncing and clip windows run exactly as live but as fast as
+// the CPU allows.
+// No serial port, cameras or database are touched.
+namespace Replay {
+
+// Prints a summary of the clip requests produced; returns the exit code
+int run(const std::string& logPath, const ConfigIni& config);
+
+} // namespace Replay
+
+#endif // REPLAY_H
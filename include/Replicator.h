@@ -0,0 +1,97 @@
+#ifndef REPLICATOR_H
+#define REPLICATOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "StorageBackend.h"
+#include "Logger.h"
+#include "ConfigIni.h"
+
+// Incremental replication of 'events' and 'video_segments' to every
+// remoteDB address (the depot, a MariaDB server). Each remote keeps a
+// high-water mark per table in its 'replication_state' table, written in
+// the same transaction as the rows, so a batch is applied exactly once
+// even when the link drops mid-batch or PassFlow restarts.
+class Replicator
+{
+public:
+    // Per-remote progress
+    struct RemoteStatus
+    {
+        std::string address;
+        bool connected = false;
+        int64_t eventsMark = 0;      // Last events.id on the remote
+        int64_t segmentsMark = 0;    // Last video_segments.id on the remote
+        int64_t rowsBehind = -1;     // Local rows not yet on the remote (-1 = unknown)
+        int64_t lagSeconds = -1;     // How long the remote has been behind (0 = caught up, -1 = unknown)
+        uint64_t rowsPushed = 0;     // Since start
+        std::string lastError;
+    };
+
+private:
+    struct Remote;  // Connection and marks, defined in Replicator.cpp
+
+    std::shared_ptr<Logger> logger_;
+    StorageBackend &local_;
+
+    // [Replication] settings
+    std::string source_;          // Identifies this bus in replication_state
+    std::string user_;
+    std::string password_;
+    std::string database_;
+    unsigned int port_;
+    size_t batchSize_;
+    std::chrono::seconds interval_;
+
+    std::vector<std::unique_ptr<Remote>> remotes_;  // Owned by the syncing thread
+    mutable std::mutex statusMutex_;                // Guards the fields below
+    std::vector<std::string> addresses_;            // Latest remoteDB addresses
+    bool addressesChanged_;
+    std::vector<RemoteStatus> status_;
+
+    std::mutex syncMutex_;  // One pass at a time
+    std::thread thread_;
+    std::mutex threadMutex_;
+    std::condition_variable threadCv_;
+    bool running_;
+    std::atomic<bool> stopRequested_;  // Ends a pass between batches
+
+    void applyAddresses();
+    bool connectRemote(Remote &remote);
+    bool syncRemote(Remote &remote);
+    void updateLag(Remote &remote);
+    bool pushBatch(Remote &remote, RecordTable table, const std::vector<StoredRecord> &rows);
+    void publishStatus();
+    void threadLoop();
+
+public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1000;
+
+    Replicator(std::shared_ptr<Logger> logger, StorageBackend &local);
+    ~Replicator();
+
+    // Apply [Replication] (Source, User, Password, Name, Port, BatchSize,
+    // IntervalSeconds); credentials default to the [Database] ones
+    void configure(const ConfigIni &config);
+
+    // Replace the remote list (from the remoteDB table); takes effect on the next pass
+    void setRemotes(const std::vector<std::string> &addresses);
+
+    // Push to every reachable remote until caught up; true if all are
+    bool syncOnce();
+
+    // Run syncOnce() every interval in the background
+    void start();
+    void stop();
+
+    std::vector<RemoteStatus> status() const;
+};
+
+#endif // REPLICATOR_H
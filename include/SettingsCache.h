@@ -0,0 +1,24 @@
+#ifndef SETTINGS_CACHE_H
+#define SETTINGS_CACHE_H
+
+#include <string>
+#include "MySqlComm.h"
+
+// Local binary copy of the last settings read from the database, so the
+// service can start recording before MariaDB is reachable.
+//
+// File layout (all integers little-endian):
+//   "PFSC" | u16 version | u16 reserved | u32 payload size | u32 payload CRC-32 | payload
+class SettingsCache {
+public:
+    static constexpr uint16_t FORMAT_VERSION = 1;
+
+    // Write settings atomically (temp file + rename); stamp is settings.updated_at
+    static bool save(const std::string& path, const AppSettings& settings,
+                     const std::string& stamp);
+
+    // Read settings; fails on missing file, wrong version or bad checksum
+    static bool load(const std::string& path, AppSettings& settings, std::string& stamp);
+};
+
+#endif // SETTINGS_CACHE_H
@@ -0,0 +1,41 @@
+#ifndef SHUTDOWN_COORDINATOR_H
+#define SHUTDOWN_COORDINATOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include "Logger.h"
+
+// Runs shutdown tasks under one global deadline (ignition-off leaves only a
+// few seconds of supercap power). Tasks with the same priority run in
+// parallel; lower priority values run first. Tasks still running when the
+// deadline passes are abandoned and reported.
+class ShutdownCoordinator {
+public:
+    using Deadline = std::chrono::steady_clock::time_point;
+    // Returns false if the task could not complete its work
+    using Task = std::function<bool(Deadline)>;
+
+private:
+    struct Entry {
+        std::string name;
+        int priority;
+        Task task;
+    };
+
+    std::shared_ptr<Logger> logger_;
+    std::vector<Entry> entries_;
+
+public:
+    explicit ShutdownCoordinator(std::shared_ptr<Logger> logger);
+
+    void add(const std::string& name, int priority, Task task);
+
+    // Run everything within budget; returns the names of tasks that failed,
+    // timed out or were never started
+    std::vector<std::string> run(std::chrono::milliseconds budget);
+};
+
+#endif // SHUTDOWN_COORDINATOR_H
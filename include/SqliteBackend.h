@@ -0,0 +1,81 @@
+#ifndef SQLITE_BACKEND_H
+#define SQLITE_BACKEND_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <chrono>
+#include <sqlite3.h>
+#include "StorageBackend.h"
+#include "Logger.h"
+#include "ConfigIni.h"
+
+// Embedded storage in a single SQLite file (WAL mode). Writes are queued
+// and committed by a writer thread in batched transactions through
+// prepared statements, so a burst of events costs one fsync.
+class SqliteBackend : public StorageBackend
+{
+private:
+    std::shared_ptr<Logger> logger_;
+    std::string path_;
+    sqlite3 *db_;
+    sqlite3_stmt *insertEvent_;
+    sqlite3_stmt *insertSegment_;
+    sqlite3_stmt *upsertDoorStats_;
+    mutable std::mutex dbMutex_;  // Guards db_ and the statements
+
+    // Write queue drained by the writer thread
+    std::deque<StorageRecord> queue_;
+    size_t inFlight_;             // Records taken by the writer, not yet committed
+    size_t failedWrites_;
+    bool writerRunning_;
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    std::condition_variable idleCv_;
+    std::thread writerThread_;
+
+    void writerLoop();
+    bool commitBatch(const std::deque<StorageRecord> &batch);
+    bool exec(const char *sql);
+    bool createSchema();
+
+public:
+    // Writes arriving within this window share one transaction
+    static constexpr std::chrono::milliseconds BATCH_WINDOW{50};
+    static constexpr size_t MAX_BATCH = 512;
+    // Rows deleted per statement by retention
+    static constexpr int DELETE_CHUNK = 5000;
+
+    SqliteBackend(std::shared_ptr<Logger> logger);
+    ~SqliteBackend();
+
+    // Apply [Database] SqlitePath
+    void configure(const ConfigIni &config);
+
+    const char *name() const override { return "sqlite"; }
+
+    bool connect() override;
+    void disconnect() override;
+    bool hasConnection() const override;
+    bool isConnected() const override;
+
+    WriteStatus write(const StorageRecord &record) override;
+    bool flush() override;
+
+    bool loadSettings(AppSettings &settings, std::string &stamp) override;
+    bool readSettingsStamp(std::string &stamp) override;
+
+    bool readSince(RecordTable table, int64_t afterId, size_t limit,
+                   std::vector<StoredRecord> &rows) override;
+    bool lastId(RecordTable table, int64_t &id) override;
+    bool readDoorStats(const std::string &from, const std::string &to,
+                       std::vector<DoorStatsRecord> &rows) override;
+
+    bool applyRetention(std::chrono::system_clock::time_point cutoff,
+                        std::chrono::system_clock::time_point now) override;
+};
+
+#endif // SQLITE_BACKEND_H
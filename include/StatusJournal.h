@@ -0,0 +1,98 @@
+#ifndef STATUS_JOURNAL_H
+#define STATUS_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include "Logger.h"
+
+// Compact binary history of SystemStatus changes ([Journal] Path).
+//
+// File: 16-byte header ("PFSJ", version), then chunks. Each chunk has a
+// 32-byte header (marker, entry count, payload bytes, first and last time)
+// followed by entries of one status byte and an unsigned LEB128 varint
+// with the milliseconds since the previous entry (the chunk base for the
+// first one). Integers in headers are little-endian.
+//
+// A chunk is closed (its header filled in) after CHUNK_ENTRIES entries,
+// when the wall clock steps backwards, and on shutdown. The chunk still
+// being written has count 0 and runs to the end of the file; after a crash
+// the writer closes it on the next open, dropping a torn last entry.
+// Chunk headers double as the index: a reader skips whole chunks outside
+// the requested time range without decoding them.
+class StatusJournal {
+public:
+    static constexpr uint32_t CHUNK_ENTRIES = 4096;
+
+    explicit StatusJournal(std::shared_ptr<Logger> logger);
+    ~StatusJournal();
+
+    StatusJournal(const StatusJournal&) = delete;
+    StatusJournal& operator=(const StatusJournal&) = delete;
+
+    // Create the file, or repair and append to an existing one
+    bool open(const std::string& path);
+    void close();
+
+    void append(int64_t wallMs, uint8_t status);
+
+private:
+    std::shared_ptr<Logger> logger_;
+    std::string path_;
+    int fd_;
+    uint64_t chunkOffset_;  // Header of the open chunk, 0 if none
+    uint32_t chunkCount_;
+    uint32_t chunkBytes_;
+    int64_t chunkBaseMs_;
+    int64_t lastMs_;
+
+    bool repair(uint64_t fileSize);
+    void startChunk(int64_t wallMs);
+    void closeChunk();
+};
+
+// Read-only view of a journal, safe on a file the daemon is appending to
+class StatusJournalReader {
+public:
+    struct Entry {
+        int64_t wallMs;
+        uint8_t status;
+    };
+
+    struct Chunk {
+        uint64_t offset;   // Of the payload
+        uint32_t count;    // Entries; decoded count for the open chunk
+        uint32_t bytes;
+        int64_t firstMs;
+        int64_t lastMs;
+        bool open;
+    };
+
+    StatusJournalReader() = default;
+    ~StatusJournalReader();
+
+    StatusJournalReader(const StatusJournalReader&) = delete;
+    StatusJournalReader& operator=(const StatusJournalReader&) = delete;
+
+    bool open(const std::string& path);
+    const std::string& error() const { return error_; }
+
+    const std::vector<Chunk>& chunks() const { return chunks_; }
+    uint64_t entryCount() const;
+
+    // Append the entries with fromMs <= wallMs < toMs to out
+    size_t read(std::vector<Entry>& out,
+                int64_t fromMs = std::numeric_limits<int64_t>::min(),
+                int64_t toMs = std::numeric_limits<int64_t>::max()) const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Chunk> chunks_;
+    std::string error_;
+};
+
+#endif // STATUS_JOURNAL_H
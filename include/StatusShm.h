@@ -0,0 +1,143 @@
+#ifndef STATUS_SHM_H
+#define STATUS_SHM_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Common.h"
+#include "Logger.h"
+
+// Live SystemStatus published in POSIX shared memory for other local
+// processes (passenger display, depot diagnostics). MainControl is the only
+// writer; readers map the segment read-only and copy it under a seqlock, so
+// a read takes no lock and makes no system call. Readers need only this
+// header (and -lrt on glibc older than 2.34).
+//
+// The segment survives a daemon restart; running is 0 while no writer is
+// attached, so a reader can tell stale data from a quiet bus.
+
+// Snapshot of the published state. Times are wall clock in microseconds
+// since the epoch, except updatedMonoNs (CLOCK_MONOTONIC, for staleness).
+struct StatusShmData {
+    uint64_t frames;          // Valid status frames received since start
+    int64_t updatedWallUs;    // Time of the last frame or link change
+    int64_t updatedMonoNs;
+    uint64_t linkLosses;      // Serial link losses since start
+    uint8_t status;           // Raw SystemStatus_t byte
+    uint8_t running;          // Daemon attached
+    uint8_t linkUp;           // Serial link to the peripheral board
+    uint8_t doorCount;
+    uint8_t bitKind[8];       // StatusBitKind per status bit
+    uint8_t bitIndex[8];      // Door/cover number per status bit
+    uint8_t reserved[4];
+    int64_t doorOpenedWallUs[MAX_DOORS];  // 0 while the door is closed
+    uint64_t doorOpenCount[MAX_DOORS];    // Openings since start
+};
+
+struct StatusShmSegment {
+    static constexpr uint32_t MAGIC = 0x50465354;  // "PFST"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;  // Odd while the writer is updating data
+    uint32_t size;                   // sizeof(StatusShmSegment)
+    StatusShmData data;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock needs a lock-free counter");
+
+// Writer side, used by MainControl
+class StatusShmWriter {
+public:
+    explicit StatusShmWriter(std::shared_ptr<Logger> logger);
+    ~StatusShmWriter();
+
+    StatusShmWriter(const StatusShmWriter&) = delete;
+    StatusShmWriter& operator=(const StatusShmWriter&) = delete;
+
+    // Create or attach to the segment (name as for shm_open, e.g. "/passflow-status")
+    bool open(const std::string& name);
+
+    // Mark the segment detached and unmap it
+    void close();
+
+    bool isOpen() const { return segment_ != nullptr; }
+
+    void publish(const StatusShmData& data);
+
+private:
+    std::shared_ptr<Logger> logger_;
+    std::string name_;
+    StatusShmSegment* segment_;
+};
+
+// Reader side, for any local process
+class StatusShmReader {
+public:
+    StatusShmReader() : segment_(nullptr) {}
+    ~StatusShmReader() { close(); }
+
+    StatusShmReader(const StatusShmReader&) = delete;
+    StatusShmReader& operator=(const StatusShmReader&) = delete;
+
+    bool open(const std::string& name) {
+        close();
+        int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        void* address = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(StatusShmSegment))) {
+            address = ::mmap(nullptr, sizeof(StatusShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return false;
+
+        segment_ = static_cast<const StatusShmSegment*>(address);
+        if (segment_->magic != StatusShmSegment::MAGIC || segment_->version != StatusShmSegment::VERSION ||
+            segment_->size != sizeof(StatusShmSegment)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (segment_) {
+            ::munmap(const_cast<StatusShmSegment*>(segment_), sizeof(StatusShmSegment));
+            segment_ = nullptr;
+        }
+    }
+
+    // Consistent copy of the current state; false only if the writer kept
+    // updating for maxAttempts reads in a row
+    bool read(StatusShmData& out, int maxAttempts = 1000) const {
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            uint32_t before = segment_->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            std::memcpy(&out, &segment_->data, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment_->sequence.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+
+    // Number of completed updates, to poll for changes cheaply
+    uint32_t sequence() const { return segment_->sequence.load(std::memory_order_acquire) >> 1; }
+
+private:
+    const StatusShmSegment* segment_;
+};
+
+#endif // STATUS_SHM_H
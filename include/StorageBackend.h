@@ -0,0 +1,146 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+#include <cstdint>
+#include <chrono>
+#include "Common.h"
+
+class Logger;
+class ConfigIni;
+
+// Camera entry read from the 'cameras' table
+struct CameraSettings
+{
+    int id;                // Camera number (CamN directories)
+    int doorId;            // Door whose StartStop requests this camera serves
+    std::string rtspUrl;   // Connection string
+    bool enabled;
+};
+
+// Application settings read from database
+struct AppSettings
+{
+    int doors;                                  // Number of doors
+    int stopBeginDelay;                         // Seconds before DOOR_OPEN to start video
+    int stopEndDelay;                           // Seconds after DOOR_CLOSE to stop video
+    int daysBeforeDeleteVideo;                  // Days to keep video files
+    std::string cam0String;                     // Connection string for Camera 0 (legacy)
+    std::string cam1String;                     // Connection string for Camera 1 (legacy)
+    std::vector<CameraSettings> cameras;        // All configured cameras
+    StatusBitMap statusBits = defaultStatusBitMap(); // SystemStatus bit -> door/cover map
+    std::vector<std::string> remoteDBAddresses; // Remote DB addresses for replication
+};
+
+// Row for the 'events' table
+struct EventRecord
+{
+    int type;                 // EventType code
+    std::string description;  // e.g. "Door 0 open"
+    std::string time;         // formatTimestamp() string
+};
+
+// Row for the 'video_segments' table
+struct VideoSegmentRecord
+{
+    int cameraId;
+    std::string startTime;
+    std::string stopTime;
+    std::string filename;
+    std::string encoding;  // Transcode settings the clip was encoded with
+};
+
+// Door activity in one time bucket of the 'door_stats' table. Written as a
+// delta: counts and durations are added to the stored row, max is kept
+struct DoorStatsRecord
+{
+    int door;
+    std::string bucketStart;  // "YYYY-MM-DD HH:MM:SS", local time
+    int bucketSeconds;
+    int openCount;
+    int64_t openMs;           // Time the door was open within the bucket
+    int64_t maxOpenMs;        // Longest open period starting in the bucket
+    int coverOpenCount;       // Cover (same index as the door) opened
+};
+
+using StorageRecord = std::variant<EventRecord, VideoSegmentRecord, DoorStatsRecord>;
+
+// Tables that are replicated to the remoteDB addresses
+enum class RecordTable
+{
+    Events,
+    VideoSegments
+};
+
+// Stored row together with its local id
+struct StoredRecord
+{
+    int64_t id;
+    StorageRecord record;
+};
+
+enum class WriteStatus
+{
+    Ok,       // Stored (or queued for the backend's next commit)
+    Offline,  // Not reachable; the caller should keep the record and retry
+    Failed    // Rejected; retrying will not help
+};
+
+// Map a 'status_bits' row (bit, role, idx) to its role; false if invalid
+bool parseStatusBitRole(int bit, const std::string &role, int idx, StatusBitRole &entry);
+
+// Database behind MySqlComm. The MariaDB backend talks to the local server;
+// the SQLite backend keeps everything in one file inside the process.
+// Selected by [Database] Backend in config.ini (mariadb | sqlite).
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    virtual bool connect() = 0;
+    virtual void disconnect() = 0;
+
+    // Connection exists (no I/O)
+    virtual bool hasConnection() const = 0;
+    // Connection exists and answers
+    virtual bool isConnected() const = 0;
+
+    virtual WriteStatus write(const StorageRecord &record) = 0;
+
+    // Make buffered writes durable; returns false if some could not be stored
+    virtual bool flush() { return true; }
+
+    // Settings, cameras, status bits and remote addresses; stamp identifies
+    // the settings version (settings.updated_at)
+    virtual bool loadSettings(AppSettings &settings, std::string &stamp) = 0;
+    virtual bool readSettingsStamp(std::string &stamp) = 0;
+
+    // Up to limit rows of table with id > afterId, in id order
+    virtual bool readSince(RecordTable table, int64_t afterId, size_t limit,
+                           std::vector<StoredRecord> &rows) = 0;
+    // Highest id in table (0 when empty)
+    virtual bool lastId(RecordTable table, int64_t &id) = 0;
+
+    // door_stats rows with from <= bucket_start < to, by bucket then door
+    virtual bool readDoorStats(const std::string &from, const std::string &to,
+                               std::vector<DoorStatsRecord> &rows) = 0;
+
+    // Remove events and video segments older than cutoff (event_time /
+    // start_time) and prepare storage for the days after now
+    virtual bool applyRetention(std::chrono::system_clock::time_point cutoff,
+                                std::chrono::system_clock::time_point now) = 0;
+
+    // Backends compiled into this binary, default first
+    static std::vector<std::string> available();
+
+    // Build the backend named by [Database] Backend (default: first available)
+    static std::unique_ptr<StorageBackend> create(const ConfigIni &config,
+                                                  std::shared_ptr<Logger> logger);
+};
+
+#endif // STORAGE_BACKEND_H
@@ -0,0 +1,96 @@
+#ifndef STREAM_HEALTH_H
+#define STREAM_HEALTH_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include "Timeline.h"
+#include "Logger.h"
+
+// Health of one camera's recording process, judged by the growth of its
+// output file rather than by the process merely existing: a hung RTSP
+// session that writes nothing is a stall, a camera that never delivers a
+// byte is a failed start.
+//
+// Failures are retried after an exponential backoff with jitter. After
+// BREAKER_THRESHOLD failures without a stable run in between the circuit
+// breaker opens and the camera is left alone for BREAKER_OPEN, then tried
+// once (half-open). A camera power-on clears the backoff so recording
+// resumes as soon as the door opens. Thread-safe.
+class StreamHealth {
+public:
+    enum class State { Stopped, Starting, Running, Backoff, Open };
+    enum class Failure { Exited, Stalled, NoData, SpawnFailed };
+
+    struct Metrics {
+        uint64_t starts = 0;
+        uint64_t exits = 0;
+        uint64_t stalls = 0;
+        uint64_t noData = 0;
+        uint64_t spawnFailures = 0;
+        uint64_t breakerTrips = 0;
+        std::chrono::milliseconds uptime{0};       // Time with the file growing
+        std::chrono::milliseconds longestRun{0};
+    };
+
+    // A running stream that writes nothing for this long has stalled
+    static constexpr std::chrono::seconds STALL_TIMEOUT{5};
+    // A start that writes nothing for this long has failed
+    static constexpr std::chrono::seconds FIRST_DATA_TIMEOUT{15};
+    // A run this long clears the failure count
+    static constexpr std::chrono::seconds STABLE_AFTER{30};
+    static constexpr std::chrono::milliseconds BACKOFF_BASE{1000};
+    static constexpr std::chrono::seconds BACKOFF_MAX{60};
+    static constexpr int BREAKER_THRESHOLD = 5;
+    static constexpr std::chrono::minutes BREAKER_OPEN{5};
+
+    StreamHealth(int cameraId, std::shared_ptr<Logger> logger);
+
+    void started(Timeline::Instant now);
+    // Stopped on purpose (shutdown, stream URL change)
+    void stopped(Timeline::Instant now);
+    void failed(Timeline::Instant now, Failure why);
+
+    // Sample the output file size; a failure here means the caller should
+    // kill the process and report it through failed()
+    bool check(Timeline::Instant now, uintmax_t outputBytes, Failure& why);
+
+    // True once the backoff or open breaker interval has run out
+    bool restartDue(Timeline::Instant now) const;
+
+    // Camera powered on: retry now with a clean failure count
+    void wake(Timeline::Instant now);
+
+    State state() const;
+    Metrics metrics() const;
+    std::string summary() const;
+
+    static const char* stateName(State state);
+    static const char* failureName(Failure why);
+
+private:
+    int cameraId_;
+    std::shared_ptr<Logger> logger_;
+    mutable std::mutex mutex_;
+    std::mt19937 random_;
+
+    State state_;
+    bool halfOpen_;                     // Current start is the breaker's trial
+    int failures_;                      // Since the last stable run
+    Timeline::Instant startedAt_;
+    Timeline::Instant firstDataAt_;
+    Timeline::Instant lastGrowth_;
+    Timeline::Instant downSince_;       // First failure of the current outage
+    Timeline::Instant nextAttempt_;
+    uintmax_t lastBytes_;
+    bool recovering_;                   // A failure happened since the last data
+    Metrics metrics_;
+
+    void endRun(Timeline::Instant end);
+    std::chrono::milliseconds backoffDelay();
+};
+
+#endif // STREAM_HEALTH_H
@@ -0,0 +1,91 @@
+#ifndef STREAM_PROBE_H
+#define STREAM_PROBE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include "Logger.h"
+
+// Stream parameters of one camera, learned from its own recordings so
+// that later ffmpeg starts can skip most of the input probing.
+//
+// The first start of a URL probes fully; for RTSP it tries TCP, then UDP
+// if that delivers nothing. Once a recording has started, the transport
+// that worked and the video parameters in the file's moov (codec, size,
+// the avcC/hvcC record holding SPS/PPS) are kept in a small INI file.
+// Later starts use that transport and a minimal probe.
+//
+// ffmpeg's command line cannot hand SPS/PPS to the RTSP demuxer, so the
+// cached record is used to check each fast start instead: a fast start
+// that fails, or records without SPS/PPS, drops the cache and the next
+// start probes fully again. Thread-safe.
+class StreamProbe {
+public:
+    struct Params {
+        std::string url;
+        std::string transport;    // "tcp" or "udp" for RTSP, empty otherwise
+        std::string codec;        // Sample entry type: "avc1", "hvc1", ...
+        int width = 0;
+        int height = 0;
+        std::string codecConfig;  // avcC/hvcC record, hex
+        std::string audioCodec;   // Empty without audio
+
+        // "avc1 1920x1080, rtsp over tcp, audio mp4a"
+        std::string describe() const;
+        bool sameStream(const Params& other) const;
+    };
+
+    enum class Verdict {
+        Pending,    // The moov is not readable yet; ask again later
+        Learned,    // Full probe; parameters cached
+        Verified,   // Fast start recorded the cached stream
+        Changed,    // Fast start recorded a different, complete stream; cache updated
+        Broken,     // Fast start recorded without SPS/PPS; restart with a full probe
+        Unknown     // No video track or no SPS/PPS; nothing cached
+    };
+
+    // ffmpeg's defaults are 5 MB and 5 s
+    static constexpr int FAST_PROBESIZE = 32768;
+    static constexpr int FAST_ANALYZEDURATION_US = 500000;
+    static constexpr int MAX_PENDING_CHECKS = 10;
+
+    StreamProbe(int cameraId, std::shared_ptr<Logger> logger);
+
+    // Use path as the cache file and read it, if it exists
+    void load(const std::string& path);
+
+    // Input options for the next ffmpeg start of url, placed before "-i"
+    std::vector<std::string> inputArgs(const std::string& url);
+
+    // Whether the last inputArgs() used cached parameters
+    bool fast() const;
+
+    // The last start delivered data into file: learn or check its parameters
+    Verdict recorded(const std::string& file);
+
+    // The last start failed before delivering data
+    void startFailed();
+
+    std::optional<Params> cached() const;
+
+private:
+    int cameraId_;
+    std::string path_;
+    std::shared_ptr<Logger> logger_;
+    mutable std::mutex mutex_;
+
+    std::optional<Params> cached_;
+    std::string url_;          // Of the last start
+    std::string transport_;    // Of the last start
+    std::string learnTransport_;  // Next transport to try while learning
+    bool fast_;
+    int pendingChecks_;
+
+    bool save(const Params& params);
+    void forget(const std::string& reason);
+    static bool isRtsp(const std::string& url);
+};
+
+#endif // STREAM_PROBE_H
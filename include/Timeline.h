@@ -0,0 +1,33 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <chrono>
+
+// Internal monotonic timeline. Door windows, clip offsets and file ages
+// are Timeline::Instant values, which never jump. Wall-clock time is
+// derived only for filenames and database rows, through a mapping that
+// is re-sampled periodically: when GPS/NTP/RTC steps the system clock,
+// the mapping moves but the instants (and clip lengths) do not.
+namespace Timeline {
+
+using Clock = std::chrono::steady_clock;
+using Instant = Clock::time_point;
+
+// Steps smaller than this are treated as drift and applied silently
+constexpr std::chrono::milliseconds STEP_THRESHOLD{1000};
+
+inline Instant now() { return Clock::now(); }
+
+// Wall-clock time of an instant under the current mapping
+std::chrono::system_clock::time_point toWall(Instant instant);
+
+// Instant of a wall-clock time under the current mapping
+Instant fromWall(std::chrono::system_clock::time_point wall);
+
+// Re-sample the mapping; returns how far the wall clock moved relative
+// to the monotonic clock since the previous sample
+std::chrono::milliseconds resync();
+
+} // namespace Timeline
+
+#endif // TIMELINE_H
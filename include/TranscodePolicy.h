@@ -0,0 +1,91 @@
+#ifndef TRANSCODE_POLICY_H
+#define TRANSCODE_POLICY_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "Logger.h"
+
+// Chooses the encoder settings of each clip extraction from the current
+// load: clip jobs queued or running across all cameras, CPU busy time
+// (/proc/stat, sampled every CPU_SAMPLE_INTERVAL from the recorders'
+// health checks) and whether a live recorder had to be restarted recently.
+// Under load clips get a faster preset, fewer encoder threads and then a
+// smaller frame so the recorders keep their CPU; when the board is idle
+// they are encoded at the configured full quality. Thread-safe.
+class TranscodePolicy {
+public:
+    enum class Tier { Full, Reduced, Minimal };
+
+    struct Params {
+        Tier tier = Tier::Full;
+        std::string preset = "fast";
+        int crf = 23;
+        int threads = 0;  // 0: let the encoder decide
+        int width = 640;
+        int height = 480;
+
+        // "fast crf=23 threads=auto 640x480", stored with the clip
+        std::string describe() const;
+    };
+
+    struct Load {
+        int backlog = 0;      // Clip jobs queued or running, this one included
+        double cpuBusy = 0;   // 0..1 over the latest sample interval
+        bool recorderTrouble = false;
+    };
+
+    // Thresholds for stepping down one tier
+    static constexpr int BACKLOG_REDUCED = 3;
+    static constexpr int BACKLOG_MINIMAL = 6;
+    static constexpr double CPU_REDUCED = 0.75;
+    static constexpr double CPU_MINIMAL = 0.90;
+    static constexpr std::chrono::minutes RECORDER_TROUBLE_WINDOW{5};
+    static constexpr std::chrono::seconds CPU_SAMPLE_INTERVAL{1};
+    // Older samples (no health check ran) are replaced by one taken in choose()
+    static constexpr std::chrono::seconds CPU_SAMPLE_MAX_AGE{3};
+
+    explicit TranscodePolicy(std::shared_ptr<Logger> logger);
+
+    // Full-quality settings ([Video] section); adaptive = false always uses them
+    void configure(const Params& full, bool adaptive);
+
+    void jobQueued();
+    void jobFinished();
+    void recorderRestarted();
+
+    // Update the CPU figure if CPU_SAMPLE_INTERVAL has passed; called on
+    // every health check, so choose() sees the last second or so
+    void sampleCpu();
+
+    // Settings for a clip about to be encoded
+    Params choose();
+
+    Params paramsFor(Tier tier) const;
+    static const char* tierName(Tier tier);
+
+private:
+    std::shared_ptr<Logger> logger_;
+    mutable std::mutex mutex_;
+    Params full_;
+    bool adaptive_;
+    int backlog_;
+    bool restarted_;
+    std::chrono::steady_clock::time_point lastRestart_;
+
+    // /proc/stat totals at the previous sample
+    uint64_t cpuBusyTicks_;
+    uint64_t cpuTotalTicks_;
+    double cpuBusy_;
+    std::chrono::steady_clock::time_point cpuSampledAt_;
+    int cpuCount_;
+
+    Tier lastTier_;
+
+    double sampleCpuLocked(std::chrono::steady_clock::time_point now);
+    static bool readCpuTicks(uint64_t& busy, uint64_t& total);
+};
+
+#endif // TRANSCODE_POLICY_H
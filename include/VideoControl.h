@@ -8,62 +8,199 @@
 #include <vector>
 #include <chrono>
 #include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
 #include "Common.h"
+#include "Clock.h"
 #include "MessageQueue.h"
 #include "Logger.h"
 #include "MySqlComm.h"
+#include "ClipIndex.h"
+#include "ClipQueryServer.h"
+#include "Reactor.h"
+#include "WorkerPool.h"
+#include "TranscodePolicy.h"
+#include "StreamHealth.h"
+#include "StreamProbe.h"
+#include "ClipJobJournal.h"
+#include "PowerPolicy.h"
 
 struct CameraConfig {
     int id;
+    int doorId;
     std::string ipAddress;
     std::string rtspUrl;
     bool enabled;
 };
 
+// One source recording file and the wall-clock span it covers
+struct SourceSegment {
+    std::string path;
+    Timeline::Instant start;
+    Timeline::Instant end;  // Instant::max() while recording
+};
+
+// A clip to cut from the source recordings, named when it was accepted
+struct ClipJob {
+    StartStopMessage window;
+    std::string outputFile;
+    int niceness = 0;  // Of the extraction; resumed jobs run in the background
+};
+
 class CameraRecorder {
 private:
     CameraConfig config_;
     std::shared_ptr<Logger> logger_;
     std::shared_ptr<MySqlComm> dbComm_;
+    std::shared_ptr<Clock> clock_;
+    std::shared_ptr<ClipIndex> clipIndex_;  // Optional
+    std::shared_ptr<TranscodePolicy> transcodePolicy_;  // Optional: full quality without
+    std::shared_ptr<ClipJobJournal> clipJobs_;  // Optional
     
     std::atomic<bool> running_;
     std::thread recordThread_;
+    std::mutex loopMutex_;
+    std::condition_variable loopCv_;
+    bool loopWake_;  // Guarded by loopMutex_: run the checks now
     
     std::string currentVideoFile_;
-    std::chrono::system_clock::time_point currentFileStartTime_;
+    Timeline::Instant currentFileStartTime_;
     
-    FILE* ffmpegProcess_;
+    pid_t ffmpegPid_;  // -1 when not recording
     std::mutex fileMutex_;
+    std::deque<SourceSegment> sourceHistory_;  // Recent source files, oldest first
+    StreamHealth health_;
+    StreamProbe probe_;
+    Timeline::Instant startedAt_;  // Of the current ffmpeg start
+    bool probePending_;            // Loop only: first data seen, parameters not checked yet
+    
+    // Low power: no ffmpeg and no health checks until resume()
+    std::atomic<bool> paused_;
+    std::atomic<bool> cleanupDue_;  // Loop only: run retention at the next wake
+    bool wakePending_;              // Guarded by fileMutex_: readiness not logged yet
+    Timeline::Instant wakeFrom_;    // Guarded by fileMutex_: status frame that woke us
     
     std::string sourceDir_;
     std::string outputDir_;
     
-    // Settings from database
-    int daysBeforeDeleteVideo_;
+    // Settings from database (may change at runtime)
+    std::atomic<int> daysBeforeDeleteVideo_;
+    
+    // Segment extraction jobs still running
+    int activeJobs_;
+    std::mutex jobsMutex_;
+    std::condition_variable jobsCv_;
+    
+    // Reactor runtime: timers and child watches replace recordThread_, and
+    // clip jobs run on the worker pool instead of detached threads
+    Reactor* reactor_;
+    WorkerPool* pool_;
+    Reactor::TimerId rotateTimer_;
+    Reactor::TimerId cleanupTimer_;
+    Reactor::TimerId firstDataTimer_;
+    Reactor::TimerId healthTimer_;
+    std::map<Reactor::TimerId, ClipJob> waitingClips_;  // Guarded by jobsMutex_
     
     void recordLoop();
+    bool waitWhileRunning(std::chrono::milliseconds duration);
     bool startFFmpeg();
-    void stopFFmpeg();
+    bool spawnFFmpegLocked();
+    bool stopFFmpeg(std::chrono::steady_clock::time_point deadline);
+    void stopFFmpegInLoop();
+    void interruptFFmpeg(pid_t pid);
+    void rotateSourceFile();
     std::string generateFilename();
     void cleanupOldVideos();
+    void checkProbe(const std::string& file);
+    void closeSourceSegmentLocked(Timeline::Instant end);
+    void markSourceStartLocked(Timeline::Instant start);
+    void checkHealth();
+    void onRecorderFailed(Timeline::Instant now, StreamHealth::Failure why);
+    void watchFFmpeg(pid_t pid);
+    void onFFmpegExited(pid_t pid);
     
 public:
+    // Default time ffmpeg gets to finalize its file when stopped
+    static constexpr std::chrono::seconds STOP_TIMEOUT{3};
+    // Source files are rotated (without a recording gap) at this interval
+    static constexpr std::chrono::minutes SOURCE_ROTATE_INTERVAL{10};
+    // Extraction waits this long past the clip end for the fragment flush
+    static constexpr std::chrono::seconds FRAGMENT_FLUSH_MARGIN{2};
+    static constexpr size_t MAX_SOURCE_HISTORY = 32;
+    static constexpr std::chrono::hours CLEANUP_INTERVAL{1};
+    // Output growth is sampled and due restarts are made at this interval
+    static constexpr std::chrono::seconds HEALTH_CHECK_INTERVAL{1};
+    // ...and at this interval while a start waits for its first bytes
+    static constexpr std::chrono::milliseconds FIRST_DATA_POLL{50};
+    // The threaded loop wakes this often while paused
+    static constexpr std::chrono::minutes PAUSED_CHECK_INTERVAL{1};
+    
     CameraRecorder(const CameraConfig& config, 
                    std::shared_ptr<Logger> logger,
-                   std::shared_ptr<MySqlComm> dbComm);
+                   std::shared_ptr<MySqlComm> dbComm,
+                   std::shared_ptr<Clock> clock = Clock::real());
     ~CameraRecorder();
     
     void start();
-    void stop();
+    // Returns false if ffmpeg had to be killed before finalizing its file
+    bool stop(std::chrono::steady_clock::time_point deadline =
+                  std::chrono::steady_clock::now() + STOP_TIMEOUT);
     bool isRunning() const { return running_; }
+    const CameraConfig& config() const { return config_; }
+    const StreamHealth& health() const { return health_; }
+    
+    // The camera's power was switched on: skip any restart backoff
+    void powerOn();
+    
+    // Low power: stop ffmpeg (finalizing its file) and the health checks
+    void pause();
+    // Back to full readiness; the time to first data is measured from since
+    void resume(Timeline::Instant since);
+    bool isPaused() const { return paused_; }
+    
+    // Apply retention now instead of at the next hourly run, off the caller's thread
+    void cleanupSoon();
     
     void processStartStopMessage(const StartStopMessage& msg);
+    
+    // Wait for extraction jobs; returns the number still running at the deadline
+    int waitForJobs(std::chrono::steady_clock::time_point deadline);
     void setDaysBeforeDeleteVideo(int days) { daysBeforeDeleteVideo_ = days; }
     
+    // Run on reactor, with clip jobs on pool, instead of own threads (call before start)
+    void setReactor(Reactor* reactor, WorkerPool* pool) { reactor_ = reactor; pool_ = pool; }
+    
+    // Keep clipIndex up to date with new clips and source recordings
+    void setClipIndex(std::shared_ptr<ClipIndex> clipIndex) { clipIndex_ = clipIndex; }
+    
+    // Pick clip encoder settings from the load, and report restarts to it
+    void setTranscodePolicy(std::shared_ptr<TranscodePolicy> policy) { transcodePolicy_ = policy; }
+    
+    // Record accepted clips and their progress, to resume them after a restart
+    void setClipJobJournal(std::shared_ptr<ClipJobJournal> journal) { clipJobs_ = journal; }
+    
+    // Cut a clip carried over from the previous run, in the calling thread
+    void resumeClipJob(const ClipJob& job);
+    const std::string& sourceDir() const { return sourceDir_; }
+    const std::string& outputDir() const { return outputDir_; }
+    
+    // Switch to a new stream URL, restarting only this camera's ffmpeg
+    void reconfigure(const std::string& rtspUrl);
+    
 private:
-    void extractAndProcessSegment(const std::string& sourceFile,
-                                  std::chrono::system_clock::time_point startTime,
-                                  std::chrono::system_clock::time_point stopTime);
+    void waitForFootage(Timeline::Instant stopTime);
+    void submitClipJob(const ClipJob& job);
+    void runClipJob(const ClipJob& job);
+    std::vector<SourceSegment> sourcesFor(Timeline::Instant startTime, Timeline::Instant stopTime);
+    std::string clipFilename(Timeline::Instant startTime,
+                             Timeline::Instant stopTime) const;
+    bool extractAndProcessSegment(Timeline::Instant startTime,
+                                  Timeline::Instant stopTime,
+                                  const std::string& outputFile,
+                                  const TranscodePolicy::Params& params,
+                                  int niceness);
 };
 
 class VideoControl {
@@ -71,23 +208,71 @@ private:
     std::shared_ptr<Logger> logger_;
     std::shared_ptr<MessageQueue<Message>> messageQueue_;
     std::shared_ptr<MySqlComm> dbComm_;
+    std::shared_ptr<Clock> clock_;
     
     std::vector<std::unique_ptr<CameraRecorder>> cameras_;
+    std::vector<std::vector<CameraRecorder*>> doorCameras_;  // Indexed by door number
     std::thread messageThread_;
     std::atomic<bool> running_;
     
+    std::shared_ptr<ClipIndex> clipIndex_;
+    ClipQueryServer clipServer_;
+    std::shared_ptr<TranscodePolicy> transcodePolicy_;
+    std::string clipSocketPath_;
+    
+    std::shared_ptr<ClipJobJournal> clipJobs_;
+    std::string clipJobPath_;
+    int resumeNice_;
+    std::thread resumeThread_;  // Clip jobs carried over from the previous run
+    
+    Reactor* reactor_;  // Reactor runtime; nullptr: own message thread
+    WorkerPool* pool_;
+    
     void messageLoop();
+    void drainMessages();
+    void handleMessage(const Message& msg);
     bool loadConfiguration();
+    void buildClipIndex();
+    void resumeClipJobs(std::vector<ClipJobJournal::Job> jobs);
+    void applySettings(const AppSettings& oldSettings, const AppSettings& newSettings);
+    void setPowerMode(const PowerModeMessage& power);
     
 public:
     VideoControl(std::shared_ptr<Logger> logger,
                 std::shared_ptr<MessageQueue<Message>> messageQueue,
-                std::shared_ptr<MySqlComm> dbComm);
+                std::shared_ptr<MySqlComm> dbComm,
+                std::shared_ptr<Clock> clock = Clock::real());
     ~VideoControl();
     
+    // Take messages on reactor and run clip jobs on pool instead of own
+    // threads (call before start)
+    void setReactor(Reactor* reactor, WorkerPool* pool) { reactor_ = reactor; pool_ = pool; }
+    
+    // Unix socket for clip lookups (empty: no query server)
+    void setClipQuerySocket(const std::string& path) { clipSocketPath_ = path; }
+    
+    // Journal of accepted clips (empty: none); unfinished ones are cut again
+    // at start, one at a time at resumeNice (call before initialize)
+    void setClipJobJournal(const std::string& path, int resumeNice)
+    {
+        clipJobPath_ = path;
+        resumeNice_ = resumeNice;
+    }
+    const ClipIndex& clipIndex() const { return *clipIndex_; }
+    
+    // Full-quality clip encoding; adaptive lowers it under load (call before initialize)
+    void configureTranscode(const TranscodePolicy::Params& full, bool adaptive)
+    {
+        transcodePolicy_->configure(full, adaptive);
+    }
+    
     bool initialize();
     void start();
-    void stop();
+    void stop(std::chrono::steady_clock::time_point deadline =
+                  std::chrono::steady_clock::now() + CameraRecorder::STOP_TIMEOUT);
+    
+    // Wait for extraction jobs; returns the number still running at the deadline
+    int waitForPendingJobs(std::chrono::steady_clock::time_point deadline);
 };
 
 #endif // VIDEO_CONTROL_H
@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include "Logger.h"
+
+// Fixed number of threads running queued jobs in order, for work that
+// must not run on the reactor thread (clip transcodes, file cleanup).
+// Queued jobs still run when the pool is destroyed.
+class WorkerPool {
+public:
+    using Job = std::function<void()>;
+
+    WorkerPool(std::shared_ptr<Logger> logger, size_t threads, size_t maxQueued = 256);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // False (and the job is dropped) when maxQueued jobs are already waiting
+    bool submit(Job job);
+
+    size_t queued() const;
+
+private:
+    std::shared_ptr<Logger> logger_;
+    size_t maxQueued_;
+    std::deque<Job> jobs_;
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> threads_;
+
+    void workerLoop();
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,95 @@
+#include "ClipCoalescer.h"
+#include <algorithm>
+
+ClipCoalescer::ClipCoalescer(std::chrono::milliseconds glitchThreshold)
+    : glitchThreshold_(glitchThreshold)
+{
+}
+
+void ClipCoalescer::configure(int doors)
+{
+    doors_.assign(std::max(doors, 0), DoorWindow());
+}
+
+void ClipCoalescer::doorOpened(int door, Timeline::Instant now)
+{
+    if (door < 0 || static_cast<size_t>(door) >= doors_.size())
+        return;
+
+    doors_[door].open = true;
+    doors_[door].openTime = now;
+}
+
+bool ClipCoalescer::doorClosed(int door, Timeline::Instant now,
+                               std::chrono::seconds beginDelay, std::chrono::seconds endDelay)
+{
+    if (door < 0 || static_cast<size_t>(door) >= doors_.size() || !doors_[door].open)
+        return false;
+
+    DoorWindow &state = doors_[door];
+    state.open = false;
+
+    if (now - state.openTime < glitchThreshold_)
+    {
+        counters_.suppressed++;
+        return false;
+    }
+
+    Clip clip{door, state.openTime - beginDelay, now + endDelay};
+
+    if (state.pending && clip.start <= state.clip.stop)
+    {
+        // Re-opened before the previous window ended: one longer clip
+        state.clip.stop = std::max(state.clip.stop, clip.stop);
+        counters_.merged++;
+        return true;
+    }
+
+    if (state.pending)
+    {
+        // Previous window is complete but has not been polled yet
+        ready_.push_back(state.clip);
+        counters_.emitted++;
+    }
+    state.pending = true;
+    state.clip = clip;
+    return true;
+}
+
+std::vector<ClipCoalescer::Clip> ClipCoalescer::poll(Timeline::Instant now)
+{
+    std::vector<Clip> ready;
+    ready.swap(ready_);
+    for (auto &state : doors_)
+    {
+        if (state.pending && !state.open && now >= state.clip.stop)
+        {
+            ready.push_back(state.clip);
+            state.pending = false;
+            counters_.emitted++;
+        }
+    }
+    return ready;
+}
+
+bool ClipCoalescer::idle() const
+{
+    return ready_.empty() && std::none_of(doors_.begin(), doors_.end(), [](const DoorWindow &state)
+                                          { return state.open || state.pending; });
+}
+
+std::vector<ClipCoalescer::Clip> ClipCoalescer::flush()
+{
+    std::vector<Clip> ready;
+    ready.swap(ready_);
+    for (auto &state : doors_)
+    {
+        if (state.pending)
+        {
+            ready.push_back(state.clip);
+            state.pending = false;
+            counters_.emitted++;
+        }
+    }
+    return ready;
+}
@@ -0,0 +1,253 @@
+#include "ClipIndex.h"
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <ctime>
+#include "Common.h"
+#include "Mp4Index.h"
+#include "StreamHealth.h"
+
+namespace
+{
+bool byStart(const ClipIndex::Entry &a, const ClipIndex::Entry &b)
+{
+    return a.startUs < b.startUs;
+}
+
+// Clip file: "<start>_<stop>.mp4", both formatTimestamp() with '_' and '-'
+bool parseClipName(const std::string &name, int64_t &startUs, int64_t &endUs)
+{
+    const size_t STAMP_LENGTH = 23;  // YYYY-MM-DD_HH-MM-SS.mmm
+    std::chrono::system_clock::time_point start, stop;
+    if (name.size() < 2 * STAMP_LENGTH + 1 ||
+        !parseTimestamp(name.substr(0, STAMP_LENGTH), start) ||
+        !parseTimestamp(name.substr(STAMP_LENGTH + 1, STAMP_LENGTH), stop))
+    {
+        return false;
+    }
+    startUs = ClipIndex::wallUs(start);
+    endUs = ClipIndex::wallUs(stop);
+    return true;
+}
+
+// Source file: "YYYYMMDD_HHMMSS_camN.mp4"
+bool parseSourceName(const std::string &name, int64_t &startUs)
+{
+    std::tm tm{};
+    if (std::sscanf(name.c_str(), "%4d%2d%2d_%2d%2d%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+    {
+        return false;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    startUs = ClipIndex::wallUs(std::chrono::system_clock::from_time_t(std::mktime(&tm)));
+    return true;
+}
+}
+
+int64_t ClipIndex::wallUs(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+}
+
+void ClipIndex::setCameraDoor(int cameraId, int doorId)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    cameraDoors_[cameraId] = doorId;
+}
+
+std::vector<int> ClipIndex::camerasForDoor(int doorId) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<int> cameras;
+    for (const auto &entry : cameraDoors_)
+    {
+        if (entry.second == doorId)
+            cameras.push_back(entry.first);
+    }
+    return cameras;
+}
+
+void ClipIndex::add(const Entry &entry)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Series &series = series_[{entry.cameraId, entry.kind}];
+
+    // Almost always the newest entry: append
+    auto position = std::upper_bound(series.entries.begin(), series.entries.end(), entry, byStart);
+    series.entries.insert(position, entry);
+    if (entry.endUs != OPEN_END)
+    {
+        series.maxSpanUs = std::max(series.maxSpanUs, entry.endUs - entry.startUs);
+    }
+}
+
+void ClipIndex::close(int cameraId, const std::string &path, int64_t endUs)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = series_.find({cameraId, Kind::Source});
+    if (it == series_.end())
+        return;
+
+    Series &series = it->second;
+    for (auto entry = series.entries.rbegin(); entry != series.entries.rend(); ++entry)
+    {
+        if (entry->path == path)
+        {
+            entry->endUs = endUs;
+            series.maxSpanUs = std::max(series.maxSpanUs, endUs - entry->startUs);
+            return;
+        }
+    }
+}
+
+void ClipIndex::setStart(int cameraId, const std::string &path, int64_t startUs)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = series_.find({cameraId, Kind::Source});
+    if (it == series_.end())
+        return;
+
+    auto &entries = it->second.entries;
+    for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+    {
+        if (entry->path == path)
+        {
+            // Keep the series sorted; the entry is almost always the last
+            Entry moved = *entry;
+            moved.startUs = startUs;
+            entries.erase(std::next(entry).base());
+            entries.insert(std::upper_bound(entries.begin(), entries.end(), moved, byStart), moved);
+            return;
+        }
+    }
+}
+
+void ClipIndex::querySeries(const Series &series, int64_t fromUs, int64_t toUs, std::vector<Entry> &out)
+{
+    const auto &entries = series.entries;
+
+    // Nothing starting before fromUs - maxSpanUs can reach fromUs
+    Entry probe{0, Kind::Clip, fromUs - series.maxSpanUs, 0, std::string()};
+    auto first = std::lower_bound(entries.begin(), entries.end(), probe, byStart);
+    probe.startUs = toUs;
+    auto last = std::upper_bound(first, entries.end(), probe, byStart);
+
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->endUs >= fromUs)
+            out.push_back(*it);
+    }
+
+    // An open source recording may have started long before the window
+    if (!entries.empty() && entries.back().endUs == OPEN_END &&
+        entries.back().startUs <= toUs && entries.back().startUs < fromUs - series.maxSpanUs)
+    {
+        out.push_back(entries.back());
+    }
+}
+
+std::vector<ClipIndex::Entry> ClipIndex::query(int cameraId, int64_t fromUs, int64_t toUs, bool includeSources) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<Entry> result;
+    for (const auto &entry : series_)
+    {
+        if ((cameraId >= 0 && entry.first.first != cameraId) ||
+            (!includeSources && entry.first.second == Kind::Source))
+        {
+            continue;
+        }
+        querySeries(entry.second, fromUs, toUs, result);
+    }
+    return result;
+}
+
+size_t ClipIndex::removeBefore(int cameraId, Kind kind, int64_t endUs)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = series_.find({cameraId, kind});
+    if (it == series_.end())
+        return 0;
+
+    auto &entries = it->second.entries;
+    size_t before = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [endUs](const Entry &entry) { return entry.endUs < endUs; }),
+                  entries.end());
+    return before - entries.size();
+}
+
+size_t ClipIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t count = 0;
+    for (const auto &entry : series_)
+    {
+        count += entry.second.entries.size();
+    }
+    return count;
+}
+
+size_t ClipIndex::scanDirectory(int cameraId, Kind kind, const std::string &dir)
+{
+    std::vector<Entry> found;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (!it->is_regular_file() || it->path().extension() != ".mp4")
+            continue;
+
+        Entry entry{cameraId, kind, 0, 0, it->path().string()};
+        std::string name = it->path().filename().string();
+        if (kind == Kind::Clip)
+        {
+            if (!parseClipName(name, entry.startUs, entry.endUs))
+                continue;
+        }
+        else
+        {
+            if (!parseSourceName(name, entry.startUs))
+                continue;
+            Mp4Index index;
+            if (!index.open(entry.path) || index.durationUs() <= 0)
+                continue;
+
+            // The name is the spawn time (in whole seconds), footage starts
+            // once ffmpeg has connected: the last fragment was written at
+            // the file's end, so its first sample lies one index duration
+            // before that. Connecting never takes longer than the first
+            // data timeout, which bounds a file that was touched since
+            std::error_code timeEc;
+            auto written = std::filesystem::last_write_time(it->path(), timeEc);
+            if (!timeEc)
+            {
+                auto writtenUs = wallUs(std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                    written - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now()));
+                int64_t latestUs = entry.startUs + 1000000 +
+                                   std::chrono::duration_cast<std::chrono::microseconds>(
+                                       StreamHealth::FIRST_DATA_TIMEOUT).count();
+                entry.startUs = std::clamp(writtenUs - index.durationUs(), entry.startUs, latestUs);
+            }
+            entry.endUs = entry.startUs + index.durationUs();
+        }
+        found.push_back(std::move(entry));
+    }
+
+    if (found.empty())
+        return 0;
+
+    // One sort for the whole directory instead of sorted inserts
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Series &series = series_[{cameraId, kind}];
+    series.entries.insert(series.entries.end(), found.begin(), found.end());
+    std::stable_sort(series.entries.begin(), series.entries.end(), byStart);
+    for (const auto &entry : found)
+    {
+        series.maxSpanUs = std::max(series.maxSpanUs, entry.endUs - entry.startUs);
+    }
+    return found.size();
+}
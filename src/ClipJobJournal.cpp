@@ -0,0 +1,231 @@
+#include "ClipJobJournal.h"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+ClipJobJournal::ClipJobJournal(std::shared_ptr<Logger> logger)
+    : logger_(logger), fd_(-1), size_(0), unsynced_(false)
+{
+}
+
+ClipJobJournal::~ClipJobJournal()
+{
+    close();
+}
+
+std::string ClipJobJournal::jobLine(const Job &job)
+{
+    return "Q\t" + std::to_string(job.cameraId) + "\t" + std::to_string(job.doorId) + "\t" +
+           std::to_string(job.startUs) + "\t" + std::to_string(job.stopUs) + "\t" + job.outputFile + "\n";
+}
+
+bool ClipJobJournal::open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = path;
+
+    // Replay the existing journal; only newline-terminated lines count
+    std::vector<Job> jobs;
+    std::map<std::string, size_t> byOutput;
+    std::ifstream in(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t lineStart = 0;
+    for (size_t end = text.find('\n'); end != std::string::npos; lineStart = end + 1, end = text.find('\n', lineStart))
+    {
+        std::istringstream line(text.substr(lineStart, end - lineStart));
+        std::string kind;
+        std::getline(line, kind, '\t');
+
+        if (kind == "Q")
+        {
+            Job job;
+            if (!(line >> job.cameraId >> job.doorId >> job.startUs >> job.stopUs) || line.get() != '\t' ||
+                !std::getline(line, job.outputFile) || job.outputFile.empty() || byOutput.count(job.outputFile))
+                continue;
+            byOutput[job.outputFile] = jobs.size();
+            jobs.push_back(job);
+        }
+        else if (kind == "S" || kind == "D")
+        {
+            std::string output;
+            std::getline(line, output);
+            auto it = byOutput.find(output);
+            if (it == byOutput.end())
+                continue;
+            if (kind == "S")
+            {
+                jobs[it->second].attempts++;
+            }
+            else
+            {
+                jobs[it->second].outputFile.clear();  // Finished
+                byOutput.erase(it);
+            }
+        }
+    }
+    if (lineStart < text.size())
+    {
+        logger_->log("ClipJobJournal: Ignoring torn last line of " + path);
+    }
+
+    // Rewrite with the unfinished jobs only, keeping their attempt counts
+    std::string compacted;
+    pending_.clear();
+    outstanding_.clear();
+    for (const auto &job : jobs)
+    {
+        if (job.outputFile.empty())
+            continue;
+        if (job.attempts >= MAX_ATTEMPTS)
+        {
+            logger_->logError("ClipJobJournal: Giving up on " + job.outputFile + " after " +
+                              std::to_string(job.attempts) + " attempts");
+            continue;
+        }
+        compacted += jobLine(job);
+        for (int i = 0; i < job.attempts; i++)
+        {
+            compacted += "S\t" + job.outputFile + "\n";
+        }
+        pending_.push_back(job);
+        outstanding_[job.outputFile] = job.attempts;
+    }
+
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && write(fd, compacted.data(), compacted.size()) == static_cast<ssize_t>(compacted.size());
+    if (fd >= 0)
+    {
+        fsync(fd);
+        ::close(fd);
+    }
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        logger_->logError("ClipJobJournal: Cannot rewrite " + path);
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        logger_->logError("ClipJobJournal: Cannot open " + path);
+        return false;
+    }
+    size_ = static_cast<int64_t>(compacted.size());
+
+    logger_->log("ClipJobJournal: Opened " + path + ", " + std::to_string(pending_.size()) +
+                 " unfinished clip job(s)");
+    return true;
+}
+
+void ClipJobJournal::close()
+{
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0)
+    {
+        if (unsynced_)
+        {
+            fdatasync(fd_);
+            unsynced_ = false;
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool ClipJobJournal::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fd_ >= 0;
+}
+
+std::vector<ClipJobJournal::Job> ClipJobJournal::takePending()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Job> jobs;
+    jobs.swap(pending_);
+    return jobs;
+}
+
+bool ClipJobJournal::accepted(const Job &job, bool deferSync)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (outstanding_.count(job.outputFile))
+        return false;
+
+    outstanding_[job.outputFile] = 0;
+    // The request is only safe once it is on disk
+    if (appendLocked(jobLine(job), !deferSync) && deferSync)
+    {
+        unsynced_ = true;
+    }
+    return true;
+}
+
+void ClipJobJournal::sync()
+{
+    // Requests accepted while this waits on the disk set unsynced_ again
+    // and are covered by the next call
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!unsynced_ || fd_ < 0)
+            return;
+        unsynced_ = false;
+        fd = fd_;
+    }
+    fdatasync(fd);
+}
+
+void ClipJobJournal::started(const std::string &outputFile)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = outstanding_.find(outputFile);
+    if (it == outstanding_.end())
+        return;
+    it->second++;
+    appendLocked("S\t" + outputFile + "\n", false);
+}
+
+void ClipJobJournal::finished(const std::string &outputFile)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (outstanding_.erase(outputFile) == 0)
+        return;
+
+    if (outstanding_.empty() && size_ >= COMPACT_BYTES && fd_ >= 0)
+    {
+        // Nothing left to resume: start over instead of appending
+        if (ftruncate(fd_, 0) == 0)
+        {
+            size_ = 0;
+            return;
+        }
+    }
+    appendLocked("D\t" + outputFile + "\n", false);
+}
+
+bool ClipJobJournal::appendLocked(const std::string &line, bool sync)
+{
+    if (fd_ < 0)
+        return false;
+
+    ssize_t written = write(fd_, line.data(), line.size());
+    if (written != static_cast<ssize_t>(line.size()))
+    {
+        logger_->logError("ClipJobJournal: Write failed on " + path_);
+        return false;
+    }
+    size_ += written;
+    if (sync)
+    {
+        fdatasync(fd_);
+    }
+    return true;
+}
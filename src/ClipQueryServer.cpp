@@ -0,0 +1,271 @@
+#include "ClipQueryServer.h"
+#include <sstream>
+#include <map>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "Common.h"
+
+namespace
+{
+bool makeAddress(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+bool writeAll(int fd, const std::string &data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = ::send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Full timestamp, or "HH:MM[:SS]" meaning today
+bool parseQueryTime(const std::string &value, int64_t &us)
+{
+    std::string text = value;
+    if (text.size() <= 8 && text.find(':') != std::string::npos)
+    {
+        text = getCurrentDateString() + " " + text + (text.size() == 5 ? ":00" : "");
+    }
+
+    std::chrono::system_clock::time_point tp;
+    if (!parseTimestamp(text, tp))
+        return false;
+    us = ClipIndex::wallUs(tp);
+    return true;
+}
+
+std::string formatUs(int64_t us)
+{
+    if (us == ClipIndex::OPEN_END)
+        return "recording";
+    return formatTimestamp(std::chrono::system_clock::time_point(std::chrono::microseconds(us)));
+}
+}
+
+ClipQueryServer::ClipQueryServer(std::shared_ptr<Logger> logger, std::shared_ptr<ClipIndex> index)
+    : logger_(logger), index_(index), listenFd_(-1), running_(false)
+{
+}
+
+ClipQueryServer::~ClipQueryServer()
+{
+    stop();
+}
+
+bool ClipQueryServer::start(const std::string &socketPath)
+{
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address))
+    {
+        logger_->logError("ClipQueryServer: Socket path too long: " + socketPath);
+        return false;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        logger_->logError("ClipQueryServer: socket() failed - " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // A socket file left by a previous run would make bind() fail
+    ::unlink(socketPath.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, 8) != 0)
+    {
+        logger_->logError("ClipQueryServer: Cannot listen on " + socketPath + " - " + strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    ::chmod(socketPath.c_str(), 0660);
+
+    socketPath_ = socketPath;
+    listenFd_ = fd;
+    running_ = true;
+    thread_ = std::thread(&ClipQueryServer::acceptLoop, this);
+    logger_->log("ClipQueryServer: Listening on " + socketPath);
+    return true;
+}
+
+void ClipQueryServer::stop()
+{
+    if (!running_)
+        return;
+
+    running_ = false;
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    ::close(listenFd_);
+    listenFd_ = -1;
+    ::unlink(socketPath_.c_str());
+    logger_->log("ClipQueryServer: Stopped");
+}
+
+void ClipQueryServer::acceptLoop()
+{
+    while (running_)
+    {
+        // Short poll so stop() is noticed without closing the fd under us
+        pollfd pfd{listenFd_, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0)
+            continue;
+
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        // Lookups take microseconds: serve inline, one client at a time
+        timeval timeout{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        serve(fd);
+        ::close(fd);
+    }
+}
+
+void ClipQueryServer::serve(int fd)
+{
+    std::string buffer;
+    char chunk[256];
+
+    while (running_)
+    {
+        size_t newline = buffer.find('\n');
+        if (newline == std::string::npos)
+        {
+            if (buffer.size() > MAX_REQUEST)
+            {
+                writeAll(fd, "ERR request too long\n");
+                return;
+            }
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return;
+            buffer.append(chunk, static_cast<size_t>(n));
+            continue;
+        }
+
+        std::string request = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        if (!request.empty() && request.back() == '\r')
+            request.pop_back();
+
+        if (!writeAll(fd, handle(*index_, request)))
+            return;
+    }
+}
+
+std::string ClipQueryServer::handle(const ClipIndex &index, const std::string &request)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    std::map<std::string, std::string> params;
+    std::istringstream words(request);
+    std::string word;
+    while (words >> word)
+    {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos)
+            return "ERR expected key=value: " + word + "\n";
+        params[word.substr(0, eq)] = word.substr(eq + 1);
+    }
+
+    int64_t fromUs = 0;
+    int64_t toUs = 0;
+    try
+    {
+        if (params.count("at"))
+        {
+            int64_t atUs;
+            if (!parseQueryTime(params["at"], atUs))
+                return "ERR bad time: " + params["at"] + "\n";
+            int64_t windowUs = std::stoll(params.count("window") ? params["window"] : "300") * 1000000;
+            fromUs = atUs - windowUs;
+            toUs = atUs + windowUs;
+        }
+        else if (!params.count("from") || !params.count("to") ||
+                 !parseQueryTime(params["from"], fromUs) || !parseQueryTime(params["to"], toUs))
+        {
+            return "ERR need from= and to=, or at=\n";
+        }
+
+        std::vector<int> cameras;
+        if (params.count("door"))
+            cameras = index.camerasForDoor(std::stoi(params["door"]));
+        else
+            cameras.push_back(params.count("camera") ? std::stoi(params["camera"]) : -1);
+
+        bool sources = params.count("sources") && params["sources"] == "1";
+        std::vector<ClipIndex::Entry> entries;
+        for (int camera : cameras)
+        {
+            std::vector<ClipIndex::Entry> found = index.query(camera, fromUs, toUs, sources);
+            entries.insert(entries.end(), found.begin(), found.end());
+        }
+        auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+
+        std::ostringstream reply;
+        for (const auto &entry : entries)
+        {
+            reply << entry.cameraId << '\t' << (entry.kind == ClipIndex::Kind::Clip ? "clip" : "source")
+                  << '\t' << formatUs(entry.startUs) << '\t' << formatUs(entry.endUs) << '\t'
+                  << entry.path << '\n';
+        }
+        reply << "OK " << entries.size() << ' ' << elapsedUs << '\n';
+        return reply.str();
+    }
+    catch (const std::exception &)
+    {
+        return "ERR bad number\n";
+    }
+}
+
+bool ClipQueryServer::query(const std::string &socketPath, const std::string &request, std::string &reply)
+{
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address))
+        return false;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        !writeAll(fd, request + "\n"))
+    {
+        ::close(fd);
+        return false;
+    }
+    ::shutdown(fd, SHUT_WR);
+
+    // The server answers every line, then closes once it sees our EOF
+    char chunk[4096];
+    ssize_t n;
+    reply.clear();
+    while ((n = ::recv(fd, chunk, sizeof(chunk), 0)) > 0)
+    {
+        reply.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return !reply.empty();
+}
@@ -0,0 +1,839 @@
+#include "ClipUploader.h"
+#include "Common.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+namespace
+{
+// Bytes mapped at a time while taking a CRC
+const int64_t MAP_WINDOW = 8 * 1024 * 1024;
+// Consecutive 409/460 answers before the clip waits for the next retry
+const int MAX_REJECTED_CHUNKS = 3;
+
+std::string hex32(uint32_t value)
+{
+    char text[9];
+    std::snprintf(text, sizeof(text), "%08x", value);
+    return text;
+}
+
+std::string percentEncode(const std::string &segment)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : segment)
+    {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            encoded += static_cast<char>(c);
+        }
+        else
+        {
+            encoded += '%';
+            encoded += digits[c >> 4];
+            encoded += digits[c & 0x0f];
+        }
+    }
+    return encoded;
+}
+
+// Map [offset, offset + length) of fd piece by piece and hand each piece to visit
+bool scanRange(int fd, int64_t offset, int64_t length, const std::function<void(const uint8_t *, size_t)> &visit)
+{
+    static const int64_t page = sysconf(_SC_PAGESIZE);
+    while (length > 0)
+    {
+        int64_t piece = std::min(length, MAP_WINDOW);
+        int64_t aligned = offset - offset % page;
+        size_t skip = static_cast<size_t>(offset - aligned);
+        size_t mapped = skip + static_cast<size_t>(piece);
+
+        void *map = mmap(nullptr, mapped, PROT_READ, MAP_SHARED, fd, aligned);
+        if (map == MAP_FAILED)
+            return false;
+        madvise(map, mapped, MADV_SEQUENTIAL);
+        visit(static_cast<const uint8_t *>(map) + skip, static_cast<size_t>(piece));
+        munmap(map, mapped);
+
+        offset += piece;
+        length -= piece;
+    }
+    return true;
+}
+}
+
+struct ClipUploader::Connection
+{
+    int fd = -1;
+    std::string buffer;  // Received past the last response
+};
+
+struct ClipUploader::Response
+{
+    int status = 0;
+    std::map<std::string, std::string> headers;  // Lower-case names
+    bool keepAlive = true;
+
+    // Upload-Offset, -1 if absent
+    int64_t offset() const
+    {
+        auto it = headers.find("upload-offset");
+        if (it == headers.end())
+            return -1;
+        char *end = nullptr;
+        long long value = std::strtoll(it->second.c_str(), &end, 10);
+        return end != it->second.c_str() && value >= 0 ? value : -1;
+    }
+};
+
+ClipUploader::ClipUploader(std::shared_ptr<Logger> logger)
+    : logger_(logger), port_("80"), bytesPerSecond_(0), parkedBytesPerSecond_(0), concurrency_(2), chunkBytes_(1024 * 1024),
+      retryInterval_(30), statePath_(expandHomePath("~/PassFlow/upload.state")), running_(false), powerMode_(PowerMode::Active), tokens_(0)
+{
+    char hostname[256] = {0};
+    source_ = gethostname(hostname, sizeof(hostname) - 1) == 0 ? hostname : "passflow";
+}
+
+ClipUploader::~ClipUploader()
+{
+    stop();
+}
+
+void ClipUploader::configure(const ConfigIni &config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    source_ = config.getString("Upload", "Source", config.getString("Replication", "Source", source_));
+    bytesPerSecond_ = static_cast<int64_t>(std::max(0, config.getInt("Upload", "MaxKBps", 1024))) * 1024;
+    parkedBytesPerSecond_ = static_cast<int64_t>(std::max(0, config.getInt("Upload", "ParkedMaxKBps", 0))) * 1024;
+    concurrency_ = std::clamp(config.getInt("Upload", "Concurrency", concurrency_), 1, 8);
+    chunkBytes_ = static_cast<int64_t>(std::max(static_cast<int>(SLICE_BYTES / 1024),
+                                                config.getInt("Upload", "ChunkKB", 1024))) * 1024;
+    retryInterval_ = std::chrono::seconds(std::max(1, config.getInt("Upload", "RetrySeconds",
+                                                                    static_cast<int>(retryInterval_.count()))));
+    statePath_ = expandHomePath(config.getString("Upload", "State", statePath_));
+
+    host_.clear();
+    std::string url = config.getString("Upload", "URL", "");
+    if (url.empty())
+        return;
+    if (url.compare(0, 7, "http://") != 0)
+    {
+        logger_->logError("ClipUploader: Only http:// depot URLs are supported, not " + url);
+        return;
+    }
+
+    std::string hostPort = url.substr(7);
+    size_t slash = hostPort.find('/');
+    basePath_ = slash == std::string::npos ? "" : hostPort.substr(slash);
+    while (!basePath_.empty() && basePath_.back() == '/')
+    {
+        basePath_.pop_back();
+    }
+    hostPort = hostPort.substr(0, slash);
+    size_t colon = hostPort.rfind(':');
+    port_ = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+    host_ = hostPort.substr(0, colon);
+
+    loadStateLocked();
+}
+
+void ClipUploader::enqueue(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (host_.empty())
+        return;
+    if (std::any_of(queue_.begin(), queue_.end(), [&](const Item &item) { return item.path == path; }))
+        return;
+
+    queue_.push_back({path});
+    saveStateLocked(true);
+    cv_.notify_all();
+}
+
+void ClipUploader::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ || host_.empty())
+        return;
+
+    running_ = true;
+    retryAt_ = std::chrono::steady_clock::time_point();
+    refilledAt_ = std::chrono::steady_clock::now();
+    tokens_ = SLICE_BYTES;
+    for (int i = 0; i < concurrency_; i++)
+    {
+        workers_.emplace_back(&ClipUploader::workerLoop, this);
+    }
+
+    logger_->log("ClipUploader: Started, depot http://" + host_ + ":" + port_ + basePath_ + ", " +
+                 std::to_string(queue_.size()) + " clip(s) queued, " + std::to_string(concurrency_) +
+                 " connection(s), " +
+                 (bytesPerSecond_ > 0 ? std::to_string(bytesPerSecond_ / 1024) + " KB/s" : std::string("no rate cap")));
+}
+
+void ClipUploader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+
+        // Wake workers blocked in send or receive
+        for (int fd : sockets_)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    cv_.notify_all();
+
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    Stats total = stats();
+    logger_->log("ClipUploader: Stopped: " + std::to_string(total.filesSent) + " clip(s) sent, " +
+                 std::to_string(total.bytesSent / 1024) + " KB, " + std::to_string(total.filesDropped) +
+                 " dropped, " + std::to_string(total.failures) + " failure(s), " +
+                 std::to_string(total.queued) + " still queued");
+}
+
+void ClipUploader::setPowerMode(PowerMode mode)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (mode == powerMode_)
+            return;
+        powerMode_ = mode;
+        if (host_.empty())
+            return;
+
+        int64_t rate = rateLocked();
+        std::string pace = rate > 0 ? std::to_string(rate / 1024) + " KB/s" : std::string("no rate cap");
+        logger_->log("ClipUploader: " + std::string(powerModeName(mode)) + ", " +
+                     (mode == PowerMode::Battery ? std::string("paused after the current chunk") : pace));
+    }
+    cv_.notify_all();
+}
+
+int64_t ClipUploader::rateLocked() const
+{
+    return powerMode_ == PowerMode::Parked ? parkedBytesPerSecond_ : bytesPerSecond_;
+}
+
+bool ClipUploader::waitWhilePaused()
+{
+    // Between chunks, so the depot is never left with a request half sent;
+    // a connection closed by the depot meanwhile is reopened by request()
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !running_ || powerMode_ != PowerMode::Battery; });
+    return running_;
+}
+
+ClipUploader::Stats ClipUploader::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.queued = queue_.size();
+    return stats;
+}
+
+void ClipUploader::workerLoop()
+{
+    // sendfile() has no MSG_NOSIGNAL: keep a depot that hangs up from
+    // raising SIGPIPE; upload() drains it after an EPIPE
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+
+    Connection conn;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        if (std::chrono::steady_clock::now() < retryAt_)
+        {
+            cv_.wait_until(lock, retryAt_);
+            continue;
+        }
+        if (powerMode_ == PowerMode::Battery)
+        {
+            cv_.wait(lock);
+            continue;
+        }
+
+        auto next = std::find_if(queue_.begin(), queue_.end(),
+                                 [this](const Item &item) { return busy_.count(item.path) == 0; });
+        if (next == queue_.end())
+        {
+            cv_.wait(lock);
+            continue;
+        }
+
+        Item item = *next;
+        busy_.insert(item.path);
+        lock.unlock();
+
+        Result result = upload(conn, item);
+
+        lock.lock();
+        busy_.erase(item.path);
+        finishItemLocked(item, result);
+    }
+    lock.unlock();
+
+    closeConnection(conn);
+}
+
+void ClipUploader::finishItemLocked(const Item &item, Result result)
+{
+    if (result == Result::Retry)
+    {
+        if (running_)
+        {
+            // Depot unreachable or failing: all connections wait
+            stats_.failures++;
+            retryAt_ = std::chrono::steady_clock::now() + retryInterval_;
+        }
+        return;
+    }
+
+    auto it = std::find_if(queue_.begin(), queue_.end(), [&](const Item &queued) { return queued.path == item.path; });
+    if (it != queue_.end())
+    {
+        queue_.erase(it);
+    }
+    if (result == Result::Done)
+    {
+        stats_.filesSent++;
+        lastError_.clear();
+    }
+    else
+    {
+        stats_.filesDropped++;
+    }
+    saveStateLocked(false);
+    cv_.notify_all();
+}
+
+void ClipUploader::failed(const std::string &error)
+{
+    // Log each distinct failure once, not on every retry
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error != lastError_ && running_)
+    {
+        logger_->logError("ClipUploader: " + error);
+        lastError_ = error;
+    }
+}
+
+ClipUploader::Result ClipUploader::upload(Connection &conn, Item &item)
+{
+    int fd = open(item.path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        logger_->logError("ClipUploader: " + item.path + " is missing or empty, not uploaded");
+        return Result::Drop;
+    }
+    const int64_t size = st.st_size;
+    const std::string remote = remotePath(item.path);
+
+    auto refused = [&](const std::string &method, int status)
+    {
+        // Server errors are retried, anything else would be refused again
+        failed(method + " " + remote + " answered " + std::to_string(status));
+        return status >= 500 ? Result::Retry : Result::Drop;
+    };
+
+    // Ask the depot how much of the clip it holds
+    Response response;
+    if (!request(conn, "HEAD", remote, "", -1, 0, 0, response))
+    {
+        close(fd);
+        return Result::Retry;
+    }
+    int64_t depotOffset = response.status == 404 ? 0 : response.offset();
+    if ((response.status != 404 && response.status != 200) || depotOffset < 0)
+    {
+        close(fd);
+        return refused("HEAD", response.status);
+    }
+
+    const int64_t resumedAt = depotOffset;
+    const auto begin = std::chrono::steady_clock::now();
+    int rejected = 0;
+    Result result = Result::Retry;
+
+    while (true)
+    {
+        if (depotOffset > size)
+        {
+            logger_->logError("ClipUploader: Depot holds " + std::to_string(depotOffset) + " bytes of " +
+                              remote + ", more than the " + std::to_string(size) + " here");
+            result = Result::Drop;
+            break;
+        }
+        if (depotOffset != item.offset)
+        {
+            // The saved progress is behind (the last acknowledgement was
+            // not saved) or ahead (the depot lost data): continue the
+            // CRC from the depot's offset
+            uint32_t crc = 0;
+            if (!scanRange(fd, 0, depotOffset, [&](const uint8_t *data, size_t length) { crc = crc32(data, length, crc); }))
+            {
+                logger_->logError("ClipUploader: Cannot read " + item.path);
+                result = Result::Drop;
+                break;
+            }
+            item.offset = depotOffset;
+            item.crc = crc;
+        }
+        if (item.offset == size)
+        {
+            result = Result::Done;
+            break;
+        }
+        if (!waitWhilePaused())
+        {
+            break;  // Stopping
+        }
+
+        int64_t length = std::min(chunkBytes_, size - item.offset);
+        uint32_t chunkCrc = 0;
+        uint32_t fileCrc = item.crc;
+        if (!scanRange(fd, item.offset, length, [&](const uint8_t *data, size_t bytes)
+                       {
+                           chunkCrc = crc32(data, bytes, chunkCrc);
+                           fileCrc = crc32(data, bytes, fileCrc);
+                       }))
+        {
+            logger_->logError("ClipUploader: Cannot read " + item.path);
+            result = Result::Drop;
+            break;
+        }
+
+        std::string headers = "Upload-Offset: " + std::to_string(item.offset) + "\r\n" +
+                              "Upload-Length: " + std::to_string(size) + "\r\n" +
+                              "Upload-Checksum: crc32 " + hex32(chunkCrc) + "\r\n" +
+                              "Content-Type: application/offset+octet-stream\r\n";
+        if (item.offset + length == size)
+        {
+            headers += "Upload-CRC32: " + hex32(fileCrc) + "\r\n";
+        }
+
+        if (!request(conn, "PATCH", remote, headers, fd, item.offset, length, response))
+        {
+            break;
+        }
+
+        if ((response.status == 204 || response.status == 200) && response.offset() == item.offset + length)
+        {
+            item.offset += length;
+            item.crc = fileCrc;
+            depotOffset = item.offset;
+            rejected = 0;
+            saveProgress(item, length);
+        }
+        else if ((response.status == 409 || response.status == 460) && response.offset() >= 0 &&
+                 ++rejected <= MAX_REJECTED_CHUNKS)
+        {
+            // Offset or checksum mismatch: continue from what the depot has
+            depotOffset = response.offset();
+            logger_->log("ClipUploader: Depot answered " + std::to_string(response.status) + " for " + remote +
+                         ", continuing at " + std::to_string(depotOffset));
+        }
+        else
+        {
+            result = response.status == 409 || response.status == 460 ? Result::Retry
+                                                                      : refused("PATCH", response.status);
+            break;
+        }
+    }
+    close(fd);
+
+    if (result == Result::Done)
+    {
+        auto ms = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                           std::chrono::steady_clock::now() - begin)
+                                           .count());
+        logger_->log("ClipUploader: Uploaded " + item.path + " (" + std::to_string((size - resumedAt) / 1024) +
+                     " KB in " + std::to_string(ms) + " ms, " +
+                     std::to_string((size - resumedAt) * 1000 / 1024 / ms) + " KB/s" +
+                     (resumedAt > 0 ? ", resumed at " + std::to_string(resumedAt / 1024) + " KB" : "") + ")");
+    }
+    return result;
+}
+
+bool ClipUploader::request(Connection &conn, const std::string &method, const std::string &remote,
+                           const std::string &headers, int bodyFd, int64_t bodyOffset, int64_t bodyLength,
+                           Response &response)
+{
+    std::string head = method + " " + basePath_ + remote + " HTTP/1.1\r\n" +
+                       "Host: " + host_ + (port_ == "80" ? "" : ":" + port_) + "\r\n" +
+                       "User-Agent: PassFlow\r\n" + headers;
+    if (bodyFd >= 0)
+    {
+        head += "Content-Length: " + std::to_string(bodyLength) + "\r\n";
+    }
+    head += "\r\n";
+
+    // A kept-alive connection may have been closed by the depot while
+    // idle; that costs one retry on a new connection
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        bool reused = conn.fd >= 0;
+        if (!reused && !openConnection(conn))
+            return false;
+
+        std::string error;
+        bool sent = true;
+        size_t written = 0;
+        while (sent && written < head.size())
+        {
+            ssize_t n = send(conn.fd, head.data() + written, head.size() - written,
+                             MSG_NOSIGNAL | (bodyLength > 0 ? MSG_MORE : 0));
+            if (n < 0 && errno == EINTR)
+                continue;
+            sent = n > 0;
+            written += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+        // The body goes from the page cache to the socket in slices, each
+        // paid for from the shared bandwidth budget
+        off_t offset = bodyOffset;
+        int64_t remaining = sent ? bodyLength : 0;
+        while (remaining > 0)
+        {
+            size_t slice = static_cast<size_t>(std::min<int64_t>(remaining, SLICE_BYTES));
+            if (!acquireBandwidth(slice))
+            {
+                closeConnection(conn);
+                return false;  // Stopping
+            }
+            while (slice > 0)
+            {
+                ssize_t n = sendfile(conn.fd, bodyFd, &offset, slice);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    if (n < 0 && errno == EPIPE)
+                    {
+                        // Consume the SIGPIPE raised for this thread
+                        sigset_t pipe;
+                        sigemptyset(&pipe);
+                        sigaddset(&pipe, SIGPIPE);
+                        struct timespec zero = {0, 0};
+                        sigtimedwait(&pipe, nullptr, &zero);
+                    }
+                    sent = false;
+                    remaining = 0;
+                    break;
+                }
+                slice -= static_cast<size_t>(n);
+                remaining -= n;
+            }
+        }
+        if (!sent)
+        {
+            error = std::string("sending to the depot failed: ") + std::strerror(errno);
+        }
+
+        // Status line and headers
+        size_t headerEnd = std::string::npos;
+        while (sent && (headerEnd = conn.buffer.find("\r\n\r\n")) == std::string::npos)
+        {
+            char chunk[4096];
+            ssize_t n = recv(conn.fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0 || conn.buffer.size() > 16384)
+            {
+                error = n == 0 ? "depot closed the connection" : "no answer from the depot";
+                sent = false;
+                break;
+            }
+            conn.buffer.append(chunk, static_cast<size_t>(n));
+        }
+
+        if (!sent)
+        {
+            closeConnection(conn);
+            if (reused && attempt == 0)
+                continue;
+            failed(error);
+            return false;
+        }
+
+        response = Response();
+        std::istringstream lines(conn.buffer.substr(0, headerEnd));
+        conn.buffer.erase(0, headerEnd + 4);
+        std::string line;
+        std::string version;
+        std::getline(lines, line);
+        std::istringstream(line) >> version >> response.status;
+        response.keepAlive = version == "HTTP/1.1";
+        while (std::getline(lines, line))
+        {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+                continue;
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of(" \t\r") + 1);
+            response.headers[name] = value;
+        }
+        auto connection = response.headers.find("connection");
+        if (connection != response.headers.end())
+        {
+            std::string value = connection->second;
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            response.keepAlive = value == "keep-alive" || (response.keepAlive && value != "close");
+        }
+
+        // Skip the body, if any; without a length it runs to the close
+        if (method != "HEAD" && response.status != 204 && response.status != 304)
+        {
+            auto length = response.headers.find("content-length");
+            if (length == response.headers.end())
+            {
+                response.keepAlive = false;
+            }
+            else
+            {
+                size_t bodyBytes = static_cast<size_t>(std::strtoull(length->second.c_str(), nullptr, 10));
+                while (conn.buffer.size() < bodyBytes)
+                {
+                    char chunk[4096];
+                    ssize_t n = recv(conn.fd, chunk, sizeof(chunk), 0);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                    {
+                        response.keepAlive = false;
+                        break;
+                    }
+                    conn.buffer.append(chunk, static_cast<size_t>(n));
+                }
+                conn.buffer.erase(0, std::min(bodyBytes, conn.buffer.size()));
+            }
+        }
+
+        if (!response.keepAlive)
+        {
+            closeConnection(conn);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ClipUploader::openConnection(Connection &conn)
+{
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses) != 0)
+    {
+        failed("cannot resolve " + host_);
+        return false;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0)
+            continue;
+
+        // Non-blocking connect, so an unreachable depot costs CONNECT_TIMEOUT
+        // rather than the kernel's minutes
+        int error = 0;
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            error = errno;
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            socklen_t length = sizeof(error);
+            if (error == EINPROGRESS &&
+                poll(&pfd, 1, static_cast<int>(std::chrono::milliseconds(CONNECT_TIMEOUT).count())) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0)
+            {
+                // error now holds the connect result
+            }
+            else if (error == EINPROGRESS)
+            {
+                error = ETIMEDOUT;
+            }
+        }
+        if (error != 0)
+        {
+            close(fd);
+            fd = -1;
+            errno = error;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0)
+    {
+        failed("cannot connect to " + host_ + ":" + port_ + ": " + std::strerror(errno));
+        return false;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    struct timeval timeout = {static_cast<time_t>(IO_TIMEOUT.count()), 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        close(fd);
+        return false;
+    }
+    sockets_.insert(fd);
+    conn.fd = fd;
+    conn.buffer.clear();
+    return true;
+}
+
+void ClipUploader::closeConnection(Connection &conn)
+{
+    if (conn.fd < 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sockets_.erase(conn.fd);
+    }
+    close(conn.fd);
+    conn.fd = -1;
+    conn.buffer.clear();
+}
+
+bool ClipUploader::acquireBandwidth(size_t bytes)
+{
+    // Token bucket shared by all connections, holding at most one slice
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        int64_t rate = rateLocked();
+        if (rate <= 0)
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - refilledAt_).count();
+        refilledAt_ = now;
+        tokens_ = std::min<double>(SLICE_BYTES, tokens_ + elapsed * rate);
+        if (tokens_ >= bytes)
+        {
+            tokens_ -= bytes;
+            return true;
+        }
+        cv_.wait_for(lock, std::chrono::duration<double>((bytes - tokens_) / rate));
+    }
+    return false;
+}
+
+void ClipUploader::saveProgress(const Item &item, int64_t sentBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.bytesSent += static_cast<uint64_t>(sentBytes);
+    auto it = std::find_if(queue_.begin(), queue_.end(), [&](const Item &queued) { return queued.path == item.path; });
+    if (it != queue_.end())
+    {
+        it->offset = item.offset;
+        it->crc = item.crc;
+    }
+    // Not synced: progress lost in a power cut is recovered from the depot
+    saveStateLocked(false);
+}
+
+void ClipUploader::loadStateLocked()
+{
+    // offset <tab> CRC-32 of the sent part <tab> path
+    queue_.clear();
+    std::ifstream file(statePath_);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        Item item;
+        std::string crc;
+        if (!(fields >> item.offset >> crc) || fields.get() != '\t' || !std::getline(fields, item.path) ||
+            item.path.empty())
+            continue;
+        item.crc = static_cast<uint32_t>(std::strtoul(crc.c_str(), nullptr, 16));
+        if (std::none_of(queue_.begin(), queue_.end(), [&](const Item &queued) { return queued.path == item.path; }))
+        {
+            queue_.push_back(item);
+        }
+    }
+
+    if (!queue_.empty())
+    {
+        logger_->log("ClipUploader: " + std::to_string(queue_.size()) + " clip(s) left to upload from " + statePath_);
+    }
+}
+
+void ClipUploader::saveStateLocked(bool sync)
+{
+    std::string text = "# PassFlow upload queue: offset, CRC-32 of the sent part, clip\n";
+    for (const auto &item : queue_)
+    {
+        text += std::to_string(item.offset) + "\t" + hex32(item.crc) + "\t" + item.path + "\n";
+    }
+
+    // Written to a temporary and renamed so a power cut leaves the old one
+    std::string tmpPath = statePath_ + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    if (fd >= 0)
+    {
+        if (sync)
+            fdatasync(fd);
+        close(fd);
+    }
+    if (!ok || std::rename(tmpPath.c_str(), statePath_.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        logger_->logError("ClipUploader: Cannot write " + statePath_);
+    }
+}
+
+std::string ClipUploader::remotePath(const std::string &path) const
+{
+    // <source>/<CamN>/<date>/<file>
+    std::filesystem::path local(path);
+    std::filesystem::path date = local.parent_path();
+    return "/" + percentEncode(source_) + "/" + percentEncode(date.parent_path().filename().string()) + "/" +
+           percentEncode(date.filename().string()) + "/" + percentEncode(local.filename().string());
+}
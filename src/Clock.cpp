@@ -0,0 +1,82 @@
+#include "Clock.h"
+#include <thread>
+
+std::shared_ptr<Clock> Clock::real()
+{
+    static std::shared_ptr<Clock> clock = std::make_shared<RealClock>();
+    return clock;
+}
+
+// RealClock
+
+Timeline::Instant RealClock::now() const
+{
+    return Timeline::now();
+}
+
+std::chrono::system_clock::time_point RealClock::wallNow() const
+{
+    return std::chrono::system_clock::now();
+}
+
+void RealClock::sleepUntil(Timeline::Instant deadline)
+{
+    std::this_thread::sleep_until(deadline);
+}
+
+bool RealClock::waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                          Timeline::Instant deadline, const std::function<bool()> &pred)
+{
+    return cv.wait_until(lock, deadline, pred);
+}
+
+// SimulatedClock
+
+SimulatedClock::SimulatedClock(Timeline::Instant start) : now_(start)
+{
+}
+
+Timeline::Instant SimulatedClock::now() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return now_;
+}
+
+std::chrono::system_clock::time_point SimulatedClock::wallNow() const
+{
+    return Timeline::toWall(now());
+}
+
+void SimulatedClock::sleepUntil(Timeline::Instant deadline)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, deadline] { return now_ >= deadline; });
+}
+
+bool SimulatedClock::waitUntil(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+                               Timeline::Instant deadline, const std::function<bool()> &pred)
+{
+    while (!pred())
+    {
+        if (now() >= deadline)
+            return pred();
+        cv.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void SimulatedClock::advanceTo(Timeline::Instant instant)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (instant <= now_)
+            return;
+        now_ = instant;
+    }
+    cv_.notify_all();
+}
+
+void SimulatedClock::advance(Timeline::Clock::duration duration)
+{
+    advanceTo(now() + duration);
+}
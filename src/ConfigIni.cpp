@@ -0,0 +1,111 @@
+#include "ConfigIni.h"
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+std::string trim(const std::string &str)
+{
+    size_t begin = 0;
+    size_t end = str.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(str[begin])))
+        begin++;
+    while (end > begin && std::isspace(static_cast<unsigned char>(str[end - 1])))
+        end--;
+    return str.substr(begin, end - begin);
+}
+}
+
+bool ConfigIni::load(const std::string &path)
+{
+    path_ = path;
+    sections_.clear();
+
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string section;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';')
+            continue;
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            section = trim(line.substr(1, line.size() - 2));
+            sections_[section];
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+            continue;
+
+        sections_[section][trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+    }
+
+    return true;
+}
+
+bool ConfigIni::hasSection(const std::string &section) const
+{
+    return sections_.count(section) != 0;
+}
+
+std::vector<std::string> ConfigIni::sectionNames() const
+{
+    std::vector<std::string> names;
+    for (const auto &entry : sections_)
+    {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+std::string ConfigIni::getString(const std::string &section, const std::string &key,
+                                 const std::string &defaultValue) const
+{
+    auto sectionIt = sections_.find(section);
+    if (sectionIt == sections_.end())
+        return defaultValue;
+
+    auto keyIt = sectionIt->second.find(key);
+    if (keyIt == sectionIt->second.end())
+        return defaultValue;
+
+    return keyIt->second;
+}
+
+int ConfigIni::getInt(const std::string &section, const std::string &key, int defaultValue) const
+{
+    std::string value = getString(section, key);
+    if (value.empty())
+        return defaultValue;
+
+    try
+    {
+        return std::stoi(value);
+    }
+    catch (const std::exception &)
+    {
+        return defaultValue;
+    }
+}
+
+bool ConfigIni::getBool(const std::string &section, const std::string &key, bool defaultValue) const
+{
+    std::string value = getString(section, key);
+    if (value.empty())
+        return defaultValue;
+
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    return value == "true" || value == "1" || value == "yes" || value == "on";
+}
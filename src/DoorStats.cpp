@@ -0,0 +1,85 @@
+#include "DoorStats.h"
+#include <algorithm>
+#include <ctime>
+
+namespace
+{
+int64_t epochMs(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+std::string formatBucket(int64_t ms)
+{
+    std::time_t t = static_cast<std::time_t>(ms / 1000);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+    return buffer;
+}
+}
+
+DoorStats::DoorStats(std::chrono::seconds bucket)
+    : bucket_(bucket)
+{
+}
+
+void DoorStats::setBucket(std::chrono::seconds bucket)
+{
+    if (bucket.count() > 0 && 86400 % bucket.count() == 0)
+    {
+        bucket_ = bucket;
+    }
+}
+
+int64_t DoorStats::bucketStart(int64_t ms) const
+{
+    // Align to local time so hourly buckets start on the hour in any zone
+    std::time_t t = static_cast<std::time_t>(ms / 1000);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    int64_t local = ms + static_cast<int64_t>(tm.tm_gmtoff) * 1000;
+    int64_t length = bucket_.count() * 1000;
+    int64_t offset = ((local % length) + length) % length;
+    return ms - offset;
+}
+
+void DoorStats::doorOpenPeriod(int door, std::chrono::system_clock::time_point opened,
+                               std::chrono::system_clock::time_point closed)
+{
+    int64_t from = epochMs(opened);
+    int64_t to = std::max(epochMs(closed), from);
+
+    Totals &first = pending_[{door, bucketStart(from)}];
+    first.openCount++;
+    first.maxOpenMs = std::max(first.maxOpenMs, to - from);
+
+    while (from < to)
+    {
+        int64_t start = bucketStart(from);
+        int64_t end = std::min(to, start + bucket_.count() * 1000);
+        pending_[{door, start}].openMs += end - from;
+        from = end;
+    }
+}
+
+void DoorStats::coverOpened(int cover, std::chrono::system_clock::time_point at)
+{
+    pending_[{cover, bucketStart(epochMs(at))}].coverOpenCount++;
+}
+
+std::vector<DoorStatsRecord> DoorStats::takePending()
+{
+    std::vector<DoorStatsRecord> records;
+    records.reserve(pending_.size());
+    for (const auto &entry : pending_)
+    {
+        const Totals &totals = entry.second;
+        records.push_back({entry.first.first, formatBucket(entry.first.second),
+                           static_cast<int>(bucket_.count()), totals.openCount, totals.openMs,
+                           totals.maxOpenMs, totals.coverOpenCount});
+    }
+    pending_.clear();
+    return records;
+}
@@ -0,0 +1,162 @@
+#include "InitGraph.h"
+#include <thread>
+#include <sstream>
+#include <iomanip>
+
+InitGraph::InitGraph(std::shared_ptr<Logger> logger)
+    : logger_(logger)
+{
+}
+
+void InitGraph::add(const std::string &name, std::vector<std::string> deps, Task task,
+                    bool required)
+{
+    Phase phase;
+    phase.name = name;
+    phase.deps = std::move(deps);
+    phase.task = std::move(task);
+    phase.required = required;
+    phases_.push_back(std::move(phase));
+}
+
+const InitGraph::Phase *InitGraph::find(const std::string &name) const
+{
+    for (const auto &phase : phases_)
+    {
+        if (phase.name == name)
+            return &phase;
+    }
+    return nullptr;
+}
+
+const char *InitGraph::stateName(State state)
+{
+    switch (state)
+    {
+    case State::Done:
+        return "ok";
+    case State::Failed:
+        return "FAILED";
+    case State::Skipped:
+        return "skipped";
+    default:
+        return "incomplete";
+    }
+}
+
+void InitGraph::runPhase(Phase *phase)
+{
+    bool ok = false;
+    try
+    {
+        ok = phase->task();
+    }
+    catch (const std::exception &e)
+    {
+        logger_->logError("Init phase " + phase->name + " threw: " + e.what());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    phase->end = std::chrono::steady_clock::now();
+    phase->state = ok ? State::Done : State::Failed;
+    cv_.notify_all();
+}
+
+bool InitGraph::run()
+{
+    std::vector<std::thread> threads;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        bool progress = false;
+        size_t unfinished = 0;
+
+        for (auto &phase : phases_)
+        {
+            if (phase.state == State::Running)
+                unfinished++;
+            if (phase.state != State::Pending)
+                continue;
+
+            bool ready = true;
+            bool blocked = false;
+            for (const auto &dep : phase.deps)
+            {
+                const Phase *depPhase = find(dep);
+                if (depPhase == nullptr || depPhase->state == State::Failed ||
+                    depPhase->state == State::Skipped)
+                {
+                    blocked = true;
+                }
+                else if (depPhase->state != State::Done)
+                {
+                    ready = false;
+                }
+            }
+
+            if (blocked)
+            {
+                phase.state = State::Skipped;
+                progress = true;
+            }
+            else if (ready)
+            {
+                phase.state = State::Running;
+                phase.start = std::chrono::steady_clock::now();
+                unfinished++;
+                progress = true;
+
+                threads.emplace_back(&InitGraph::runPhase, this, &phase);
+            }
+            else
+            {
+                unfinished++;
+            }
+        }
+
+        if (progress)
+            continue;
+        if (unfinished == 0)
+            break;
+
+        cv_.wait(lock);
+    }
+
+    lock.unlock();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const auto &phase : phases_)
+    {
+        if (phase.required && phase.state != State::Done)
+            return false;
+    }
+    return true;
+}
+
+void InitGraph::logReport()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto origin = processStartTime();
+
+    logger_->log("Startup timing (ms since process start):");
+    for (const auto &phase : phases_)
+    {
+        std::stringstream line;
+        line << "  " << std::left << std::setw(16) << phase.name << " ";
+
+        if (phase.state == State::Done || phase.state == State::Failed)
+        {
+            auto startMs = std::chrono::duration_cast<std::chrono::milliseconds>(phase.start - origin).count();
+            auto endMs = std::chrono::duration_cast<std::chrono::milliseconds>(phase.end - origin).count();
+            line << "start " << std::right << std::setw(6) << startMs
+                 << "  end " << std::setw(6) << endMs
+                 << "  took " << std::setw(6) << (endMs - startMs) << "  ";
+        }
+        line << stateName(phase.state);
+        logger_->log(line.str());
+    }
+}
@@ -6,16 +6,30 @@
 #include <dirent.h>
 #include <cstring>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <cerrno>
+#include <algorithm>
 
 MainControl::MainControl(std::shared_ptr<Logger> logger,
                          std::shared_ptr<MessageQueue<Message>> videoControlQueue,
-                         std::shared_ptr<MySqlComm> dbComm)
-    : logger_(logger), videoControlQueue_(videoControlQueue), dbComm_(dbComm),
-      running_(false), serialFd_(-1)
+                         std::shared_ptr<MySqlComm> dbComm,
+                         std::shared_ptr<Clock> clock)
+    : logger_(logger), videoControlQueue_(videoControlQueue), dbComm_(dbComm), clock_(clock),
+      outgoingQueue_(clock), running_(false), serialFd_(-1), inotifyFd_(-1), linkUp_(false),
+      awaitingResync_(false), pendingByte_(0), havePendingByte_(false), reactor_(nullptr), tickTimer_(-1),
+      ignitionMask_(0), mainSupplyMask_(0), framesReceived_(0)
 {
     // Initialize status to default (all doors open, power off)
     currentStatus_ = SystemStatus_t();
     previousStatus_ = SystemStatus_t();
+
+    // Default 2-door layout until configureDoors() is called
+    doors_.resize(2);
+    coalescer_.configure(2);
+    statusBits_ = defaultStatusBitMap();
+    buildDispatchTable();
 }
 
 MainControl::~MainControl()
@@ -28,17 +42,120 @@ void MainControl::updateSettings(int stopBeginDelay, int stopEndDelay)
     stopBeginDelay_ = stopBeginDelay;
     stopEndDelay_ = stopEndDelay;
     logger_->log("MainControl: Updated delays - stopBeginDelay=" +
-                 std::to_string(stopBeginDelay_) + "s, stopEndDelay=" +
-                 std::to_string(stopEndDelay_) + "s");
+                 std::to_string(stopBeginDelay) + "s, stopEndDelay=" +
+                 std::to_string(stopEndDelay) + "s");
+}
+
+void MainControl::configureDoors(int doors, const StatusBitMap &statusBits)
+{
+    statusBits_ = statusBits;
+
+    // Size the door array to cover both the configured count and every
+    // door referenced by the bit map
+    int count = std::max(doors, 0);
+    for (const auto &role : statusBits_)
+    {
+        if (role.kind == StatusBitKind::Door)
+        {
+            count = std::max(count, role.index + 1);
+        }
+    }
+    doors_.assign(std::min(count, MAX_DOORS), DoorState());
+    coalescer_.configure(static_cast<int>(doors_.size()));
+
+    buildDispatchTable();
+
+    logger_->log("MainControl: Configured " + std::to_string(doors_.size()) + " door(s)");
+}
+
+void MainControl::setGlitchThreshold(std::chrono::milliseconds threshold)
+{
+    coalescer_.setGlitchThreshold(threshold);
+    logger_->log("MainControl: Door glitch threshold " + std::to_string(threshold.count()) + "ms");
+}
+
+void MainControl::setLowPowerAfter(std::chrono::seconds after)
+{
+    power_.setLowPowerAfter(after);
+    if (ignitionMask_ == 0)
+    {
+        logger_->log("MainControl: No ignition bit in the status layout - low power mode off");
+    }
+    else if (after.count() <= 0)
+    {
+        logger_->log("MainControl: Low power mode off");
+    }
+    else
+    {
+        logger_->log("MainControl: Low power after " + std::to_string(after.count()) + "s with the ignition off");
+    }
+}
+
+void MainControl::setStatsBucket(std::chrono::seconds bucket)
+{
+    doorStats_.setBucket(bucket);
+    logger_->log("MainControl: Door statistics per " + std::to_string(doorStats_.bucket().count()) + "s");
+}
+
+bool MainControl::setStatusSharedMemory(const std::string &name)
+{
+    auto writer = std::make_unique<StatusShmWriter>(logger_);
+    if (!writer->open(name))
+        return false;
+
+    statusShm_ = std::move(writer);
+    return true;
+}
+
+bool MainControl::setStatusJournal(const std::string &path)
+{
+    auto journal = std::make_unique<StatusJournal>(logger_);
+    if (!journal->open(path))
+        return false;
+
+    journal_ = std::move(journal);
+    return true;
+}
+
+void MainControl::buildDispatchTable()
+{
+    ignitionMask_ = 0;
+    mainSupplyMask_ = 0;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+        if (statusBits_[bit].kind == StatusBitKind::Ignition)
+            ignitionMask_ |= 1 << bit;
+        else if (statusBits_[bit].kind == StatusBitKind::MainSupply)
+            mainSupplyMask_ |= 1 << bit;
+    }
+
+    // Precompute, for every possible set of changed bits, which roles are
+    // affected so processing a frame never depends on the number of doors
+    for (int mask = 0; mask < 256; mask++)
+    {
+        StatusChangeList &list = dispatchTable_[mask];
+        list.count = 0;
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            if ((mask & (1 << bit)) == 0 || statusBits_[bit].kind == StatusBitKind::Unused)
+                continue;
+
+            list.bits[list.count] = bit;
+            list.roles[list.count] = statusBits_[bit];
+            list.count++;
+        }
+    }
 }
 
-bool MainControl::findCH340Device()
+bool MainControl::findCH340Device(bool verbose)
 {
     // Search for CH340 USB-Serial device
     DIR *dir = opendir("/sys/bus/usb-serial/devices");
     if (!dir)
     {
-        logger_->logError("Cannot open /sys/bus/usb-serial/devices");
+        if (verbose)
+            logger_->logError("Cannot open /sys/bus/usb-serial/devices");
         return false;
     }
 
@@ -63,7 +180,8 @@ bool MainControl::findCH340Device()
             {
                 serialPort_ = devicePath;
                 closedir(dir);
-                logger_->log("Found CH340 device: " + serialPort_);
+                if (verbose)
+                    logger_->log("Found CH340 device: " + serialPort_);
                 return true;
             }
         }
@@ -78,25 +196,33 @@ bool MainControl::findCH340Device()
         if (access(device.c_str(), F_OK) == 0)
         {
             serialPort_ = device;
-            logger_->log("Using fallback device: " + serialPort_);
+            if (verbose)
+                logger_->log("Using fallback device: " + serialPort_);
             return true;
         }
     }
 
-    logger_->logError("CH340 device not found");
+    if (verbose)
+        logger_->logError("CH340 device not found");
     return false;
 }
 
-bool MainControl::openSerialPort()
+bool MainControl::openSerialPort(bool verbose)
 {
-    serialFd_ = open(serialPort_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    int fd = open(serialPort_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
 
-    if (serialFd_ < 0)
+    if (fd < 0)
     {
-        logger_->logError("Failed to open serial port: " + serialPort_);
+        if (verbose)
+            logger_->logError("Failed to open serial port: " + serialPort_);
         return false;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(serialMutex_);
+        serialFd_ = fd;
+    }
+
     logger_->log("Serial port opened: " + serialPort_);
     return true;
 }
@@ -149,28 +275,159 @@ void MainControl::configureSerialPort()
     logger_->log("Serial port configured: 115200 8N1");
 }
 
-bool MainControl::initialize()
+void MainControl::watchDevices()
 {
-    if (!findCH340Device())
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0 || inotify_add_watch(inotifyFd_, "/dev", IN_CREATE | IN_ATTRIB) < 0)
     {
+        logger_->logError("MainControl: Cannot watch /dev for the serial device, retrying every " +
+                          std::to_string(REOPEN_INTERVAL.count()) + "ms after a link loss");
+        if (inotifyFd_ >= 0)
+        {
+            close(inotifyFd_);
+            inotifyFd_ = -1;
+        }
+    }
+}
+
+bool MainControl::drainDeviceEvents()
+{
+    if (inotifyFd_ < 0)
         return false;
+
+    // IN_ATTRIB as well: udev may fix the node's permissions after creating it
+    alignas(inotify_event) char buffer[4096];
+    bool serialNode = false;
+    ssize_t n;
+    while ((n = read(inotifyFd_, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + n;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+            if (event->len > 0 && strncmp(event->name, "ttyUSB", 6) == 0)
+                serialNode = true;
+            p += sizeof(inotify_event) + event->len;
+        }
     }
+    return serialNode && !linkUp_;
+}
+
+void MainControl::onLinkLost(const std::string &reason)
+{
+    if (!linkUp_)
+        return;
 
-    if (!openSerialPort())
+    linkUp_ = false;
+    havePendingByte_ = false;
+    linkCounters_.losses++;
+    linkLostAt_ = clock_->now();
+    nextReopen_ = linkLostAt_ + REOPEN_INTERVAL;
+    logger_->logError("MainControl: Serial link lost on " + serialPort_ + " (" + reason +
+                      "), waiting for the device");
+    publishStatus(linkLostAt_);
+
+    if (reactor_)
     {
+        reactor_->removeFd(serialFd_);
+    }
+
+    std::lock_guard<std::mutex> lock(serialMutex_);
+    close(serialFd_);
+    serialFd_ = -1;
+}
+
+bool MainControl::reopenSerialPort()
+{
+    nextReopen_ = clock_->now() + REOPEN_INTERVAL;
+    if (linkUp_)
+        return true;
+
+    // The adapter may come back under another name after re-enumeration
+    if (!findCH340Device(false) || !openSerialPort(false))
         return false;
+
+    configureSerialPort();
+    tcflush(serialFd_, TCIFLUSH);  // Drop any half frame buffered before the reset
+    linkUp_ = true;
+    awaitingResync_ = true;
+
+    if (reactor_)
+    {
+        watchSerial();
+    }
+    publishStatus(clock_->now());
+
+    logger_->log("MainControl: Reopened serial port " + serialPort_ + " " +
+                 std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    clock_->now() - linkLostAt_)
+                                    .count()) +
+                 "ms after the link was lost");
+    return true;
+}
+
+void MainControl::watchSerial()
+{
+    reactor_->addFd(serialFd_, EPOLLIN, [this](uint32_t events)
+                    {
+                        while (readSerial() > 0)
+                        {
+                        }
+                        if (linkUp_ && (events & (EPOLLHUP | EPOLLERR)))
+                        {
+                            onLinkLost("hang-up");
+                        }
+                    });
+}
+
+bool MainControl::initialize()
+{
+    if (!findCH340Device() || !openSerialPort())
+    {
+        // Start without the adapter: the device watch or the reopen
+        // interval opens it once it is plugged in (or its node becomes
+        // accessible), as after a link loss
+        linkUp_ = false;
+        linkLostAt_ = clock_->now();
+        nextReopen_ = linkLostAt_;
+        logger_->logError("MainControl: No serial device yet, waiting for it");
+        return true;
     }
 
     configureSerialPort();
+    linkUp_ = true;
     return true;
 }
 
 void MainControl::start()
 {
     running_ = true;
+    nextResync_ = clock_->now();
+    nextStatsFlush_ = clock_->now() + STATS_FLUSH_INTERVAL;
+    publishStatus(clock_->now());
 
-    receiverThread_ = std::thread(&MainControl::receiverLoop, this);
-    senderThread_ = std::thread(&MainControl::senderLoop, this);
+    watchDevices();
+
+    if (reactor_)
+    {
+        if (linkUp_)
+        {
+            watchSerial();
+        }
+        if (inotifyFd_ >= 0)
+        {
+            reactor_->addFd(inotifyFd_, EPOLLIN, [this](uint32_t)
+                            {
+                                if (drainDeviceEvents())
+                                    reopenSerialPort();
+                            });
+        }
+        armTick(power_.lowPower() ? LOW_POWER_TICK : TICK_INTERVAL);
+    }
+    else
+    {
+        receiverThread_ = std::thread(&MainControl::receiverLoop, this);
+        senderThread_ = std::thread(&MainControl::senderLoop, this);
+    }
 
     logger_->log("MainControl started");
 }
@@ -182,6 +439,13 @@ void MainControl::stop()
         running_ = false;
         outgoingQueue_.requestShutdown();
 
+        if (reactor_)
+        {
+            reactor_->removeFd(serialFd_);
+            reactor_->removeFd(inotifyFd_);
+            reactor_->cancelTimer(tickTimer_);
+        }
+
         if (receiverThread_.joinable())
         {
             receiverThread_.join();
@@ -192,6 +456,37 @@ void MainControl::stop()
             senderThread_.join();
         }
 
+        // Hand over windows still waiting for their stop time
+        emitClips(coalescer_.flush());
+        flushStats();
+        const ClipCoalescer::Counters &counters = coalescer_.counters();
+        logger_->log("MainControl: Clip requests " + std::to_string(counters.emitted) +
+                     ", merged edges " + std::to_string(counters.merged) +
+                     ", suppressed glitches " + std::to_string(counters.suppressed));
+        logger_->log("MainControl: Serial link losses " + std::to_string(linkCounters_.losses) +
+                     ", recoveries " + std::to_string(linkCounters_.recoveries) +
+                     ", slowest recovery " + std::to_string(linkCounters_.maxRecoveryMs) + "ms");
+        logger_->log("MainControl: Power " + power_.summary(clock_->now()));
+
+        // Readers see the daemon as stopped from here on
+        if (statusShm_)
+        {
+            statusShm_->close();
+        }
+
+        // Finish the open chunk so the next run appends after a complete one
+        if (journal_)
+        {
+            journal_->close();
+        }
+
+        if (inotifyFd_ >= 0)
+        {
+            close(inotifyFd_);
+            inotifyFd_ = -1;
+        }
+
+        std::lock_guard<std::mutex> lock(serialMutex_);
         if (serialFd_ >= 0)
         {
             close(serialFd_);
@@ -210,234 +505,457 @@ bool MainControl::validateStatusMessage(uint8_t status, uint8_t invStatus)
 
 void MainControl::receiverLoop()
 {
-    uint8_t buffer[256];
-    uint8_t pendingByte = 0;
-    bool havePendingByte = false;
-
     while (running_)
     {
-        int bytesRead = read(serialFd_, buffer, sizeof(buffer));
-
-        if (bytesRead > 0)
+        if (linkUp_)
         {
-            for (int i = 0; i < bytesRead; i++)
-            {
-                if (!havePendingByte)
-                {
-                    // First byte of the pair - this is SystemStatus
-                    pendingByte = buffer[i];
-                    havePendingByte = true;
-                }
-                else
-                {
-                    // Second byte - this should be ~SystemStatus!!!==============
-                    uint8_t invByte = buffer[i];
-
-                    if (validateStatusMessage(pendingByte, invByte))
-                    {
-                        // Valid message received
-                        SystemStatus_t newStatus = SystemStatus_t::fromByte(pendingByte);
+            readSerial();
+        }
+        else if (drainDeviceEvents())
+        {
+            reopenSerialPort();
+        }
 
-                        logger_->logCommand("Received valid SystemStatus: 0x" +
-                                            std::string(1, "0123456789ABCDEF"[pendingByte >> 4]) +
-                                            std::string(1, "0123456789ABCDEF"[pendingByte & 0x0F]));
+        tick(clock_->now());
 
-                        processSystemStatus(newStatus);
-                    }
-                    else
-                    {
-                        // Invalid message - validation failed
-                        logger_->logError("Invalid SystemStatus message: status=0x" +
-                                          std::string(1, "0123456789ABCDEF"[pendingByte >> 4]) +
-                                          std::string(1, "0123456789ABCDEF"[pendingByte & 0x0F]) +
-                                          " inv=0x" +
-                                          std::string(1, "0123456789ABCDEF"[invByte >> 4]) +
-                                          std::string(1, "0123456789ABCDEF"[invByte & 0x0F]));
-                    }
-
-                    havePendingByte = false;
-                }
-            }
+        if (power_.lowPower() && linkUp_)
+        {
+            // Nothing happens between frames: sleep until the next byte
+            // instead of polling, so waking up costs no extra latency
+            struct pollfd serial = {serialFd_, POLLIN, 0};
+            poll(&serial, 1, static_cast<int>(LOW_POWER_TICK.count()));
+        }
+        else
+        {
+            clock_->sleepFor(std::chrono::milliseconds(10));
         }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 }
 
-void MainControl::senderLoop()
+int MainControl::readSerial()
 {
-    while (running_)
+    if (!linkUp_)
+        return -1;
+
+    uint8_t buffer[256];
+    int bytesRead = read(serialFd_, buffer, sizeof(buffer));
+
+    // The port is non-blocking, so 0 means the tty was hung up (device
+    // unplugged or reset) and EIO that the USB device has gone
+    if (bytesRead == 0)
     {
-        auto cmdOpt = outgoingQueue_.tryPop(std::chrono::milliseconds(100));
+        onLinkLost("hung up");
+        return -1;
+    }
+    if (bytesRead < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+            onLinkLost(strerror(errno));
+        return -1;
+    }
 
-        if (cmdOpt.has_value())
+    for (int i = 0; i < bytesRead; i++)
+    {
+        if (!havePendingByte_)
         {
-            uint8_t byte = static_cast<uint8_t>(cmdOpt.value());
-            ssize_t written = write(serialFd_, &byte, 1);
+            // First byte of the pair - this is SystemStatus
+            pendingByte_ = buffer[i];
+            havePendingByte_ = true;
+        }
+        else
+        {
+            // Second byte - this should be ~SystemStatus!!!==============
+            uint8_t invByte = buffer[i];
 
-            if (written < 0)
+            if (validateStatusMessage(pendingByte_, invByte))
             {
-                logger_->logError("Failed to write to serial port");
+                // Valid message received
+                SystemStatus_t newStatus = SystemStatus_t::fromByte(pendingByte_);
+
+                logger_->logCommand("Received valid SystemStatus: 0x" +
+                                    std::string(1, "0123456789ABCDEF"[pendingByte_ >> 4]) +
+                                    std::string(1, "0123456789ABCDEF"[pendingByte_ & 0x0F]));
+
+                if (awaitingResync_)
+                {
+                    // Doors that changed while the link was down are
+                    // dispatched as edges by comparing with the last frame
+                    awaitingResync_ = false;
+                    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     clock_->now() - linkLostAt_)
+                                     .count();
+                    linkCounters_.recoveries++;
+                    linkCounters_.lastRecoveryMs = ms;
+                    linkCounters_.maxRecoveryMs = std::max(linkCounters_.maxRecoveryMs, ms);
+                    logger_->log("MainControl: Serial link recovered in " + std::to_string(ms) +
+                                 "ms, resynchronizing door state");
+                }
+
+                processSystemStatus(newStatus);
             }
             else
             {
-                logger_->log("Sent command: 0x" +
-                             std::string(1, "0123456789ABCDEF"[byte >> 4]) +
-                             std::string(1, "0123456789ABCDEF"[byte & 0x0F]));
+                // Invalid message - validation failed
+                logger_->logError("Invalid SystemStatus message: status=0x" +
+                                  std::string(1, "0123456789ABCDEF"[pendingByte_ >> 4]) +
+                                  std::string(1, "0123456789ABCDEF"[pendingByte_ & 0x0F]) +
+                                  " inv=0x" +
+                                  std::string(1, "0123456789ABCDEF"[invByte >> 4]) +
+                                  std::string(1, "0123456789ABCDEF"[invByte & 0x0F]));
             }
+
+            havePendingByte_ = false;
         }
     }
+
+    return bytesRead;
 }
 
-void MainControl::processSystemStatus(const SystemStatus_t &newStatus)
+void MainControl::tick(Timeline::Instant now)
 {
-    auto now = std::chrono::system_clock::now();
+    emitClips(coalescer_.poll(now));
 
-    // Compare with previous status and log changes
-    compareAndLogChanges(currentStatus_, newStatus);
-
-    // Update previous status
-    previousStatus_ = currentStatus_;
-    currentStatus_ = newStatus;
+    // An open door or a clip window still to come keeps the cameras
+    // recording; the idle time counts from the last of them
+    PowerMode from = power_.mode();
+    if (coalescer_.idle() ? power_.poll(now) : power_.activity(now))
+    {
+        std::string reason = power_.lowPower()
+                                 ? "ignition off for " + std::to_string(power_.lowPowerAfter().count()) + "s"
+                                 : "door activity";
+        onPowerModeChanged(from, reason, now);
+    }
 
-    // Handle door state changes for video recording
+    if (!linkUp_ && now >= nextReopen_)
+    {
+        reopenSerialPort();
+    }
 
-    // Door 0: was closed (1), now open (0)
-    if (previousStatus_.door_0 == 1 && newStatus.door_0 == 0)
+    if (now >= nextResync_)
     {
-        door0OpenTime_ = now;
-        door0Open_ = true;
-        sendCommand(PeripheralCommand::Cam0ON);
-        sendCommand(PeripheralCommand::Light0ON);
-        logger_->log("Door 0 opened - camera and light ON");
+        checkWallClock();
+        nextResync_ = now + std::chrono::seconds(1);
     }
-    // Door 0: was open (0), now closed (1)
-    else if (previousStatus_.door_0 == 0 && newStatus.door_0 == 1)
+
+    if (now >= nextStatsFlush_)
     {
-        if (door0Open_)
-        {
-            door0Open_ = false;
+        flushStats();
+        nextStatsFlush_ = now + STATS_FLUSH_INTERVAL;
+    }
+}
 
-            // Calculate start and stop times with delays
-            // start_date_time = datetime(Door open) - stopBeginDelay
-            // stop_date_time = datetime(Door close) + stopEndDelay
-            auto startTime = door0OpenTime_ - std::chrono::seconds(stopBeginDelay_);
-            auto stopTime = now + std::chrono::seconds(stopEndDelay_);
+void MainControl::armTick(std::chrono::milliseconds interval)
+{
+    reactor_->cancelTimer(tickTimer_);
+    tickTimer_ = reactor_->addTimer(clock_->now() + interval, [this]()
+                                    { tick(clock_->now()); },
+                                    interval);
+}
 
-            // Send single message with both start and stop times
-            auto msg = Message::createStartStop(0, startTime, stopTime);
-            videoControlQueue_->push(msg);
+void MainControl::checkWallClock()
+{
+    // Door windows are on the monotonic timeline; only the wall-clock
+    // mapping used for filenames and DB rows follows the step
+    auto step = Timeline::resync();
+    if (step >= Timeline::STEP_THRESHOLD || step <= -Timeline::STEP_THRESHOLD)
+    {
+        logger_->log("MainControl: Wall clock stepped by " + std::to_string(step.count()) +
+                     "ms (now " + formatTimestamp(Timeline::now()) + "), clip timing unaffected");
+    }
+}
 
-            // Turn off camera and light after the delay
-            sendCommand(PeripheralCommand::Cam0OFF);
-            sendCommand(PeripheralCommand::Light0OFF);
+void MainControl::senderLoop()
+{
+    while (running_)
+    {
+        auto cmdOpt = outgoingQueue_.tryPop(std::chrono::milliseconds(100));
 
-            logger_->log("Door 0 closed - sending video segment request with delays");
+        if (cmdOpt.has_value())
+        {
+            writeCommand(static_cast<uint8_t>(cmdOpt.value()));
         }
     }
+}
+
+void MainControl::writeCommand(uint8_t byte)
+{
+    std::lock_guard<std::mutex> lock(serialMutex_);
+    ssize_t written = serialFd_ >= 0 ? write(serialFd_, &byte, 1) : -1;
 
-    // Door 1: was closed (1), now open (0)
-    if (previousStatus_.door_1 == 1 && newStatus.door_1 == 0)
+    if (written < 0)
     {
-        door1OpenTime_ = now;
-        door1Open_ = true;
-        sendCommand(PeripheralCommand::Cam1ON);
-        sendCommand(PeripheralCommand::Light1ON);
-        logger_->log("Door 1 opened - camera and light ON");
+        logger_->logError("Failed to write to serial port" + std::string(serialFd_ < 0 ? " (link down)" : ""));
     }
-    // Door 1: was open (0), now closed (1)
-    else if (previousStatus_.door_1 == 0 && newStatus.door_1 == 1)
+    else
     {
-        if (door1Open_)
-        {
-            door1Open_ = false;
+        logger_->log("Sent command: 0x" +
+                     std::string(1, "0123456789ABCDEF"[byte >> 4]) +
+                     std::string(1, "0123456789ABCDEF"[byte & 0x0F]));
+    }
+}
+
+void MainControl::processSystemStatus(const SystemStatus_t &newStatus)
+{
+    auto now = clock_->now();
 
-            // Calculate start and stop times with delays
-            auto startTime = door1OpenTime_ - std::chrono::seconds(stopBeginDelay_);
-            auto stopTime = now + std::chrono::seconds(stopEndDelay_);
+    uint8_t oldByte = currentStatus_.toByte();
+    uint8_t newByte = newStatus.toByte();
 
-            // Send single message with both start and stop times
-            auto msg = Message::createStartStop(1, startTime, stopTime);
-            videoControlQueue_->push(msg);
+    // The first frame is kept too, so every run starts from a full state
+    if (journal_ && (oldByte != newByte || framesReceived_ == 0))
+    {
+        journal_->append(std::chrono::duration_cast<std::chrono::milliseconds>(
+                             Timeline::toWall(now).time_since_epoch())
+                             .count(),
+                         newByte);
+    }
 
-            // Turn off camera and light after the delay
-            sendCommand(PeripheralCommand::Cam1OFF);
-            sendCommand(PeripheralCommand::Light1OFF);
+    // Update previous status
+    previousStatus_ = currentStatus_;
+    currentStatus_ = newStatus;
 
-            logger_->log("Door 1 closed - sending video segment request with delays");
+    // Dispatch every changed bit through the precomputed table
+    const StatusChangeList &changes = dispatchTable_[oldByte ^ newByte];
+    for (uint8_t i = 0; i < changes.count; i++)
+    {
+        bool bitSet = (newByte >> changes.bits[i]) & 1;
+        handleStatusChange(changes.roles[i], bitSet, now);
+    }
+
+    if (ignitionMask_ != 0)
+    {
+        bool ignition = (newByte & ignitionMask_) != 0;
+        bool mainSupply = mainSupplyMask_ == 0 || (newByte & mainSupplyMask_) != 0;
+        PowerMode from = power_.mode();
+        if (power_.update(ignition, mainSupply, now))
+        {
+            onPowerModeChanged(from, std::string("ignition ") + (ignition ? "ON" : "OFF") + ", main supply " +
+                                         (mainSupply ? "ON" : "OFF"),
+                               now);
         }
     }
+
+    framesReceived_++;
+    publishStatus(now);
 }
 
-void MainControl::compareAndLogChanges(const SystemStatus_t &oldStatus, const SystemStatus_t &newStatus)
+void MainControl::publishStatus(Timeline::Instant now)
+{
+    if (!statusShm_)
+        return;
+
+    auto wallUs = [](Timeline::Instant instant)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   Timeline::toWall(instant).time_since_epoch())
+            .count();
+    };
+
+    StatusShmData data{};
+    data.frames = framesReceived_;
+    data.updatedWallUs = wallUs(now);
+    data.updatedMonoNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    data.linkLosses = linkCounters_.losses;
+    data.status = currentStatus_.toByte();
+    data.running = 1;
+    data.linkUp = linkUp_ ? 1 : 0;
+    data.doorCount = static_cast<uint8_t>(doors_.size());
+    for (int bit = 0; bit < 8; bit++)
+    {
+        data.bitKind[bit] = static_cast<uint8_t>(statusBits_[bit].kind);
+        data.bitIndex[bit] = statusBits_[bit].index;
+    }
+    for (size_t door = 0; door < doors_.size(); door++)
+    {
+        data.doorOpenedWallUs[door] = doors_[door].open ? wallUs(doors_[door].openTime) : 0;
+        data.doorOpenCount[door] = doors_[door].opens;
+    }
+    statusShm_->publish(data);
+}
+
+void MainControl::handleStatusChange(const StatusBitRole &role, bool bitSet,
+                                     Timeline::Instant now)
 {
-    auto now = std::chrono::system_clock::now();
     std::string timestamp = formatTimestamp(now);
+    std::string index = std::to_string(role.index);
 
-    // Check Door 0
-    if (oldStatus.door_0 != newStatus.door_0)
+    switch (role.kind)
+    {
+    case StatusBitKind::Door:
     {
-        EventType event = (newStatus.door_0 == 0) ? EventType::Door0Open : EventType::Door0Close;
+        // Bit value: 0=OPENED, 1=CLOSED
+        EventType event = bitSet ? EventType::DoorClose : EventType::DoorOpen;
         if (dbComm_)
         {
-            dbComm_->logEvent(event, timestamp);
+            dbComm_->logEvent(event, role.index, timestamp);
         }
-        logger_->log("Status change: Door 0 " + std::string((newStatus.door_0 == 0) ? "OPENED" : "CLOSED"));
+        logger_->log("Status change: Door " + index + " " + (bitSet ? "CLOSED" : "OPENED"));
+
+        if (bitSet)
+            onDoorClosed(role.index, now);
+        else
+            onDoorOpened(role.index, now);
+        break;
     }
 
-    // Check Door 1
-    if (oldStatus.door_1 != newStatus.door_1)
+    case StatusBitKind::Cover:
     {
-        EventType event = (newStatus.door_1 == 0) ? EventType::Door1Open : EventType::Door1Close;
+        EventType event = bitSet ? EventType::CoverClose : EventType::CoverOpen;
         if (dbComm_)
         {
-            dbComm_->logEvent(event, timestamp);
+            dbComm_->logEvent(event, role.index, timestamp);
         }
-        logger_->log("Status change: Door 1 " + std::string((newStatus.door_1 == 0) ? "OPENED" : "CLOSED"));
+        logger_->log("Status change: Cover " + index + " " + (bitSet ? "CLOSED" : "OPENED"));
+
+        if (!bitSet)
+            doorStats_.coverOpened(role.index, Timeline::toWall(now));
+        break;
     }
 
-    // Check Cover 0
-    if (oldStatus.cover_0 != newStatus.cover_0)
+    case StatusBitKind::MainSupply:
     {
-        EventType event = (newStatus.cover_0 == 0) ? EventType::Cover0Open : EventType::Cover0Close;
+        EventType event = bitSet ? EventType::MainSupplyOn : EventType::MainSupplyOff;
         if (dbComm_)
         {
-            dbComm_->logEvent(event, timestamp);
+            dbComm_->logEvent(event, 0, timestamp);
         }
-        logger_->log("Status change: Cover 0 " + std::string((newStatus.cover_0 == 0) ? "OPENED" : "CLOSED"));
+        logger_->log("Status change: Main Supply " + std::string(bitSet ? "ON" : "OFF"));
+        break;
     }
 
-    // Check Cover 1
-    if (oldStatus.cover_1 != newStatus.cover_1)
+    case StatusBitKind::Ignition:
     {
-        EventType event = (newStatus.cover_1 == 0) ? EventType::Cover1Open : EventType::Cover1Close;
+        EventType event = bitSet ? EventType::IgnitionOn : EventType::IgnitionOff;
         if (dbComm_)
         {
-            dbComm_->logEvent(event, timestamp);
+            dbComm_->logEvent(event, 0, timestamp);
         }
-        logger_->log("Status change: Cover 1 " + std::string((newStatus.cover_1 == 0) ? "OPENED" : "CLOSED"));
+        logger_->log("Status change: Ignition " + std::string(bitSet ? "ON" : "OFF"));
+        break;
     }
 
-    // Check Main Supply
-    if (oldStatus.mainSupply != newStatus.mainSupply)
+    default:
+        break;
+    }
+}
+
+void MainControl::onDoorOpened(int door, Timeline::Instant now)
+{
+    if (door < 0 || static_cast<size_t>(door) >= doors_.size())
+        return;
+
+    doors_[door].openTime = now;
+    doors_[door].open = true;
+    doors_[door].opens++;
+    coalescer_.doorOpened(door, now);
+
+    // Boarding with the engine off: back to full readiness for the clip
+    PowerMode from = power_.mode();
+    if (power_.activity(now))
     {
-        EventType event = (newStatus.mainSupply == 1) ? EventType::MainSupplyOn : EventType::MainSupplyOff;
-        if (dbComm_)
-        {
-            dbComm_->logEvent(event, timestamp);
-        }
-        logger_->log("Status change: Main Supply " + std::string((newStatus.mainSupply == 1) ? "ON" : "OFF"));
+        onPowerModeChanged(from, "door " + std::to_string(door) + " opened", now);
     }
 
-    // Check Ignition
-    if (oldStatus.ignition != newStatus.ignition)
+    if (auto cmds = doorCommands(door))
     {
-        EventType event = (newStatus.ignition == 1) ? EventType::IgnitionOn : EventType::IgnitionOff;
-        if (dbComm_)
-        {
-            dbComm_->logEvent(event, timestamp);
-        }
-        logger_->log("Status change: Ignition " + std::string((newStatus.ignition == 1) ? "ON" : "OFF"));
+        sendCommand(cmds->camOn);
+        sendCommand(cmds->lightOn);
+        videoControlQueue_->push(Message::createPeripheralCommand(cmds->camOn));
+    }
+    logger_->log("Door " + std::to_string(door) + " opened - camera and light ON");
+}
+
+void MainControl::onDoorClosed(int door, Timeline::Instant now)
+{
+    if (door < 0 || static_cast<size_t>(door) >= doors_.size() || !doors_[door].open)
+        return;
+
+    doors_[door].open = false;
+
+    // Clip window: start = open - stopBeginDelay, stop = close + stopEndDelay.
+    // The coalescer holds it until the stop time, merging a re-open into it
+    bool accepted = coalescer_.doorClosed(door, now,
+                                          std::chrono::seconds(stopBeginDelay_.load()),
+                                          std::chrono::seconds(stopEndDelay_.load()));
+
+    // Turn off camera and light after the delay
+    if (auto cmds = doorCommands(door))
+    {
+        sendCommand(cmds->camOff);
+        sendCommand(cmds->lightOff);
+    }
+
+    if (accepted)
+    {
+        doorStats_.doorOpenPeriod(door, Timeline::toWall(doors_[door].openTime), Timeline::toWall(now));
+        logger_->log("Door " + std::to_string(door) + " closed - clip window pending");
+    }
+    else
+    {
+        logger_->log("Door " + std::to_string(door) + " open for less than " +
+                     std::to_string(coalescer_.glitchThreshold().count()) + "ms - ignored as glitch");
+    }
+}
+
+void MainControl::flushStats()
+{
+    if (!dbComm_ || doorStats_.empty())
+        return;
+
+    std::vector<DoorStatsRecord> records = doorStats_.takePending();
+    if (!dbComm_->logDoorStats(records))
+    {
+        logger_->logError("MainControl: Could not store door statistics for " +
+                          std::to_string(records.size()) + " bucket(s)");
+    }
+}
+
+void MainControl::onPowerModeChanged(PowerMode from, const std::string &reason, Timeline::Instant now)
+{
+    PowerMode mode = power_.mode();
+    logger_->log("MainControl: Power " + std::string(powerModeName(from)) + " -> " + powerModeName(mode) +
+                 " (" + reason + ")");
+
+    // Recording, retention and syncing the SD card are VideoControl's
+    videoControlQueue_->push(Message::createPowerMode(mode, now));
+
+    if (power_.lowPower())
+    {
+        // Store what is buffered while there is still power to do so
+        flushStats();
+        nextStatsFlush_ = now + STATS_FLUSH_INTERVAL;
+    }
+    if (dbComm_)
+    {
+        dbComm_->setPowerMode(mode);
+    }
+
+    if (reactor_ && running_ && (from == PowerMode::Active) != (mode == PowerMode::Active))
+    {
+        armTick(power_.lowPower() ? LOW_POWER_TICK : TICK_INTERVAL);
+    }
+}
+
+void MainControl::injectStatus(uint8_t status)
+{
+    logger_->logCommand("Replayed SystemStatus: 0x" +
+                        std::string(1, "0123456789ABCDEF"[status >> 4]) +
+                        std::string(1, "0123456789ABCDEF"[status & 0x0F]));
+    processSystemStatus(SystemStatus_t::fromByte(status));
+}
+
+void MainControl::pollClips(bool flush)
+{
+    emitClips(flush ? coalescer_.flush() : coalescer_.poll(clock_->now()));
+}
+
+void MainControl::emitClips(const std::vector<ClipCoalescer::Clip> &clips)
+{
+    for (const auto &clip : clips)
+    {
+        videoControlQueue_->push(Message::createStartStop(clip.door, clip.start, clip.stop));
+        logger_->log("Door " + std::to_string(clip.door) + " - sending video segment request " +
+                     formatTimestamp(clip.start) + " .. " + formatTimestamp(clip.stop));
     }
 }
 
@@ -478,48 +996,24 @@ void MainControl::processReceivedCommand(ReceivedCommand cmd)
 {
     // Legacy command processing - kept for backward compatibility
     // This method is no longer used as we now process SystemStatus messages
-    auto now = std::chrono::system_clock::now();
+    auto now = clock_->now();
 
     switch (cmd)
     {
     case ReceivedCommand::Door0_Open:
-        door0OpenTime_ = now;
-        door0Open_ = true;
-        sendCommand(PeripheralCommand::Cam0ON);
-        sendCommand(PeripheralCommand::Light0ON);
+        onDoorOpened(0, now);
         break;
 
     case ReceivedCommand::Door0_Close:
-        if (door0Open_)
-        {
-            door0Open_ = false;
-            auto startTime = door0OpenTime_ - std::chrono::seconds(stopBeginDelay_);
-            auto stopTime = now + std::chrono::seconds(stopEndDelay_);
-            auto msg = Message::createStartStop(0, startTime, stopTime);
-            videoControlQueue_->push(msg);
-            sendCommand(PeripheralCommand::Cam0OFF);
-            sendCommand(PeripheralCommand::Light0OFF);
-        }
+        onDoorClosed(0, now);
         break;
 
     case ReceivedCommand::Door1_Open:
-        door1OpenTime_ = now;
-        door1Open_ = true;
-        sendCommand(PeripheralCommand::Cam1ON);
-        sendCommand(PeripheralCommand::Light1ON);
+        onDoorOpened(1, now);
         break;
 
     case ReceivedCommand::Door1_Close:
-        if (door1Open_)
-        {
-            door1Open_ = false;
-            auto startTime = door1OpenTime_ - std::chrono::seconds(stopBeginDelay_);
-            auto stopTime = now + std::chrono::seconds(stopEndDelay_);
-            auto msg = Message::createStartStop(1, startTime, stopTime);
-            videoControlQueue_->push(msg);
-            sendCommand(PeripheralCommand::Cam1OFF);
-            sendCommand(PeripheralCommand::Light1OFF);
-        }
+        onDoorClosed(1, now);
         break;
 
     default:
@@ -529,5 +1023,12 @@ void MainControl::processReceivedCommand(ReceivedCommand cmd)
 
 void MainControl::sendCommand(PeripheralCommand cmd)
 {
+    if (reactor_)
+    {
+        // Posted callbacks run in order, so commands keep their sequence
+        reactor_->post([this, cmd]()
+                       { writeCommand(static_cast<uint8_t>(cmd)); });
+        return;
+    }
     outgoingQueue_.push(cmd);
 }
@@ -0,0 +1,651 @@
+#ifdef PASSFLOW_HAVE_MARIADB
+
+#include "MariaDbBackend.h"
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <string.h>
+
+namespace
+{
+// Client error codes from errmsg.h for a dropped server connection
+const unsigned int CR_SERVER_GONE_ERROR_CODE = 2006;
+const unsigned int CR_SERVER_LOST_CODE = 2013;
+
+// "YYYY-MM-DD" shifted by a number of days (local calendar)
+std::string addDays(const std::string &day, int days)
+{
+    std::tm tm = {};
+    tm.tm_year = std::stoi(day.substr(0, 4)) - 1900;
+    tm.tm_mon = std::stoi(day.substr(5, 2)) - 1;
+    tm.tm_mday = std::stoi(day.substr(8, 2)) + days;
+    tm.tm_hour = 12;  // Clear of DST transitions
+    tm.tm_isdst = -1;
+    std::mktime(&tm);
+
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d", &tm);
+    return buffer;
+}
+
+// Day partitions are named pYYYYMMDD and hold the rows of that day
+std::string partitionName(const std::string &day)
+{
+    return "p" + day.substr(0, 4) + day.substr(5, 2) + day.substr(8, 2);
+}
+
+bool isDayPartition(const std::string &name)
+{
+    return name.size() == 9 && name[0] == 'p' &&
+           std::all_of(name.begin() + 1, name.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+std::string partitionDay(const std::string &name)
+{
+    return name.substr(1, 4) + "-" + name.substr(5, 2) + "-" + name.substr(7, 2);
+}
+}
+
+MariaDbBackend::MariaDbBackend(std::shared_ptr<Logger> logger)
+    : logger_(logger), connection_(nullptr), segmentEncoding_(false)
+{
+    // Database connection parameters for local MariaDB
+    host_ = "127.0.0.1";
+    user_ = "bus";
+    password_ = "njkmrjbus";
+    database_ = "busLocal";
+    port_ = 3306;
+}
+
+MariaDbBackend::~MariaDbBackend()
+{
+    disconnect();
+}
+
+void MariaDbBackend::configure(const ConfigIni &config)
+{
+    host_ = config.getString("Database", "Host", host_);
+    user_ = config.getString("Database", "User", user_);
+    password_ = config.getString("Database", "Password", password_);
+    database_ = config.getString("Database", "Name", database_);
+    port_ = static_cast<unsigned int>(config.getInt("Database", "Port", static_cast<int>(port_)));
+}
+
+bool MariaDbBackend::connect()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connection_ != nullptr)
+        {
+            return true; // Already connected
+        }
+    }
+
+    // Connect without holding mutex_ so writes are never blocked behind
+    // the connect timeout (MySqlComm spools them meanwhile)
+    MYSQL *connection = mysql_init(nullptr);
+    if (connection == nullptr)
+    {
+        logger_->logError("MySqlComm: mysql_init() failed");
+        return false;
+    }
+
+    // Set connection timeout (short: callers retry in the background)
+    unsigned int timeout = 3;
+    mysql_options(connection, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+
+    // Enable auto-reconnect
+    bool reconnect = true;
+    mysql_options(connection, MYSQL_OPT_RECONNECT, &reconnect);
+
+    if (mysql_real_connect(connection,
+                           host_.c_str(),
+                           user_.c_str(),
+                           password_.c_str(),
+                           database_.c_str(),
+                           port_,
+                           nullptr,
+                           0) == nullptr)
+    {
+        logger_->logError("MySqlComm: Connection failed - " +
+                          std::string(mysql_error(connection)));
+        mysql_close(connection);
+        return false;
+    }
+
+    // Set character encoding
+    mysql_set_character_set(connection, "utf8mb4");
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = connection;
+    }
+
+    logger_->log("MySqlComm: Connected to database " + database_ + " at " + host_ +
+                 " (" + std::to_string(millisSinceStart()) + " ms since start)");
+    detectSchema();
+    return true;
+}
+
+void MariaDbBackend::detectSchema()
+{
+    // Databases created before a column was added keep working without it
+    MYSQL_RES *result = executeSelectQuery("SHOW COLUMNS FROM video_segments LIKE 'encoding'");
+    segmentEncoding_ = result != nullptr && mysql_num_rows(result) > 0;
+    if (result != nullptr)
+    {
+        mysql_free_result(result);
+    }
+
+    if (!segmentEncoding_)
+    {
+        logger_->log("MySqlComm: video_segments has no encoding column, clip encoder settings are not stored "
+                     "(apply database_migrate_transcode.sql)");
+    }
+}
+
+void MariaDbBackend::disconnect()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (connection_ != nullptr)
+    {
+        mysql_close(connection_);
+        connection_ = nullptr;
+        logger_->log("MySqlComm: Disconnected from database");
+    }
+}
+
+bool MariaDbBackend::hasConnection() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connection_ != nullptr;
+}
+
+bool MariaDbBackend::isConnected() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (connection_ == nullptr)
+    {
+        return false;
+    }
+
+    return mysql_ping(connection_) == 0;
+}
+
+WriteStatus MariaDbBackend::write(const StorageRecord &record)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (connection_ == nullptr)
+    {
+        return WriteStatus::Offline;
+    }
+
+    std::stringstream query;
+    if (auto event = std::get_if<EventRecord>(&record))
+    {
+        query << "INSERT INTO events (event_type, event_description, event_time) VALUES ("
+              << event->type << ", '"
+              << escapeString(event->description) << "', '"
+              << escapeString(event->time) << "')";
+    }
+    else if (auto segment = std::get_if<VideoSegmentRecord>(&record))
+    {
+        query << "INSERT INTO video_segments (camera_id, start_time, stop_time, filename"
+              << (segmentEncoding_ ? ", encoding" : "") << ") VALUES ("
+              << segment->cameraId << ", '"
+              << escapeString(segment->startTime) << "', '"
+              << escapeString(segment->stopTime) << "', '"
+              << escapeString(segment->filename) << "'";
+        if (segmentEncoding_)
+        {
+            query << ", '" << escapeString(segment->encoding) << "'";
+        }
+        query << ")";
+    }
+    else
+    {
+        const auto &stats = std::get<DoorStatsRecord>(record);
+        query << "INSERT INTO door_stats (door, bucket_start, bucket_seconds, open_count, open_ms, "
+                 "max_open_ms, cover_open_count) VALUES ("
+              << stats.door << ", '"
+              << escapeString(stats.bucketStart) << "', "
+              << stats.bucketSeconds << ", "
+              << stats.openCount << ", "
+              << stats.openMs << ", "
+              << stats.maxOpenMs << ", "
+              << stats.coverOpenCount << ") ON DUPLICATE KEY UPDATE "
+                 "open_count = open_count + VALUES(open_count), "
+                 "open_ms = open_ms + VALUES(open_ms), "
+                 "max_open_ms = GREATEST(max_open_ms, VALUES(max_open_ms)), "
+                 "cover_open_count = cover_open_count + VALUES(cover_open_count)";
+    }
+
+    if (mysql_query(connection_, query.str().c_str()) != 0)
+    {
+        unsigned int error = mysql_errno(connection_);
+        if (error == CR_SERVER_GONE_ERROR_CODE || error == CR_SERVER_LOST_CODE)
+        {
+            return WriteStatus::Offline;
+        }
+
+        logger_->logError("MySqlComm: Query failed - " +
+                          std::string(mysql_error(connection_)) +
+                          " Query: " + query.str());
+        return WriteStatus::Failed;
+    }
+
+    return WriteStatus::Ok;
+}
+
+bool MariaDbBackend::executeQuery(const std::string &query, unsigned long long *affectedRows)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (connection_ == nullptr)
+    {
+        return false;
+    }
+
+    if (mysql_query(connection_, query.c_str()) != 0)
+    {
+        logger_->logError("MySqlComm: Query failed - " +
+                          std::string(mysql_error(connection_)) +
+                          " Query: " + query);
+        return false;
+    }
+
+    if (affectedRows != nullptr)
+    {
+        *affectedRows = mysql_affected_rows(connection_);
+    }
+    return true;
+}
+
+MYSQL_RES *MariaDbBackend::executeSelectQuery(const std::string &query)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (connection_ == nullptr)
+    {
+        logger_->logError("MySqlComm: Not connected to database");
+        return nullptr;
+    }
+
+    if (mysql_query(connection_, query.c_str()) != 0)
+    {
+        logger_->logError("MySqlComm: Query failed - " +
+                          std::string(mysql_error(connection_)) +
+                          " Query: " + query);
+        return nullptr;
+    }
+
+    return mysql_store_result(connection_);
+}
+
+std::string MariaDbBackend::escapeString(const std::string &str)
+{
+    // Caller holds mutex_ with a live connection
+    if (str.empty())
+    {
+        return str;
+    }
+
+    std::vector<char> buffer(str.length() * 2 + 1);
+    mysql_real_escape_string(connection_, buffer.data(), str.c_str(), str.length());
+    return std::string(buffer.data());
+}
+
+bool MariaDbBackend::loadSettings(AppSettings &settings, std::string &stamp)
+{
+    // Read from 'settings' table
+    std::string settingsQuery = "SELECT doors, stopBeginDelay, stopEndDelay, "
+                                "daysBeforeDeliteVideo, cam0_string, cam1_string, "
+                                "UNIX_TIMESTAMP(updated_at) "
+                                "FROM settings LIMIT 1";
+
+    MYSQL_RES *result = executeSelectQuery(settingsQuery);
+    if (result == nullptr)
+    {
+        logger_->logError("MySqlComm: Failed to query settings table");
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (row == nullptr)
+    {
+        logger_->logError("MySqlComm: No settings found in database");
+        mysql_free_result(result);
+        return false;
+    }
+
+    // Parse settings
+    settings.doors = row[0] ? std::stoi(row[0]) : 2;
+    settings.stopBeginDelay = row[1] ? std::stoi(row[1]) : 5;
+    settings.stopEndDelay = row[2] ? std::stoi(row[2]) : 5;
+    settings.daysBeforeDeleteVideo = row[3] ? std::stoi(row[3]) : 30;
+    settings.cam0String = row[4] ? row[4] : "";
+    settings.cam1String = row[5] ? row[5] : "";
+    stamp = row[6] ? row[6] : "";
+    mysql_free_result(result);
+
+    loadCameras(settings);
+    loadStatusBits(settings);
+    loadRemoteAddresses(settings);
+    return true;
+}
+
+bool MariaDbBackend::readSettingsStamp(std::string &stamp)
+{
+    MYSQL_RES *result = executeSelectQuery("SELECT UNIX_TIMESTAMP(updated_at) FROM settings LIMIT 1");
+    if (result == nullptr)
+    {
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    stamp = (row && row[0]) ? row[0] : "";
+    mysql_free_result(result);
+    return true;
+}
+
+bool MariaDbBackend::readSince(RecordTable table, int64_t afterId, size_t limit,
+                               std::vector<StoredRecord> &rows)
+{
+    std::string query = table == RecordTable::Events
+                            ? "SELECT id, event_type, event_description, event_time FROM events"
+                            : "SELECT id, camera_id, start_time, stop_time, filename FROM video_segments";
+    query += " WHERE id > " + std::to_string(afterId) + " ORDER BY id LIMIT " + std::to_string(limit);
+
+    MYSQL_RES *result = executeSelectQuery(query);
+    if (result == nullptr)
+    {
+        return false;
+    }
+
+    rows.clear();
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        int64_t id = std::stoll(row[0]);
+        if (table == RecordTable::Events)
+        {
+            rows.push_back({id, EventRecord{row[1] ? std::stoi(row[1]) : 0,
+                                            row[2] ? row[2] : "", row[3] ? row[3] : ""}});
+        }
+        else
+        {
+            rows.push_back({id, VideoSegmentRecord{row[1] ? std::stoi(row[1]) : 0, row[2] ? row[2] : "",
+                                                   row[3] ? row[3] : "", row[4] ? row[4] : "", ""}});
+        }
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+bool MariaDbBackend::lastId(RecordTable table, int64_t &id)
+{
+    MYSQL_RES *result = executeSelectQuery(table == RecordTable::Events
+                                               ? "SELECT MAX(id) FROM events"
+                                               : "SELECT MAX(id) FROM video_segments");
+    if (result == nullptr)
+    {
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    id = (row && row[0]) ? std::stoll(row[0]) : 0;
+    mysql_free_result(result);
+    return true;
+}
+
+bool MariaDbBackend::readDoorStats(const std::string &from, const std::string &to,
+                                   std::vector<DoorStatsRecord> &rows)
+{
+    std::string query;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connection_ == nullptr)
+        {
+            return false;
+        }
+        query = "SELECT door, bucket_start, bucket_seconds, open_count, open_ms, max_open_ms, cover_open_count "
+                "FROM door_stats WHERE bucket_start >= '" + escapeString(from) +
+                "' AND bucket_start < '" + escapeString(to) + "' ORDER BY bucket_start, door";
+    }
+
+    MYSQL_RES *result = executeSelectQuery(query);
+    if (result == nullptr)
+    {
+        return false;
+    }
+
+    rows.clear();
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        rows.push_back({std::stoi(row[0]), row[1] ? row[1] : "", std::stoi(row[2]), std::stoi(row[3]),
+                        std::stoll(row[4]), std::stoll(row[5]), std::stoi(row[6])});
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+bool MariaDbBackend::applyRetention(std::chrono::system_clock::time_point cutoff,
+                                    std::chrono::system_clock::time_point now)
+{
+    std::string cutoffTime = formatTimestamp(cutoff);
+    std::string today = formatTimestamp(now).substr(0, 10);
+
+    bool eventsOk = rotatePartitions("events", "event_time", cutoffTime, today);
+    bool segmentsOk = rotatePartitions("video_segments", "start_time", cutoffTime, today);
+    return eventsOk && segmentsOk;
+}
+
+bool MariaDbBackend::rotatePartitions(const std::string &table, const std::string &column,
+                                      const std::string &cutoff, const std::string &today)
+{
+    MYSQL_RES *result = executeSelectQuery(
+        "SELECT PARTITION_NAME FROM information_schema.PARTITIONS "
+        "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table + "' "
+        "AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_ORDINAL_POSITION");
+    if (result == nullptr)
+    {
+        return false;
+    }
+
+    std::vector<std::string> partitions;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        if (row[0] != nullptr)
+        {
+            partitions.push_back(row[0]);
+        }
+    }
+    mysql_free_result(result);
+
+    bool hasP0 = std::find(partitions.begin(), partitions.end(), "p0") != partitions.end();
+    bool hasPmax = std::find(partitions.begin(), partitions.end(), "pmax") != partitions.end();
+
+    // Rows outside day partitions (p0 holds pre-migration history, or the
+    // table is not partitioned yet) are deleted in chunks so event writes
+    // are never blocked for long
+    unsigned long long deleted = 0;
+    if (partitions.empty() || hasP0)
+    {
+        std::string query = "DELETE FROM " + table + (partitions.empty() ? "" : " PARTITION (p0)") +
+                            " WHERE " + column + " < '" + cutoff + "' LIMIT " + std::to_string(DELETE_CHUNK);
+        unsigned long long affected = 0;
+        do
+        {
+            if (!executeQuery(query, &affected))
+            {
+                return false;
+            }
+            deleted += affected;
+        } while (affected == static_cast<unsigned long long>(DELETE_CHUNK));
+    }
+
+    if (partitions.empty())
+    {
+        if (deleted > 0)
+        {
+            logger_->log("MySqlComm: Retention deleted " + std::to_string(deleted) + " row(s) from " + table);
+        }
+        return true;
+    }
+
+    // Whole days that ended before the cutoff day are dropped in one statement
+    std::string cutoffName = partitionName(cutoff.substr(0, 10));
+    std::string latest;
+    std::string expired;
+    for (const auto &name : partitions)
+    {
+        if (!isDayPartition(name))
+            continue;
+        if (name < cutoffName)
+        {
+            expired += (expired.empty() ? "" : ",") + name;
+        }
+        latest = std::max(latest, name);
+    }
+
+    bool ok = true;
+    if (!expired.empty())
+    {
+        ok = executeQuery("ALTER TABLE " + table + " DROP PARTITION " + expired);
+        if (ok)
+        {
+            logger_->log("MySqlComm: Retention dropped " + table + " partition(s) " + expired);
+        }
+    }
+
+    // Split the day partitions for today and the next days out of pmax
+    if (hasPmax)
+    {
+        std::string day = today;
+        if (!latest.empty())
+        {
+            day = std::max(day, addDays(partitionDay(latest), 1));
+        }
+
+        std::string definitions;
+        std::string created;
+        for (std::string last = addDays(today, PARTITION_DAYS_AHEAD); day <= last; day = addDays(day, 1))
+        {
+            definitions += "PARTITION " + partitionName(day) + " VALUES LESS THAN (TO_DAYS('" +
+                           addDays(day, 1) + "')), ";
+            created += (created.empty() ? "" : ",") + partitionName(day);
+        }
+
+        if (!definitions.empty())
+        {
+            if (executeQuery("ALTER TABLE " + table + " REORGANIZE PARTITION pmax INTO (" +
+                             definitions + "PARTITION pmax VALUES LESS THAN MAXVALUE)"))
+            {
+                logger_->log("MySqlComm: Created " + table + " partition(s) " + created);
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+    }
+
+    if (deleted > 0)
+    {
+        logger_->log("MySqlComm: Retention deleted " + std::to_string(deleted) + " row(s) from " + table + " p0");
+    }
+    return ok;
+}
+
+void MariaDbBackend::loadCameras(AppSettings &settings)
+{
+    settings.cameras.clear();
+
+    // Read from 'cameras' table (one row per camera, any number of doors)
+    MYSQL_RES *result = executeSelectQuery(
+        "SELECT camera_id, door_id, rtsp_url, enabled FROM cameras ORDER BY camera_id");
+    if (result == nullptr)
+    {
+        return;
+    }
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        CameraSettings cam;
+        cam.id = row[0] ? std::stoi(row[0]) : 0;
+        cam.doorId = row[1] ? std::stoi(row[1]) : cam.id;
+        cam.rtspUrl = row[2] ? row[2] : "";
+        cam.enabled = row[3] ? std::stoi(row[3]) != 0 : true;
+        settings.cameras.push_back(cam);
+    }
+    mysql_free_result(result);
+}
+
+void MariaDbBackend::loadStatusBits(AppSettings &settings)
+{
+    settings.statusBits = defaultStatusBitMap();
+
+    // Read from 'status_bits' table: bit number -> role and door/cover index
+    MYSQL_RES *result = executeSelectQuery("SELECT bit, role, idx FROM status_bits");
+    if (result == nullptr)
+    {
+        return;
+    }
+
+    StatusBitMap map;
+    bool any = false;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        int bit = row[0] ? std::stoi(row[0]) : -1;
+        std::string role = row[1] ? row[1] : "";
+        int idx = row[2] ? std::stoi(row[2]) : 0;
+
+        StatusBitRole entry;
+        if (!parseStatusBitRole(bit, role, idx, entry))
+        {
+            logger_->logError("MySqlComm: Ignoring invalid status_bits row, bit=" +
+                              std::to_string(bit));
+            continue;
+        }
+
+        map[bit] = entry;
+        any = true;
+    }
+    mysql_free_result(result);
+
+    if (any)
+    {
+        settings.statusBits = map;
+    }
+}
+
+void MariaDbBackend::loadRemoteAddresses(AppSettings &settings)
+{
+    // Read from 'remoteDB' table
+    MYSQL_RES *result = executeSelectQuery("SELECT remoteDBAddress FROM remoteDB");
+    if (result == nullptr)
+    {
+        return;
+    }
+
+    settings.remoteDBAddresses.clear();
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        if (row[0] != nullptr && strlen(row[0]) > 0)
+        {
+            settings.remoteDBAddresses.push_back(row[0]);
+        }
+    }
+    mysql_free_result(result);
+}
+
+#endif // PASSFLOW_HAVE_MARIADB
@@ -0,0 +1,533 @@
+#include "Mp4Index.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+// Seconds between 1904-01-01 (MP4 epoch) and 1970-01-01
+const uint64_t MP4_EPOCH_OFFSET = 2082844800ULL;
+
+// trun/tfhd sample flag: sample_is_non_sync_sample
+const uint32_t NON_SYNC_SAMPLE = 0x00010000;
+
+// Every sample takes at least this much media data in the file (an
+// AVC/HEVC NAL length field alone is 4 bytes); sample tables claiming
+// more samples than the file can hold are corrupt
+const uint64_t MIN_SAMPLE_BYTES = 4;
+
+uint16_t be16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+uint32_t be32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint64_t be64(const uint8_t *p) { return (static_cast<uint64_t>(be32(p)) << 32) | be32(p + 4); }
+
+bool isType(const uint8_t *type, const char *name) { return std::memcmp(type, name, 4) == 0; }
+
+// Bounds-checked cursor over a box payload
+class Reader
+{
+public:
+    Reader(const uint8_t *begin, const uint8_t *end) : pos_(begin), end_(end) {}
+
+    bool has(size_t n) const { return static_cast<size_t>(end_ - pos_) >= n; }
+    size_t remaining() const { return static_cast<size_t>(end_ - pos_); }
+    void skip(size_t n) { pos_ += std::min(n, static_cast<size_t>(end_ - pos_)); }
+
+    uint32_t u32()
+    {
+        if (!has(4))
+        {
+            pos_ = end_;
+            return 0;
+        }
+        uint32_t v = be32(pos_);
+        pos_ += 4;
+        return v;
+    }
+
+    uint64_t u64()
+    {
+        if (!has(8))
+        {
+            pos_ = end_;
+            return 0;
+        }
+        uint64_t v = be64(pos_);
+        pos_ += 8;
+        return v;
+    }
+
+    // Full box header: version (8 bits) and flags (24 bits)
+    void fullBox(uint8_t &version, uint32_t &flags)
+    {
+        uint32_t v = u32();
+        version = v >> 24;
+        flags = v & 0xFFFFFF;
+    }
+
+private:
+    const uint8_t *pos_;
+    const uint8_t *end_;
+};
+
+// Iterates the child boxes of [begin, end); stops at a truncated box
+class BoxIterator
+{
+public:
+    BoxIterator(const uint8_t *begin, const uint8_t *end) : pos_(begin), end_(end) {}
+
+    bool next(const uint8_t *&type, const uint8_t *&payload, const uint8_t *&payloadEnd)
+    {
+        size_t left = end_ - pos_;
+        if (left < 8)
+            return false;
+
+        uint64_t size = be32(pos_);
+        size_t header = 8;
+        if (size == 1)
+        {
+            if (left < 16)
+                return false;
+            size = be64(pos_ + 8);
+            header = 16;
+        }
+        else if (size == 0)
+        {
+            size = left; // Box extends to the end of its parent
+        }
+
+        if (size < header || size > left)
+            return false;
+
+        type = pos_ + 4;
+        payload = pos_ + header;
+        payloadEnd = pos_ + size;
+        pos_ += size;
+        return true;
+    }
+
+private:
+    const uint8_t *pos_;
+    const uint8_t *end_;
+};
+}
+
+bool Mp4Index::open(const std::string &path)
+{
+    *this = Mp4Index();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error_ = "cannot open " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8)
+    {
+        close(fd);
+        error_ = "file too small: " + path;
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        error_ = "mmap failed: " + path;
+        return false;
+    }
+
+    // Only box headers and sample tables are touched; mdat is skipped
+    madvise(map, size, MADV_RANDOM);
+
+    const uint8_t *begin = static_cast<const uint8_t *>(map);
+    maxSamples_ = size / MIN_SAMPLE_BYTES;
+    parseBoxes(begin, begin + size, nullptr);
+    munmap(map, size);
+
+    if (!error_.empty())
+    {
+        error_ += ": " + path;
+        return false;
+    }
+    if (tracks_.empty())
+    {
+        error_ = "no tracks found: " + path;
+        return false;
+    }
+    return true;
+}
+
+void Mp4Index::parseBoxes(const uint8_t *begin, const uint8_t *end, Track *track)
+{
+    BoxIterator boxes(begin, end);
+    const uint8_t *type;
+    const uint8_t *payload;
+    const uint8_t *payloadEnd;
+
+    // stts and stss are combined once the whole stbl has been seen
+    const uint8_t *stts = nullptr;
+    const uint8_t *sttsEnd = nullptr;
+    const uint8_t *stss = nullptr;
+    const uint8_t *stssEnd = nullptr;
+
+    while (error_.empty() && boxes.next(type, payload, payloadEnd))
+    {
+        Reader r(payload, payloadEnd);
+        uint8_t version;
+        uint32_t flags;
+
+        if (isType(type, "moov") || isType(type, "mdia") || isType(type, "minf") ||
+            isType(type, "stbl") || isType(type, "mvex"))
+        {
+            parseBoxes(payload, payloadEnd, track);
+        }
+        else if (isType(type, "trak"))
+        {
+            Track parsed;
+            parseBoxes(payload, payloadEnd, &parsed);
+            if (parsed.id != 0)
+            {
+                // Keep trex defaults if mvex came first
+                Track &stored = tracks_[parsed.id];
+                parsed.defaultSampleDuration = stored.defaultSampleDuration;
+                parsed.defaultSampleFlags = stored.defaultSampleFlags;
+                stored = parsed;
+            }
+        }
+        else if (isType(type, "moof"))
+        {
+            fragments_++;
+            BoxIterator trafs(payload, payloadEnd);
+            const uint8_t *childType;
+            const uint8_t *child;
+            const uint8_t *childEnd;
+            while (error_.empty() && trafs.next(childType, child, childEnd))
+            {
+                if (isType(childType, "traf"))
+                    parseTraf(child, childEnd);
+            }
+        }
+        else if (isType(type, "mvhd"))
+        {
+            r.fullBox(version, flags);
+            creationTime_ = version == 1 ? r.u64() : r.u32();
+            r.skip(version == 1 ? 8 : 4); // modification_time
+            movieTimescale_ = r.u32();
+            movieDuration_ = version == 1 ? r.u64() : r.u32();
+        }
+        else if (isType(type, "trex"))
+        {
+            r.fullBox(version, flags);
+            Track &t = tracks_[r.u32()];
+            r.u32(); // default_sample_description_index
+            t.defaultSampleDuration = r.u32();
+            r.u32(); // default_sample_size
+            t.defaultSampleFlags = r.u32();
+        }
+        else if (!track)
+        {
+            continue; // Remaining boxes only matter inside a trak
+        }
+        else if (isType(type, "tkhd"))
+        {
+            r.fullBox(version, flags);
+            r.skip(version == 1 ? 16 : 8); // creation and modification time
+            track->id = r.u32();
+        }
+        else if (isType(type, "mdhd"))
+        {
+            r.fullBox(version, flags);
+            r.skip(version == 1 ? 16 : 8);
+            track->timescale = r.u32();
+            track->durationTicks = version == 1 ? r.u64() : r.u32();
+        }
+        else if (isType(type, "hdlr"))
+        {
+            r.fullBox(version, flags);
+            r.u32(); // pre_defined
+            if (r.has(4))
+                track->handler.assign(reinterpret_cast<const char *>(payload + 8), 4);
+        }
+        else if (isType(type, "stsd"))
+        {
+            // First sample entry: size, type, then for visual entries
+            // 24 bytes of reserved fields before width and height
+            const uint8_t *entry = payload + 8;
+            if (payloadEnd - entry >= 8)
+            {
+                track->codec.assign(reinterpret_cast<const char *>(entry + 4), 4);
+                if (track->handler == "vide" && payloadEnd - entry >= 36)
+                {
+                    track->width = be16(entry + 32);
+                    track->height = be16(entry + 34);
+                }
+
+                // The visual entry's fixed fields end at 86 bytes; the
+                // decoder configuration follows as a child box
+                const uint8_t *entryEnd = entry + std::min<size_t>(be32(entry), payloadEnd - entry);
+                if (track->handler == "vide" && entryEnd - entry > 86)
+                {
+                    BoxIterator children(entry + 86, entryEnd);
+                    const uint8_t *childType;
+                    const uint8_t *child;
+                    const uint8_t *childEnd;
+                    while (children.next(childType, child, childEnd))
+                    {
+                        if (isType(childType, "avcC") || isType(childType, "hvcC"))
+                            track->codecConfig.assign(child, childEnd);
+                    }
+                }
+            }
+        }
+        else if (isType(type, "stts"))
+        {
+            stts = payload;
+            sttsEnd = payloadEnd;
+        }
+        else if (isType(type, "stss"))
+        {
+            stss = payload;
+            stssEnd = payloadEnd;
+        }
+    }
+
+    if (track && stts)
+    {
+        parseSampleTable(stts, sttsEnd, stss, stssEnd, *track);
+    }
+}
+
+void Mp4Index::parseSampleTable(const uint8_t *stts, const uint8_t *sttsEnd,
+                                const uint8_t *stss, const uint8_t *stssEnd, Track &track)
+{
+    uint8_t version;
+    uint32_t flags;
+
+    Reader times(stts, sttsEnd);
+    times.fullBox(version, flags);
+    uint32_t timeEntries = times.u32();
+
+    // Without stss every sample is a sync sample
+    Reader syncs(stss ? stss : stts, stss ? stssEnd : stts);
+    uint32_t syncEntries = 0;
+    if (stss)
+    {
+        syncs.fullBox(version, flags);
+        syncEntries = syncs.u32();
+    }
+    uint32_t nextSync = syncEntries ? syncs.u32() : 0;
+
+    // Walk stts runs and stss sample numbers (1-based) together
+    uint64_t sample = 1;
+    uint64_t time = 0;
+    for (uint32_t i = 0; i < timeEntries && times.has(8); i++)
+    {
+        uint32_t count = times.u32();
+        uint32_t delta = times.u32();
+        if (sample - 1 + count > maxSamples_)
+        {
+            error_ = "implausible stts sample count";
+            return;
+        }
+
+        if (!stss)
+        {
+            for (uint32_t j = 0; j < count; j++)
+                track.keyframes.push_back(time + static_cast<uint64_t>(j) * delta);
+        }
+        else
+        {
+            while (syncEntries && nextSync >= sample && nextSync < sample + count)
+            {
+                track.keyframes.push_back(time + (nextSync - sample) * delta);
+                syncEntries--;
+                nextSync = syncEntries ? syncs.u32() : 0;
+            }
+        }
+
+        sample += count;
+        time += static_cast<uint64_t>(count) * delta;
+    }
+
+    track.sampleCount = sample - 1;
+    track.durationTicks = std::max(track.durationTicks, time);
+}
+
+void Mp4Index::parseTraf(const uint8_t *begin, const uint8_t *end)
+{
+    BoxIterator boxes(begin, end);
+    const uint8_t *type;
+    const uint8_t *payload;
+    const uint8_t *payloadEnd;
+
+    Track *track = nullptr;
+    uint32_t trackId = 0;
+    uint32_t defaultDuration = 0;
+    uint32_t defaultFlags = 0;
+    bool haveDecodeTime = false;
+    uint64_t decodeTime = 0;
+
+    while (error_.empty() && boxes.next(type, payload, payloadEnd))
+    {
+        Reader r(payload, payloadEnd);
+        uint8_t version;
+        uint32_t flags;
+
+        if (isType(type, "tfhd"))
+        {
+            r.fullBox(version, flags);
+            trackId = r.u32();
+            track = &tracks_[trackId];
+            defaultDuration = track->defaultSampleDuration;
+            defaultFlags = track->defaultSampleFlags;
+
+            if (flags & 0x01)
+                r.u64(); // base_data_offset
+            if (flags & 0x02)
+                r.u32(); // sample_description_index
+            if (flags & 0x08)
+                defaultDuration = r.u32();
+            if (flags & 0x10)
+                r.u32(); // default_sample_size
+            if (flags & 0x20)
+                defaultFlags = r.u32();
+        }
+        else if (isType(type, "tfdt"))
+        {
+            r.fullBox(version, flags);
+            decodeTime = version == 1 ? r.u64() : r.u32();
+            haveDecodeTime = true;
+        }
+        else if (isType(type, "trun") && track)
+        {
+            if (!haveDecodeTime)
+            {
+                decodeTime = fragmentEnd_[trackId];
+                haveDecodeTime = true;
+            }
+
+            r.fullBox(version, flags);
+            uint32_t count = r.u32();
+            uint32_t firstFlags = defaultFlags;
+            bool haveFirstFlags = false;
+            if (flags & 0x001)
+                r.u32(); // data_offset
+            if (flags & 0x004)
+            {
+                firstFlags = r.u32();
+                haveFirstFlags = true;
+            }
+
+            size_t entrySize = 4 * (((flags & 0x100) ? 1 : 0) + ((flags & 0x200) ? 1 : 0) +
+                                    ((flags & 0x400) ? 1 : 0) + ((flags & 0x800) ? 1 : 0));
+
+            // Entries past the end of the box are not there; with no
+            // per-sample fields only the file size bounds the count
+            if (entrySize > 0)
+                count = static_cast<uint32_t>(std::min<size_t>(count, r.remaining() / entrySize));
+            if (track->sampleCount + count > maxSamples_)
+            {
+                error_ = "implausible trun sample count";
+                return;
+            }
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t duration = (flags & 0x100) ? r.u32() : defaultDuration;
+                if (flags & 0x200)
+                    r.u32(); // sample_size
+                uint32_t sampleFlags = (i == 0 && haveFirstFlags) ? firstFlags : defaultFlags;
+                if (flags & 0x400)
+                    sampleFlags = r.u32();
+                if (flags & 0x800)
+                    r.u32(); // composition_time_offset
+
+                if (track->sampleCount == 0)
+                    track->firstDecodeTicks = decodeTime;
+                if (!(sampleFlags & NON_SYNC_SAMPLE))
+                    track->keyframes.push_back(decodeTime);
+                decodeTime += duration;
+                track->sampleCount++;
+            }
+
+            fragmentEnd_[trackId] = decodeTime;
+            track->durationTicks = std::max(track->durationTicks, decodeTime);
+        }
+    }
+}
+
+int64_t Mp4Index::toUs(uint64_t ticks, uint32_t timescale)
+{
+    if (timescale == 0)
+        return 0;
+    return static_cast<int64_t>(ticks / timescale * 1000000 + ticks % timescale * 1000000 / timescale);
+}
+
+const Mp4Index::Track *Mp4Index::videoTrack() const
+{
+    for (const auto &entry : tracks_)
+    {
+        if (entry.second.handler == "vide")
+            return &entry.second;
+    }
+    return nullptr;
+}
+
+int64_t Mp4Index::durationUs() const
+{
+    int64_t duration = toUs(movieDuration_, movieTimescale_);
+    for (const auto &entry : tracks_)
+    {
+        duration = std::max(duration, toUs(entry.second.durationTicks, entry.second.timescale));
+    }
+    return duration;
+}
+
+int64_t Mp4Index::creationTimeUs() const
+{
+    if (creationTime_ <= MP4_EPOCH_OFFSET)
+        return 0;
+    return static_cast<int64_t>(creationTime_ - MP4_EPOCH_OFFSET) * 1000000;
+}
+
+int64_t Mp4Index::firstSampleUs() const
+{
+    const Track *track = videoTrack();
+    return track ? toUs(track->firstDecodeTicks, track->timescale) : 0;
+}
+
+std::vector<int64_t> Mp4Index::keyframesUs() const
+{
+    std::vector<int64_t> result;
+    const Track *track = videoTrack();
+    if (!track)
+        return result;
+
+    result.reserve(track->keyframes.size());
+    for (uint64_t ticks : track->keyframes)
+    {
+        result.push_back(toUs(ticks, track->timescale));
+    }
+    return result;
+}
+
+int64_t Mp4Index::keyframeAtOrBefore(int64_t offsetUs) const
+{
+    std::vector<int64_t> keyframes = keyframesUs();
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), offsetUs);
+    if (it == keyframes.begin())
+        return 0;
+    return *(it - 1);
+}
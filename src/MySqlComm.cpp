@@ -1,252 +1,456 @@
 #include "MySqlComm.h"
 #include <iostream>
 #include <sstream>
-#include <string.h>
+#include <algorithm>
+#include "SettingsCache.h"
 
 MySqlComm::MySqlComm(std::shared_ptr<Logger> logger)
-    : logger_(logger), connection_(nullptr), settingsLoaded_(false)
+    : logger_(logger), backend_(StorageBackend::create(ConfigIni(), logger)),
+      uploader_(logger), settings_(std::make_shared<AppSettings>()), watcherRunning_(false)
 {
-    // Database connection parameters for local MariaDB
-    host_ = "127.0.0.1";
-    user_ = "bus";
-    password_ = "njkmrjbus";
-    database_ = "busLocal";
-    port_ = 3306;
+    replicator_ = std::make_unique<Replicator>(logger_, *backend_);
+    cachePath_ = expandHomePath("~/PassFlow/settings.cache");
 }
 
 MySqlComm::~MySqlComm()
 {
+    stopSettingsWatcher();
+    stopReplication();
+    stopUploads();
     disconnect();
 }
 
+void MySqlComm::configure(const ConfigIni &config)
+{
+    // The replicator reads through the backend: replace both together
+    replicator_.reset();
+    backend_ = StorageBackend::create(config, logger_);
+    replicator_ = std::make_unique<Replicator>(logger_, *backend_);
+    replicator_->configure(config);
+    replicator_->setRemotes(getSettings()->remoteDBAddresses);
+    uploader_.configure(config);
+    cachePath_ = expandHomePath(config.getString("Database", "SettingsCache", cachePath_));
+    logger_->log("MySqlComm: Using " + std::string(backend_->name()) + " storage backend");
+}
+
 bool MySqlComm::connect()
+{
+    return backend_->connect();
+}
+
+void MySqlComm::disconnect()
+{
+    backend_->disconnect();
+}
+
+bool MySqlComm::isConnected() const
+{
+    return backend_->isConnected();
+}
+
+bool MySqlComm::reconnect()
+{
+    disconnect();
+    return connect();
+}
+
+bool MySqlComm::writeRecord(const StorageRecord &record)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    if (connection_ != nullptr)
+    // Writes issued while the database is unreachable are kept in memory
+    // and replayed by flushPendingWrites() once a connection exists
+    if (!backend_->hasConnection())
     {
-        return true; // Already connected
+        spoolWrite(record);
+        return true;
     }
 
-    connection_ = mysql_init(nullptr);
-    if (connection_ == nullptr)
+    switch (backend_->write(record))
     {
-        logger_->logError("MySqlComm: mysql_init() failed");
+    case WriteStatus::Ok:
+        return true;
+    case WriteStatus::Offline:
+        spoolWrite(record);
+        return true;
+    default:
         return false;
     }
+}
 
-    // Set connection timeout
-    unsigned int timeout = 10;
-    mysql_options(connection_, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
-
-    // Enable auto-reconnect
-    bool reconnect = true;
-    mysql_options(connection_, MYSQL_OPT_RECONNECT, &reconnect);
-
-    if (mysql_real_connect(connection_,
-                           host_.c_str(),
-                           user_.c_str(),
-                           password_.c_str(),
-                           database_.c_str(),
-                           port_,
-                           nullptr,
-                           0) == nullptr)
+void MySqlComm::spoolWrite(const StorageRecord &record)
+{
+    // Caller holds mutex_
+    if (pendingWrites_.size() >= MAX_PENDING_WRITES)
     {
-        logger_->logError("MySqlComm: Connection failed - " +
-                          std::string(mysql_error(connection_)));
-        mysql_close(connection_);
-        connection_ = nullptr;
-        return false;
+        pendingWrites_.pop_front();
+        droppedWrites_++;
     }
-
-    // Set character encoding
-    mysql_set_character_set(connection_, "utf8mb4");
-
-    logger_->log("MySqlComm: Connected to database " + database_ + " at " + host_);
-    return true;
+    pendingWrites_.push_back(record);
 }
 
-void MySqlComm::disconnect()
+size_t MySqlComm::flushPendingWrites()
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    if (connection_ != nullptr)
+    if (!backend_->hasConnection())
     {
-        mysql_close(connection_);
-        connection_ = nullptr;
-        logger_->log("MySqlComm: Disconnected from database");
+        return 0;
     }
-}
 
-bool MySqlComm::isConnected() const
-{
-    std::lock_guard<std::mutex> lock(mutex_);
+    size_t flushed = 0;
+    while (!pendingWrites_.empty())
+    {
+        WriteStatus status = backend_->write(pendingWrites_.front());
+        if (status == WriteStatus::Offline)
+        {
+            break;
+        }
+        if (status == WriteStatus::Failed)
+        {
+            logger_->logError("MySqlComm: Spooled write failed, dropping it");
+        }
+        pendingWrites_.pop_front();
+        flushed++;
+    }
 
-    if (connection_ == nullptr)
+    if (!backend_->flush())
     {
-        return false;
+        logger_->logError("MySqlComm: Some buffered writes could not be stored");
     }
 
-    return mysql_ping(connection_) == 0;
-}
+    if (flushed > 0 || droppedWrites_ > 0)
+    {
+        logger_->log("MySqlComm: Flushed " + std::to_string(flushed) + " spooled write(s), " +
+                     std::to_string(droppedWrites_) + " dropped while offline");
+        droppedWrites_ = 0;
+    }
 
-bool MySqlComm::reconnect()
-{
-    disconnect();
-    return connect();
+    return flushed;
 }
 
-bool MySqlComm::executeQuery(const std::string &query)
+size_t MySqlComm::pendingWriteCount() const
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    return pendingWrites_.size();
+}
 
-    if (connection_ == nullptr)
+bool MySqlComm::initialize()
+{
+    if (!connect())
     {
-        logger_->logError("MySqlComm: Not connected to database");
         return false;
     }
 
-    if (mysql_query(connection_, query.c_str()) != 0)
+    if (!loadSettings())
     {
-        logger_->logError("MySqlComm: Query failed - " +
-                          std::string(mysql_error(connection_)) +
-                          " Query: " + query);
+        logger_->logError("MySqlComm: Failed to load settings from database");
         return false;
     }
 
     return true;
 }
 
-MYSQL_RES *MySqlComm::executeSelectQuery(const std::string &query)
+bool MySqlComm::loadSettings()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // Build a fresh snapshot; readers keep using the old one until it is published
+    auto next = std::make_shared<AppSettings>();
+    AppSettings &settings = *next;
+    std::string stamp;
 
-    if (connection_ == nullptr)
+    if (!backend_->loadSettings(settings, stamp))
     {
-        logger_->logError("MySqlComm: Not connected to database");
-        return nullptr;
+        logger_->logError("MySqlComm: Failed to query settings table");
+        return false;
     }
 
-    if (mysql_query(connection_, query.c_str()) != 0)
+    logger_->log("MySqlComm: Loaded settings - doors=" + std::to_string(settings.doors) +
+                 ", stopBeginDelay=" + std::to_string(settings.stopBeginDelay) +
+                 ", stopEndDelay=" + std::to_string(settings.stopEndDelay) +
+                 ", daysBeforeDeleteVideo=" + std::to_string(settings.daysBeforeDeleteVideo));
+
+    if (settings.cameras.empty())
     {
-        logger_->logError("MySqlComm: Query failed - " +
-                          std::string(mysql_error(connection_)) +
-                          " Query: " + query);
-        return nullptr;
+        // Fall back to the legacy cam0_string/cam1_string columns
+        const std::string *legacy[] = {&settings.cam0String, &settings.cam1String};
+        for (int i = 0; i < 2 && i < settings.doors; i++)
+        {
+            if (!legacy[i]->empty())
+            {
+                settings.cameras.push_back({i, i, *legacy[i], true});
+            }
+        }
+        logger_->log("MySqlComm: Using legacy camera columns (" +
+                     std::to_string(settings.cameras.size()) + " camera(s))");
     }
 
-    return mysql_store_result(connection_);
+    for (const auto &cam : settings.cameras)
+    {
+        logger_->log("MySqlComm: Camera " + std::to_string(cam.id) + " (door " +
+                     std::to_string(cam.doorId) + ", " +
+                     (cam.enabled ? "enabled" : "disabled") + "): " + cam.rtspUrl);
+    }
+    logger_->log(settings.statusBits == defaultStatusBitMap()
+                     ? "MySqlComm: Using default SystemStatus bit layout"
+                     : "MySqlComm: Loaded SystemStatus bit layout from status_bits");
+    for (const auto &address : settings.remoteDBAddresses)
+    {
+        logger_->log("MySqlComm: Remote DB address: " + address);
+    }
+
+    publishSettings(next, stamp);
+
+    if (!cachePath_.empty() && !SettingsCache::save(cachePath_, settings, stamp))
+    {
+        logger_->logError("MySqlComm: Failed to write settings cache " + cachePath_);
+    }
+
+    return true;
 }
 
-std::string MySqlComm::escapeString(const std::string &str)
+bool MySqlComm::loadLocalSettings(const ConfigIni &config)
 {
-    if (connection_ == nullptr || str.empty())
+    auto local = std::make_shared<AppSettings>();
+    std::string stamp;
+
+    if (!cachePath_.empty() && SettingsCache::load(cachePath_, *local, stamp))
     {
-        return str;
+        logger_->log("MySqlComm: Loaded settings from cache " + cachePath_ +
+                     " (updated_at " + stamp + ")");
+    }
+    else
+    {
+        // No usable cache: derive settings from config.ini
+        *local = AppSettings();
+        stamp.clear();
+        local->doors = config.getInt("System", "Doors", 2);
+        local->stopBeginDelay = config.getInt("System", "StopBeginDelay", 5);
+        local->stopEndDelay = config.getInt("System", "StopEndDelay", 5);
+        local->daysBeforeDeleteVideo = config.getInt("System", "DaysBeforeDeleteVideo", 30);
+
+        for (int id = 0; id < MAX_DOORS; id++)
+        {
+            std::string section = "Camera" + std::to_string(id);
+            if (!config.hasSection(section))
+                continue;
+
+            CameraSettings cam;
+            cam.id = id;
+            cam.doorId = config.getInt(section, "Door", id);
+            cam.rtspUrl = config.getString(section, "RTSPUrl");
+            cam.enabled = config.getBool(section, "Enabled", true);
+            local->cameras.push_back(cam);
+        }
+
+        logger_->log("MySqlComm: No settings cache, using " + config.path() + " (" +
+                     std::to_string(local->cameras.size()) + " camera(s))");
     }
 
-    std::vector<char> buffer(str.length() * 2 + 1);
-    mysql_real_escape_string(connection_, buffer.data(), str.c_str(), str.length());
-    return std::string(buffer.data());
+    bool usable = std::any_of(local->cameras.begin(), local->cameras.end(),
+                              [](const CameraSettings &cam)
+                              { return cam.enabled && !cam.rtspUrl.empty(); });
+    if (usable)
+    {
+        publishSettings(local, stamp);
+    }
+    return usable;
 }
 
-bool MySqlComm::initialize()
+void MySqlComm::publishSettings(std::shared_ptr<const AppSettings> next, const std::string &stamp)
 {
-    if (!connect())
+    std::shared_ptr<const AppSettings> previous;
+    std::vector<SettingsListener> listeners;
     {
-        return false;
+        std::lock_guard<std::mutex> lock(listenerMutex_);
+        previous = std::atomic_load(&settings_);
+        std::atomic_store(&settings_, next);
+        settingsStamp_ = stamp;
+        listeners = listeners_;
     }
 
-    if (!loadSettings())
+    replicator_->setRemotes(next->remoteDBAddresses);
+
+    // Listeners run outside the lock so they may read the new snapshot freely
+    for (auto &listener : listeners)
     {
-        logger_->logError("MySqlComm: Failed to load settings from database");
-        return false;
+        listener(previous, next);
     }
-
-    return true;
 }
 
-bool MySqlComm::loadSettings()
+void MySqlComm::addSettingsListener(SettingsListener listener)
 {
-    // Read from 'settings' table
-    std::string settingsQuery = "SELECT doors, stopBeginDelay, stopEndDelay, "
-                                "daysBeforeDeliteVideo, cam0_string, cam1_string "
-                                "FROM settings LIMIT 1";
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    listeners_.push_back(std::move(listener));
+}
 
-    MYSQL_RES *result = executeSelectQuery(settingsQuery);
-    if (result == nullptr)
+bool MySqlComm::settingsChanged()
+{
+    std::string stamp;
+    if (!backend_->readSettingsStamp(stamp))
     {
-        logger_->logError("MySqlComm: Failed to query settings table");
         return false;
     }
 
-    MYSQL_ROW row = mysql_fetch_row(result);
-    if (row == nullptr)
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    return !stamp.empty() && stamp != settingsStamp_;
+}
+
+void MySqlComm::startSettingsWatcher(std::chrono::seconds interval)
+{
+    if (watcherRunning_)
     {
-        logger_->logError("MySqlComm: No settings found in database");
-        mysql_free_result(result);
-        return false;
+        return;
     }
 
-    // Parse settings
-    settings_.doors = row[0] ? std::stoi(row[0]) : 2;
-    settings_.stopBeginDelay = row[1] ? std::stoi(row[1]) : 5;
-    settings_.stopEndDelay = row[2] ? std::stoi(row[2]) : 5;
-    settings_.daysBeforeDeleteVideo = row[3] ? std::stoi(row[3]) : 30;
-    settings_.cam0String = row[4] ? row[4] : "";
-    settings_.cam1String = row[5] ? row[5] : "";
+    watcherRunning_ = true;
+    watcherThread_ = std::thread(&MySqlComm::settingsWatcherLoop, this, interval);
 
-    mysql_free_result(result);
-
-    logger_->log("MySqlComm: Loaded settings - doors=" + std::to_string(settings_.doors) +
-                 ", stopBeginDelay=" + std::to_string(settings_.stopBeginDelay) +
-                 ", stopEndDelay=" + std::to_string(settings_.stopEndDelay) +
-                 ", daysBeforeDeleteVideo=" + std::to_string(settings_.daysBeforeDeleteVideo));
-    logger_->log("MySqlComm: Camera 0 URL: " + settings_.cam0String);
-    logger_->log("MySqlComm: Camera 1 URL: " + settings_.cam1String);
+    logger_->log("MySqlComm: Settings watcher started (every " +
+                 std::to_string(interval.count()) + "s)");
+}
 
-    // Read from 'remoteDB' table
-    std::string remoteDbQuery = "SELECT remoteDBAddress FROM remoteDB";
+void MySqlComm::settingsWatcherLoop(std::chrono::seconds interval)
+{
+    std::unique_lock<std::mutex> lock(watcherMutex_);
+    bool connected = isConnected();
 
-    result = executeSelectQuery(remoteDbQuery);
-    if (result != nullptr)
+    while (watcherRunning_)
     {
-        settings_.remoteDBAddresses.clear();
-        while ((row = mysql_fetch_row(result)) != nullptr)
+        if (connected)
         {
-            if (row[0] != nullptr && strlen(row[0]) > 0)
+            watcherCv_.wait_for(lock, interval, [this] { return !watcherRunning_; });
+        }
+        if (!watcherRunning_)
+            break;
+
+        lock.unlock();
+        if (!connected)
+        {
+            // Started from cache/config.ini: reconcile as soon as the database is up
+            connected = connect();
+            if (connected)
             {
-                settings_.remoteDBAddresses.push_back(row[0]);
-                logger_->log("MySqlComm: Remote DB address: " + std::string(row[0]));
+                loadSettings();
+                flushPendingWrites();
+                applyRetention(getSettings()->daysBeforeDeleteVideo, std::chrono::system_clock::now());
             }
         }
-        mysql_free_result(result);
+        else if (settingsChanged())
+        {
+            logger_->log("MySqlComm: settings.updated_at changed, reloading settings");
+            loadSettings();
+        }
+        lock.lock();
+
+        if (!connected)
+        {
+            watcherCv_.wait_for(lock, RECONNECT_INTERVAL, [this] { return !watcherRunning_; });
+        }
+    }
+}
+
+void MySqlComm::stopSettingsWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(watcherMutex_);
+        if (!watcherRunning_)
+            return;
+        watcherRunning_ = false;
     }
+    watcherCv_.notify_all();
 
-    settingsLoaded_ = true;
-    return true;
+    if (watcherThread_.joinable())
+    {
+        watcherThread_.join();
+    }
+}
+
+void MySqlComm::applyRetention(int days, std::chrono::system_clock::time_point now)
+{
+    // Every camera's cleanup calls in; the first one in an interval does the work
+    std::unique_lock<std::mutex> lock(retentionMutex_, std::try_to_lock);
+    auto started = std::chrono::steady_clock::now();
+    if (!lock.owns_lock() || days <= 0 || !backend_->hasConnection() ||
+        (lastRetention_.time_since_epoch().count() != 0 && started - lastRetention_ < RETENTION_INTERVAL))
+    {
+        return;
+    }
+    lastRetention_ = started;
+
+    if (!backend_->applyRetention(now - std::chrono::hours(24 * days), now))
+    {
+        logger_->logError("MySqlComm: Retention of events and video segments failed");
+    }
 }
 
-std::string MySqlComm::eventTypeToString(EventType event)
+bool MySqlComm::readDoorStats(const std::string &from, const std::string &to,
+                              std::vector<DoorStatsRecord> &rows)
+{
+    return backend_->hasConnection() && backend_->readDoorStats(from, to, rows);
+}
+
+bool MySqlComm::readVideoSegments(int64_t afterId, size_t limit, std::vector<StoredRecord> &rows)
+{
+    return backend_->hasConnection() && backend_->readSince(RecordTable::VideoSegments, afterId, limit, rows);
+}
+
+void MySqlComm::startReplication()
+{
+    replicator_->start();
+}
+
+void MySqlComm::stopReplication()
+{
+    replicator_->stop();
+}
+
+bool MySqlComm::replicateOnce()
+{
+    return replicator_->syncOnce();
+}
+
+std::vector<Replicator::RemoteStatus> MySqlComm::replicationStatus() const
+{
+    return replicator_->status();
+}
+
+void MySqlComm::startUploads()
+{
+    uploader_.start();
+}
+
+void MySqlComm::stopUploads()
+{
+    uploader_.stop();
+}
+
+ClipUploader::Stats MySqlComm::uploadStats() const
+{
+    return uploader_.stats();
+}
+
+void MySqlComm::setPowerMode(PowerMode mode)
+{
+    uploader_.setPowerMode(mode);
+
+    if (mode != PowerMode::Active)
+    {
+        flushPendingWrites();
+    }
+}
+
+std::string MySqlComm::eventTypeToString(EventType event, int index)
 {
     switch (event)
     {
-    case EventType::Door0Open:
-        return "Door 0 open";
-    case EventType::Door0Close:
-        return "Door 0 closed";
-    case EventType::Door1Open:
-        return "Door 1 open";
-    case EventType::Door1Close:
-        return "Door 1 closed";
-    case EventType::Cover0Open:
-        return "Cover 0 open";
-    case EventType::Cover0Close:
-        return "Cover 0 closed";
-    case EventType::Cover1Open:
-        return "Cover 1 open";
-    case EventType::Cover1Close:
-        return "Cover 1 closed";
+    case EventType::DoorOpen:
+        return "Door " + std::to_string(index) + " open";
+    case EventType::DoorClose:
+        return "Door " + std::to_string(index) + " closed";
+    case EventType::CoverOpen:
+        return "Cover " + std::to_string(index) + " open";
+    case EventType::CoverClose:
+        return "Cover " + std::to_string(index) + " closed";
     case EventType::MainSupplyOn:
         return "Main supply ON";
     case EventType::MainSupplyOff:
@@ -260,22 +464,15 @@ std::string MySqlComm::eventTypeToString(EventType event)
     }
 }
 
-bool MySqlComm::logEvent(EventType event, const std::string &timestamp)
+bool MySqlComm::logEvent(EventType event, int index, const std::string &timestamp)
 {
-    std::string eventStr = escapeString(eventTypeToString(event));
-    std::string timestampStr = escapeString(timestamp);
-
-    std::stringstream query;
-    query << "INSERT INTO events (event, DateTime) VALUES ('"
-          //   << static_cast<int>(event) << "', '"
-          << eventStr << "', '"
-          << timestampStr << "')";
+    std::string description = eventTypeToString(event, index);
 
-    bool success = executeQuery(query.str());
+    bool success = writeRecord(EventRecord{static_cast<int>(event), description, timestamp});
 
     if (success)
     {
-        logger_->log("MySqlComm: Logged event - " + eventTypeToString(event) +
+        logger_->log("MySqlComm: Logged event - " + description +
                      " at " + timestamp);
     }
 
@@ -285,16 +482,11 @@ bool MySqlComm::logEvent(EventType event, const std::string &timestamp)
 bool MySqlComm::logVideoSegment(int cameraId,
                                 const std::string &startTime,
                                 const std::string &stopTime,
-                                const std::string &filename)
+                                const std::string &filename,
+                                const std::string &encoding)
 {
-    std::stringstream query;
-    query << "INSERT INTO video_segments (camera_id, start_time, stop_time, filename) VALUES ("
-          << cameraId << ", '"
-          << escapeString(startTime) << "', '"
-          << escapeString(stopTime) << "', '"
-          << escapeString(filename) << "')";
-
-    bool success = executeQuery(query.str());
+    bool success = writeRecord(VideoSegmentRecord{cameraId, startTime, stopTime, filename, encoding});
+    uploader_.enqueue(filename);
 
     if (success)
     {
@@ -304,3 +496,13 @@ bool MySqlComm::logVideoSegment(int cameraId,
 
     return success;
 }
+
+bool MySqlComm::logDoorStats(const std::vector<DoorStatsRecord> &records)
+{
+    bool success = true;
+    for (const auto &record : records)
+    {
+        success = writeRecord(record) && success;
+    }
+    return success;
+}
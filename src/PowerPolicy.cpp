@@ -0,0 +1,78 @@
+#include "PowerPolicy.h"
+
+PowerPolicy::PowerPolicy(std::chrono::seconds lowPowerAfter)
+    : lowPowerAfter_(lowPowerAfter), mode_(PowerMode::Active), started_(false), ignition_(true),
+      mainSupply_(true), timeIn_{}, wakes_(0)
+{
+}
+
+bool PowerPolicy::update(bool ignition, bool mainSupply, Timeline::Instant now)
+{
+    if (!started_)
+    {
+        since_ = now;
+        started_ = true;
+    }
+
+    // The idle time counts from the ignition OFF edge; a first frame with
+    // the ignition off is such an edge too
+    if (ignition_ && !ignition)
+    {
+        idleSince_ = now;
+    }
+    ignition_ = ignition;
+    mainSupply_ = mainSupply;
+    return apply(now);
+}
+
+bool PowerPolicy::activity(Timeline::Instant now)
+{
+    idleSince_ = now;
+    return started_ && apply(now);
+}
+
+bool PowerPolicy::poll(Timeline::Instant now)
+{
+    return started_ && apply(now);
+}
+
+PowerMode PowerPolicy::target(Timeline::Instant now) const
+{
+    if (ignition_ || lowPowerAfter_.count() <= 0 || now - idleSince_ < lowPowerAfter_)
+        return PowerMode::Active;
+    return mainSupply_ ? PowerMode::Parked : PowerMode::Battery;
+}
+
+bool PowerPolicy::apply(Timeline::Instant now)
+{
+    PowerMode next = target(now);
+    if (next == mode_)
+        return false;
+
+    timeIn_[static_cast<size_t>(mode_)] += std::chrono::duration_cast<std::chrono::milliseconds>(now - since_);
+    if (next == PowerMode::Active)
+    {
+        wakes_++;
+    }
+    mode_ = next;
+    since_ = now;
+    return true;
+}
+
+std::string PowerPolicy::summary(Timeline::Instant now) const
+{
+    std::array<std::chrono::milliseconds, 3> total = timeIn_;
+    if (started_)
+    {
+        total[static_cast<size_t>(mode_)] += std::chrono::duration_cast<std::chrono::milliseconds>(now - since_);
+    }
+
+    std::string text;
+    for (PowerMode mode : {PowerMode::Active, PowerMode::Parked, PowerMode::Battery})
+    {
+        text += std::string(powerModeName(mode)) + " " +
+                std::to_string(std::chrono::duration_cast<std::chrono::seconds>(total[static_cast<size_t>(mode)]).count()) +
+                "s, ";
+    }
+    return text + std::to_string(wakes_) + " wake(s)";
+}
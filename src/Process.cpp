@@ -0,0 +1,130 @@
+#include "Process.h"
+#include <thread>
+#include <algorithm>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+namespace Process
+{
+
+pid_t spawn(const std::vector<std::string> &args, int niceness)
+{
+    if (args.empty())
+    {
+        return -1;
+    }
+
+    std::vector<char *> argv;
+    for (const auto &arg : args)
+    {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // The daemon blocks SIGINT/SIGTERM in all threads; the child must
+        // receive them to finalize its output
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, nullptr);
+
+        if (niceness > 0)
+        {
+            // Best-effort class (2), lowest level (7): yields the SD card to
+            // the recorders without starving like the idle class can
+            setpriority(PRIO_PROCESS, 0, getpriority(PRIO_PROCESS, 0) + niceness);
+            syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, (2 << 13) | 7);
+        }
+
+        int devNull = open("/dev/null", O_RDONLY);
+        if (devNull >= 0)
+        {
+            dup2(devNull, STDIN_FILENO);
+            close(devNull);
+        }
+
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    return pid;
+}
+
+bool hasExited(pid_t pid, int *exitStatus)
+{
+    if (pid <= 0)
+    {
+        return true;
+    }
+
+    int status = 0;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if (result == 0)
+    {
+        return false;
+    }
+
+    if (exitStatus)
+    {
+        *exitStatus = (result == pid && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+    }
+    return true;
+}
+
+bool waitUntil(pid_t pid, std::chrono::steady_clock::time_point deadline, int *exitStatus)
+{
+    auto pollInterval = std::chrono::milliseconds(5);
+
+    while (!hasExited(pid, exitStatus))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(pollInterval);
+        pollInterval = std::min(pollInterval * 2, std::chrono::milliseconds(50));
+    }
+    return true;
+}
+
+bool stop(pid_t pid, int signal, std::chrono::steady_clock::time_point deadline)
+{
+    if (pid <= 0)
+    {
+        return true;
+    }
+
+    kill(pid, signal);
+    if (waitUntil(pid, deadline))
+    {
+        return true;
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return false;
+}
+
+int run(const std::vector<std::string> &args, int niceness)
+{
+    pid_t pid = spawn(args, niceness);
+    if (pid < 0)
+    {
+        return -1;
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+}
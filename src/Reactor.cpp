@@ -0,0 +1,297 @@
+#include "Reactor.h"
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+namespace
+{
+int openPidFd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+timespec toTimespec(std::chrono::nanoseconds ns)
+{
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns.count() % 1000000000);
+    return ts;
+}
+}
+
+Reactor::Reactor(std::shared_ptr<Logger> logger)
+    : logger_(logger), epollFd_(::epoll_create1(EPOLL_CLOEXEC)),
+      wakeFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), running_(false), nextTimerId_(1), nextGeneration_(1)
+{
+    if (!valid())
+    {
+        logger_->logError("Reactor: Cannot create epoll/eventfd - " + std::string(strerror(errno)));
+        return;
+    }
+
+    add(wakeFd_, EPOLLIN, [this](uint32_t)
+        {
+            uint64_t count;
+            while (::read(wakeFd_, &count, sizeof(count)) > 0)
+            {
+            }
+            runPosted();
+        },
+        false);
+}
+
+Reactor::~Reactor()
+{
+    for (const auto &entry : handlers_)
+    {
+        if (entry.second->ownsFd)
+        {
+            ::close(entry.first);
+        }
+    }
+    if (wakeFd_ >= 0)
+        ::close(wakeFd_);
+    if (epollFd_ >= 0)
+        ::close(epollFd_);
+}
+
+bool Reactor::add(int fd, uint32_t events, FdCallback callback, bool ownsFd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // The event carries the registration's generation next to the fd, so an
+    // event queued for a removed registration is not delivered to a new one
+    // that got the same fd number
+    uint32_t generation = nextGeneration_++;
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        logger_->logError("Reactor: Cannot watch fd " + std::to_string(fd) + " - " + strerror(errno));
+        return false;
+    }
+
+    handlers_[fd] = std::make_shared<Handler>(Handler{std::move(callback), ownsFd, generation});
+    return true;
+}
+
+void Reactor::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end())
+        return;
+
+    ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (it->second->ownsFd)
+    {
+        ::close(fd);
+    }
+    handlers_.erase(it);
+}
+
+bool Reactor::addFd(int fd, uint32_t events, FdCallback callback)
+{
+    return add(fd, events, std::move(callback), false);
+}
+
+void Reactor::removeFd(int fd)
+{
+    remove(fd);
+}
+
+Reactor::TimerId Reactor::addTimer(std::chrono::steady_clock::time_point when, Callback callback,
+                                   std::chrono::milliseconds interval)
+{
+    // steady_clock is CLOCK_MONOTONIC, so the deadline can be armed as is
+    int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        logger_->logError("Reactor: timerfd_create failed - " + std::string(strerror(errno)));
+        return -1;
+    }
+
+    itimerspec spec{};
+    spec.it_value = toTimespec(std::max(when.time_since_epoch(), std::chrono::steady_clock::duration(1)));
+    spec.it_interval = toTimespec(interval);
+    ::timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+    TimerId id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = nextTimerId_++;
+        timers_[id] = fd;
+    }
+
+    bool repeating = interval.count() > 0;
+    bool added = add(fd, EPOLLIN, [this, fd, id, repeating, callback](uint32_t)
+                     {
+                         uint64_t expirations;
+                         if (::read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                             return;
+                         if (!repeating)
+                         {
+                             cancelTimer(id);
+                         }
+                         callback();
+                     },
+                     true);
+    if (!added)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.erase(id);
+        ::close(fd);
+        return -1;
+    }
+    return id;
+}
+
+void Reactor::cancelTimer(TimerId id)
+{
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = timers_.find(id);
+        if (it == timers_.end())
+            return;
+        fd = it->second;
+        timers_.erase(it);
+    }
+    remove(fd);
+}
+
+bool Reactor::addSignals(const sigset_t &signals, std::function<void(int)> callback)
+{
+    int fd = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0)
+    {
+        logger_->logError("Reactor: signalfd failed - " + std::string(strerror(errno)));
+        return false;
+    }
+
+    return add(fd, EPOLLIN, [fd, callback](uint32_t)
+               {
+                   signalfd_siginfo info;
+                   while (::read(fd, &info, sizeof(info)) == sizeof(info))
+                   {
+                       callback(static_cast<int>(info.ssi_signo));
+                   }
+               },
+               true);
+}
+
+bool Reactor::watchChild(pid_t pid, Callback callback)
+{
+    int fd = openPidFd(pid);
+    if (fd >= 0)
+    {
+        // A pidfd becomes readable once the process has exited
+        return add(fd, EPOLLIN, [this, fd, callback](uint32_t)
+                   {
+                       remove(fd);
+                       callback();
+                   },
+                   true);
+    }
+
+    // No pidfd (kernel < 5.3): check without reaping once a second
+    auto timer = std::make_shared<TimerId>(-1);
+    *timer = addTimer(std::chrono::steady_clock::now() + std::chrono::seconds(1), [this, pid, timer, callback]()
+                      {
+                          siginfo_t info{};
+                          int result = ::waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT);
+                          if (result == 0 && info.si_pid == 0)
+                              return;
+                          cancelTimer(*timer);
+                          callback();
+                      },
+                      std::chrono::seconds(1));
+    return *timer >= 0;
+}
+
+void Reactor::post(Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(callback));
+    }
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeFd_, &one, sizeof(one));
+    (void)written;
+}
+
+void Reactor::runPosted()
+{
+    std::vector<Callback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks.swap(posted_);
+    }
+    for (auto &callback : callbacks)
+    {
+        callback();
+    }
+}
+
+void Reactor::run()
+{
+    loopThread_ = std::this_thread::get_id();
+    running_ = true;
+    logger_->log("Reactor: Running (" + std::to_string(handlers_.size()) + " descriptor(s))");
+
+    epoll_event events[32];
+    while (running_)
+    {
+        int count = ::epoll_wait(epollFd_, events, 32, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            logger_->logError("Reactor: epoll_wait failed - " + std::string(strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < count && running_; i++)
+        {
+            // A callback earlier in this batch may have removed the handler,
+            // and its fd number may already belong to a new registration
+            int fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFFu);
+            uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            std::shared_ptr<Handler> handler;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = handlers_.find(fd);
+                if (it == handlers_.end() || it->second->generation != generation)
+                    continue;
+                handler = it->second;
+            }
+            handler->callback(events[i].events);
+        }
+    }
+
+    running_ = false;
+    loopThread_ = std::thread::id();
+    logger_->log("Reactor: Stopped");
+}
+
+void Reactor::stop()
+{
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeFd_, &one, sizeof(one));
+    (void)written;
+}
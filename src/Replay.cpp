@@ -0,0 +1,166 @@
+#include "Replay.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <ctime>
+#include "Clock.h"
+#include "Logger.h"
+#include "MessageQueue.h"
+#include "MainControl.h"
+#include "SettingsCache.h"
+#include "StatusJournal.h"
+
+namespace
+{
+struct Frame
+{
+    std::chrono::system_clock::time_point wall;
+    uint8_t status;
+};
+
+const std::string FRAME_MARKER = "Received valid SystemStatus: 0x";
+
+// "YYYY-MM-DD HH:MM:SS.mmm - Received valid SystemStatus: 0xNN"
+bool parseFrame(const std::string &line, Frame &frame)
+{
+    size_t marker = line.find(FRAME_MARKER);
+    if (marker == std::string::npos || line.size() < 23 || line.size() < marker + FRAME_MARKER.size() + 2)
+        return false;
+
+    std::tm tm{};
+    std::istringstream ss(line.substr(0, 19));
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (ss.fail())
+        return false;
+    tm.tm_isdst = -1;
+
+    try
+    {
+        int ms = std::stoi(line.substr(20, 3));
+        frame.status = static_cast<uint8_t>(std::stoi(line.substr(marker + FRAME_MARKER.size(), 2), nullptr, 16));
+        frame.wall = std::chrono::system_clock::from_time_t(std::mktime(&tm)) + std::chrono::milliseconds(ms);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+}
+
+namespace Replay {
+
+int run(const std::string &logPath, const ConfigIni &config)
+{
+    std::vector<Frame> frames;
+    StatusJournalReader journal;
+    if (journal.open(logPath))
+    {
+        std::vector<StatusJournalReader::Entry> entries;
+        journal.read(entries);
+        frames.reserve(entries.size());
+        for (const auto &entry : entries)
+        {
+            frames.push_back(Frame{std::chrono::system_clock::time_point(std::chrono::milliseconds(entry.wallMs)),
+                                   entry.status});
+        }
+    }
+    else
+    {
+        std::ifstream in(logPath);
+        if (!in.is_open())
+        {
+            std::cerr << "replay: cannot open " << logPath << std::endl;
+            return 1;
+        }
+
+        std::string line;
+        Frame frame;
+        while (std::getline(in, line))
+        {
+            if (parseFrame(line, frame))
+                frames.push_back(frame);
+        }
+    }
+
+    if (frames.empty())
+    {
+        std::cerr << "replay: no SystemStatus frames in " << logPath << std::endl;
+        return 1;
+    }
+
+    auto clock = std::make_shared<SimulatedClock>(Timeline::fromWall(frames.front().wall));
+    auto logger = std::make_shared<Logger>(
+        config.getString("System", "LogDirectory", "~/PassFlow/Log") + "/replay", clock);
+    logger->log("=== Replay of " + logPath + " (" + std::to_string(frames.size()) + " frames) ===");
+
+    // Same settings the live system would start with: the settings cache,
+    // or config.ini when there is none
+    auto settings = std::make_shared<AppSettings>();
+    std::string stamp;
+    std::string cachePath = expandHomePath(config.getString("Database", "SettingsCache", "~/PassFlow/settings.cache"));
+    if (!SettingsCache::load(cachePath, *settings, stamp))
+    {
+        settings->doors = config.getInt("System", "Doors", 2);
+        settings->stopBeginDelay = config.getInt("System", "StopBeginDelay", 5);
+        settings->stopEndDelay = config.getInt("System", "StopEndDelay", 5);
+    }
+
+    auto queue = std::make_shared<MessageQueue<Message>>(clock);
+    MainControl control(logger, queue, nullptr, clock);
+    control.updateSettings(settings->stopBeginDelay, settings->stopEndDelay);
+    control.configureDoors(settings->doors, settings->statusBits);
+    control.setGlitchThreshold(std::chrono::milliseconds(config.getInt("System", "DoorGlitchMs", 300)));
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (const auto &f : frames)
+    {
+        clock->advanceTo(Timeline::fromWall(f.wall));
+        control.pollClips();
+        control.injectStatus(f.status);
+    }
+
+    // Let the last windows reach their stop time, then flush the rest
+    clock->advance(std::chrono::seconds(settings->stopEndDelay + 1));
+    control.pollClips();
+    control.pollClips(true);
+
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::map<int, int> clipsPerDoor;
+    Timeline::Clock::duration footage{};
+    while (auto msg = queue->tryPop(std::chrono::milliseconds(0)))
+    {
+        if (msg->type != MessageType::StartStop)
+            continue;
+        const auto &clip = std::get<StartStopMessage>(msg->data);
+        clipsPerDoor[clip.doorId]++;
+        footage += clip.stopTime - clip.startTime;
+    }
+
+    auto simulated = std::chrono::duration_cast<std::chrono::seconds>(
+        frames.back().wall - frames.front().wall);
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    const ClipCoalescer::Counters &counters = control.clipCounters();
+
+    std::cout << "frames: " << frames.size() << std::endl;
+    std::cout << "simulated: " << simulated.count() << " s ("
+              << formatTimestamp(frames.front().wall) << " .. " << formatTimestamp(frames.back().wall) << ")" << std::endl;
+    for (const auto &entry : clipsPerDoor)
+    {
+        std::cout << "door " << entry.first << ": " << entry.second << " clip(s)" << std::endl;
+    }
+    std::cout << "clip footage: " << std::chrono::duration_cast<std::chrono::seconds>(footage).count() << " s" << std::endl;
+    std::cout << "merged edges: " << counters.merged << ", suppressed glitches: " << counters.suppressed << std::endl;
+    std::cout << "elapsed: " << elapsedMs << " ms";
+    if (elapsedMs > 0)
+        std::cout << " (" << simulated.count() * 1000 / elapsedMs << "x real time)";
+    std::cout << std::endl;
+
+    logger->log("=== Replay finished in " + std::to_string(elapsedMs) + " ms ===");
+    return 0;
+}
+
+} // namespace Replay
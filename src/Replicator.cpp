@@ -0,0 +1,439 @@
+#include "Replicator.h"
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#ifdef PASSFLOW_HAVE_MARIADB
+#include "MariaDbBackend.h"
+
+namespace
+{
+const char *tableName(RecordTable table)
+{
+    return table == RecordTable::Events ? "events" : "video_segments";
+}
+
+// Created on each remote; one row per (bus, table)
+const char *STATE_SCHEMA =
+    "CREATE TABLE IF NOT EXISTS replication_state ("
+    "  source VARCHAR(64) NOT NULL,"
+    "  table_name VARCHAR(32) NOT NULL,"
+    "  last_id BIGINT NOT NULL,"
+    "  updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,"
+    "  PRIMARY KEY (source, table_name))";
+}
+#endif
+
+struct Replicator::Remote
+{
+    std::string address;   // As listed in remoteDB: host[:port][/database]
+    std::string host;
+    unsigned int port = 0;
+    std::string database;
+#ifdef PASSFLOW_HAVE_MARIADB
+    MYSQL *connection = nullptr;
+#endif
+    bool marksLoaded = false;   // Read from the remote on this connection
+    bool marksKnown = false;    // Read at least once
+    int64_t marks[2] = {0, 0};  // Indexed by RecordTable
+    bool behind = false;
+    std::chrono::steady_clock::time_point behindSince;
+    RemoteStatus status;
+
+    void close()
+    {
+#ifdef PASSFLOW_HAVE_MARIADB
+        if (connection != nullptr)
+        {
+            mysql_close(connection);
+            connection = nullptr;
+        }
+#endif
+        marksLoaded = false;  // The last commit may or may not have landed
+        status.connected = false;
+    }
+
+    ~Remote() { close(); }
+};
+
+Replicator::Replicator(std::shared_ptr<Logger> logger, StorageBackend &local)
+    : logger_(logger), local_(local), user_("bus"), password_("njkmrjbus"), database_("busLocal"),
+      port_(3306), batchSize_(DEFAULT_BATCH_SIZE), interval_(30), addressesChanged_(false),
+      running_(false), stopRequested_(false)
+{
+    char hostname[256] = {0};
+    source_ = gethostname(hostname, sizeof(hostname) - 1) == 0 ? hostname : "passflow";
+}
+
+Replicator::~Replicator()
+{
+    stop();
+}
+
+void Replicator::configure(const ConfigIni &config)
+{
+    source_ = config.getString("Replication", "Source", source_);
+    user_ = config.getString("Replication", "User", config.getString("Database", "User", user_));
+    password_ = config.getString("Replication", "Password", config.getString("Database", "Password", password_));
+    database_ = config.getString("Replication", "Name", config.getString("Database", "Name", database_));
+    port_ = static_cast<unsigned int>(config.getInt("Replication", "Port", static_cast<int>(port_)));
+    batchSize_ = static_cast<size_t>(std::max(1, config.getInt("Replication", "BatchSize",
+                                                               static_cast<int>(batchSize_))));
+    interval_ = std::chrono::seconds(std::max(1, config.getInt("Replication", "IntervalSeconds",
+                                                               static_cast<int>(interval_.count()))));
+}
+
+void Replicator::setRemotes(const std::vector<std::string> &addresses)
+{
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    if (addresses != addresses_)
+    {
+        addresses_ = addresses;
+        addressesChanged_ = true;
+    }
+}
+
+void Replicator::applyAddresses()
+{
+    // Caller holds syncMutex_
+    std::vector<std::string> addresses;
+    {
+        std::lock_guard<std::mutex> lock(statusMutex_);
+        if (!addressesChanged_)
+            return;
+        addresses = addresses_;
+        addressesChanged_ = false;
+    }
+
+    // Keep connections and marks of remotes that are still listed
+    std::vector<std::unique_ptr<Remote>> remotes;
+    for (const auto &address : addresses)
+    {
+        auto existing = std::find_if(remotes_.begin(), remotes_.end(),
+                                     [&](const std::unique_ptr<Remote> &r) { return r && r->address == address; });
+        if (existing != remotes_.end())
+        {
+            remotes.push_back(std::move(*existing));
+            continue;
+        }
+
+        auto remote = std::make_unique<Remote>();
+        remote->address = address;
+        remote->status.address = address;
+        remote->port = port_;
+        remote->database = database_;
+
+        std::string hostPort = address;
+        size_t slash = hostPort.find('/');
+        if (slash != std::string::npos)
+        {
+            remote->database = hostPort.substr(slash + 1);
+            hostPort.resize(slash);
+        }
+        size_t colon = hostPort.rfind(':');
+        if (colon != std::string::npos)
+        {
+            remote->port = static_cast<unsigned int>(std::atoi(hostPort.c_str() + colon + 1));
+            hostPort.resize(colon);
+        }
+        remote->host = hostPort;
+        remotes.push_back(std::move(remote));
+    }
+    remotes_.swap(remotes);
+
+    logger_->log("Replicator: " + std::to_string(remotes_.size()) + " remote(s), source '" + source_ + "'");
+}
+
+bool Replicator::connectRemote(Remote &remote)
+{
+#ifdef PASSFLOW_HAVE_MARIADB
+    MYSQL *connection = mysql_init(nullptr);
+    if (connection == nullptr)
+    {
+        remote.status.lastError = "mysql_init() failed";
+        return false;
+    }
+
+    // Short timeouts: the depot is often out of reach; compression pays
+    // off on cellular links and large batches
+    unsigned int connectTimeout = 3;
+    unsigned int ioTimeout = 15;
+    mysql_options(connection, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeout);
+    mysql_options(connection, MYSQL_OPT_READ_TIMEOUT, &ioTimeout);
+    mysql_options(connection, MYSQL_OPT_WRITE_TIMEOUT, &ioTimeout);
+    mysql_options(connection, MYSQL_OPT_COMPRESS, nullptr);
+
+    if (mysql_real_connect(connection, remote.host.c_str(), user_.c_str(), password_.c_str(),
+                           remote.database.c_str(), remote.port, nullptr, 0) == nullptr)
+    {
+        remote.status.lastError = mysql_error(connection);
+        mysql_close(connection);
+        return false;
+    }
+    mysql_set_character_set(connection, "utf8mb4");
+    remote.connection = connection;
+    remote.status.connected = true;
+
+    if (mysql_query(connection, STATE_SCHEMA) != 0)
+    {
+        remote.status.lastError = mysql_error(connection);
+        remote.close();
+        return false;
+    }
+
+    // The remote's marks are authoritative: they commit with the rows
+    std::string source(source_.size() * 2 + 1, '\0');
+    source.resize(mysql_real_escape_string(connection, &source[0], source_.c_str(), source_.size()));
+    std::string query = "SELECT table_name, last_id FROM replication_state WHERE source = '" + source + "'";
+    if (mysql_query(connection, query.c_str()) != 0)
+    {
+        remote.status.lastError = mysql_error(connection);
+        remote.close();
+        return false;
+    }
+
+    MYSQL_RES *result = mysql_store_result(connection);
+    remote.marks[0] = remote.marks[1] = 0;
+    MYSQL_ROW row;
+    while (result && (row = mysql_fetch_row(result)) != nullptr)
+    {
+        if (row[0] && row[1])
+        {
+            int index = std::string(row[0]) == tableName(RecordTable::Events) ? 0 : 1;
+            remote.marks[index] = std::stoll(row[1]);
+        }
+    }
+    mysql_free_result(result);
+    remote.marksLoaded = true;
+    remote.marksKnown = true;
+
+    logger_->log("Replicator: Connected to " + remote.address + " (events after " +
+                 std::to_string(remote.marks[0]) + ", segments after " + std::to_string(remote.marks[1]) + ")");
+    return true;
+#else
+    remote.status.lastError = "built without the MariaDB client library";
+    return false;
+#endif
+}
+
+bool Replicator::pushBatch(Remote &remote, RecordTable table, const std::vector<StoredRecord> &rows)
+{
+#ifdef PASSFLOW_HAVE_MARIADB
+    MYSQL *connection = remote.connection;
+    auto escape = [connection](const std::string &value)
+    {
+        std::string escaped(value.size() * 2 + 1, '\0');
+        escaped.resize(mysql_real_escape_string(connection, &escaped[0], value.c_str(), value.size()));
+        return escaped;
+    };
+
+    // One multi-row INSERT plus the new mark, committed together
+    std::ostringstream insert;
+    if (table == RecordTable::Events)
+    {
+        insert << "INSERT INTO events (event_type, event_description, event_time) VALUES ";
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            const auto &event = std::get<EventRecord>(rows[i].record);
+            insert << (i ? ",(" : "(") << event.type << ",'" << escape(event.description) << "','"
+                   << escape(event.time) << "')";
+        }
+    }
+    else
+    {
+        insert << "INSERT INTO video_segments (camera_id, start_time, stop_time, filename) VALUES ";
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            const auto &segment = std::get<VideoSegmentRecord>(rows[i].record);
+            insert << (i ? ",(" : "(") << segment.cameraId << ",'" << escape(segment.startTime) << "','"
+                   << escape(segment.stopTime) << "','" << escape(segment.filename) << "')";
+        }
+    }
+
+    std::string mark = "INSERT INTO replication_state (source, table_name, last_id) VALUES ('" +
+                       escape(source_) + "','" + tableName(table) + "'," +
+                       std::to_string(rows.back().id) +
+                       ") ON DUPLICATE KEY UPDATE last_id = VALUES(last_id)";
+
+    if (mysql_query(connection, "START TRANSACTION") != 0 ||
+        mysql_query(connection, insert.str().c_str()) != 0 ||
+        mysql_query(connection, mark.c_str()) != 0 ||
+        mysql_query(connection, "COMMIT") != 0)
+    {
+        remote.status.lastError = mysql_error(connection);
+        mysql_query(connection, "ROLLBACK");
+        remote.close();
+        return false;
+    }
+    return true;
+#else
+    (void)remote;
+    (void)table;
+    (void)rows;
+    return false;
+#endif
+}
+
+bool Replicator::syncRemote(Remote &remote)
+{
+    if (!remote.marksLoaded)
+    {
+        remote.close();
+        if (!connectRemote(remote))
+            return false;
+    }
+
+    const RecordTable tables[] = {RecordTable::Events, RecordTable::VideoSegments};
+    size_t pushed[2] = {0, 0};
+    std::vector<StoredRecord> rows;
+    rows.reserve(batchSize_);
+
+    for (int i = 0; i < 2; i++)
+    {
+        while (!stopRequested_)
+        {
+            if (!local_.readSince(tables[i], remote.marks[i], batchSize_, rows))
+            {
+                remote.status.lastError = "local read failed";
+                return false;
+            }
+            if (rows.empty())
+                break;
+
+            if (!pushBatch(remote, tables[i], rows))
+            {
+                return false;
+            }
+            remote.marks[i] = rows.back().id;
+            pushed[i] += rows.size();
+            remote.status.rowsPushed += rows.size();
+
+            if (rows.size() < batchSize_)
+                break;
+        }
+    }
+
+    if (pushed[0] || pushed[1])
+    {
+        logger_->log("Replicator: " + remote.address + " +" + std::to_string(pushed[0]) + " events, +" +
+                     std::to_string(pushed[1]) + " segments");
+    }
+    remote.status.lastError.clear();
+    return !stopRequested_;
+}
+
+void Replicator::updateLag(Remote &remote)
+{
+    remote.status.eventsMark = remote.marks[0];
+    remote.status.segmentsMark = remote.marks[1];
+
+    int64_t lastEvent = 0;
+    int64_t lastSegment = 0;
+    if (!remote.marksKnown)
+    {
+        return;  // Never reached
+    }
+    if (!local_.lastId(RecordTable::Events, lastEvent) || !local_.lastId(RecordTable::VideoSegments, lastSegment))
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    remote.status.rowsBehind = std::max<int64_t>(0, lastEvent - remote.marks[0]) +
+                               std::max<int64_t>(0, lastSegment - remote.marks[1]);
+    if (remote.status.rowsBehind == 0)
+    {
+        remote.behind = false;
+    }
+    else if (!remote.behind)
+    {
+        remote.behind = true;
+        remote.behindSince = now;
+    }
+    remote.status.lagSeconds = remote.behind
+                                   ? std::chrono::duration_cast<std::chrono::seconds>(now - remote.behindSince).count()
+                                   : 0;
+}
+
+bool Replicator::syncOnce()
+{
+    std::lock_guard<std::mutex> lock(syncMutex_);
+    applyAddresses();
+
+    bool caughtUp = true;
+    for (auto &remote : remotes_)
+    {
+        std::string previousError = remote->status.lastError;
+        if (!syncRemote(*remote) && remote->status.lastError != previousError)
+        {
+            // Log each distinct failure once, not on every pass
+            logger_->logError("Replicator: " + remote->address + " - " + remote->status.lastError);
+        }
+        updateLag(*remote);
+        caughtUp = caughtUp && remote->status.rowsBehind == 0;
+    }
+
+    publishStatus();
+    return caughtUp;
+}
+
+void Replicator::publishStatus()
+{
+    std::vector<RemoteStatus> status;
+    for (const auto &remote : remotes_)
+    {
+        status.push_back(remote->status);
+    }
+
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    status_.swap(status);
+}
+
+std::vector<Replicator::RemoteStatus> Replicator::status() const
+{
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    return status_;
+}
+
+void Replicator::start()
+{
+    std::lock_guard<std::mutex> lock(threadMutex_);
+    if (running_)
+        return;
+
+    running_ = true;
+    stopRequested_ = false;
+    thread_ = std::thread(&Replicator::threadLoop, this);
+    logger_->log("Replicator: Started (every " + std::to_string(interval_.count()) + " s, batches of " +
+                 std::to_string(batchSize_) + ")");
+}
+
+void Replicator::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(threadMutex_);
+        if (!running_)
+            return;
+        running_ = false;
+        stopRequested_ = true;
+    }
+    threadCv_.notify_all();
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    logger_->log("Replicator: Stopped");
+}
+
+void Replicator::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    while (running_)
+    {
+        lock.unlock();
+        syncOnce();
+        lock.lock();
+
+        threadCv_.wait_for(lock, interval_, [this] { return !running_; });
+    }
+}
@@ -0,0 +1,227 @@
+#include "SettingsCache.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+const char MAGIC[4] = {'P', 'F', 'S', 'C'};
+const size_t HEADER_SIZE = 16;
+
+class Writer
+{
+public:
+    std::vector<uint8_t> data;
+
+    void u8(uint8_t v) { data.push_back(v); }
+
+    void u16(uint16_t v)
+    {
+        u8(v & 0xFF);
+        u8(v >> 8);
+    }
+
+    void u32(uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            u8((v >> (8 * i)) & 0xFF);
+    }
+
+    void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+
+    void str(const std::string &s)
+    {
+        u32(static_cast<uint32_t>(s.size()));
+        data.insert(data.end(), s.begin(), s.end());
+    }
+};
+
+class Reader
+{
+public:
+    Reader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return ok_; }
+
+    uint8_t u8()
+    {
+        if (pos_ + 1 > size_)
+        {
+            ok_ = false;
+            return 0;
+        }
+        return data_[pos_++];
+    }
+
+    uint32_t u32()
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+            v |= static_cast<uint32_t>(u8()) << (8 * i);
+        return v;
+    }
+
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+
+    std::string str()
+    {
+        uint32_t len = u32();
+        if (!ok_ || pos_ + len > size_)
+        {
+            ok_ = false;
+            return "";
+        }
+        std::string s(reinterpret_cast<const char *>(data_ + pos_), len);
+        pos_ += len;
+        return s;
+    }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+}
+
+bool SettingsCache::save(const std::string &path, const AppSettings &settings,
+                         const std::string &stamp)
+{
+    Writer payload;
+    payload.str(stamp);
+    payload.i32(settings.doors);
+    payload.i32(settings.stopBeginDelay);
+    payload.i32(settings.stopEndDelay);
+    payload.i32(settings.daysBeforeDeleteVideo);
+    payload.str(settings.cam0String);
+    payload.str(settings.cam1String);
+
+    payload.u32(static_cast<uint32_t>(settings.cameras.size()));
+    for (const auto &cam : settings.cameras)
+    {
+        payload.i32(cam.id);
+        payload.i32(cam.doorId);
+        payload.u8(cam.enabled ? 1 : 0);
+        payload.str(cam.rtspUrl);
+    }
+
+    for (const auto &role : settings.statusBits)
+    {
+        payload.u8(static_cast<uint8_t>(role.kind));
+        payload.u8(role.index);
+    }
+
+    payload.u32(static_cast<uint32_t>(settings.remoteDBAddresses.size()));
+    for (const auto &address : settings.remoteDBAddresses)
+    {
+        payload.str(address);
+    }
+
+    Writer file;
+    file.data.insert(file.data.end(), MAGIC, MAGIC + 4);
+    file.u16(FORMAT_VERSION);
+    file.u16(0);
+    file.u32(static_cast<uint32_t>(payload.data.size()));
+    file.u32(crc32(payload.data.data(), payload.data.size()));
+    file.data.insert(file.data.end(), payload.data.begin(), payload.data.end());
+
+    // Write to a temporary file and rename so a power cut never leaves a
+    // half-written cache behind
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < file.data.size())
+    {
+        ssize_t n = write(fd, file.data.data() + written, file.data.size() - written);
+        if (n <= 0)
+        {
+            close(fd);
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    fsync(fd);
+    close(fd);
+
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool SettingsCache::load(const std::string &path, AppSettings &settings, std::string &stamp)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    if (data.size() < HEADER_SIZE || memcmp(data.data(), MAGIC, 4) != 0)
+    {
+        return false;
+    }
+
+    Reader header(data.data() + 4, HEADER_SIZE - 4);
+    uint16_t version = header.u8() | (header.u8() << 8);
+    header.u8();
+    header.u8();
+    uint32_t payloadSize = header.u32();
+    uint32_t payloadCrc = header.u32();
+
+    if (version != FORMAT_VERSION || data.size() != HEADER_SIZE + payloadSize ||
+        crc32(data.data() + HEADER_SIZE, payloadSize) != payloadCrc)
+    {
+        return false;
+    }
+
+    Reader in(data.data() + HEADER_SIZE, payloadSize);
+    AppSettings loaded;
+    stamp = in.str();
+    loaded.doors = in.i32();
+    loaded.stopBeginDelay = in.i32();
+    loaded.stopEndDelay = in.i32();
+    loaded.daysBeforeDeleteVideo = in.i32();
+    loaded.cam0String = in.str();
+    loaded.cam1String = in.str();
+
+    uint32_t cameraCount = in.u32();
+    for (uint32_t i = 0; i < cameraCount && in.ok(); i++)
+    {
+        CameraSettings cam;
+        cam.id = in.i32();
+        cam.doorId = in.i32();
+        cam.enabled = in.u8() != 0;
+        cam.rtspUrl = in.str();
+        loaded.cameras.push_back(cam);
+    }
+
+    for (auto &role : loaded.statusBits)
+    {
+        role.kind = static_cast<StatusBitKind>(in.u8());
+        role.index = in.u8();
+    }
+
+    uint32_t remoteCount = in.u32();
+    for (uint32_t i = 0; i < remoteCount && in.ok(); i++)
+    {
+        loaded.remoteDBAddresses.push_back(in.str());
+    }
+
+    if (!in.ok())
+    {
+        return false;
+    }
+
+    settings = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "ShutdownCoordinator.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <map>
+
+namespace
+{
+// Shared with task threads so abandoned (detached) tasks stay valid
+struct LevelState
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t running = 0;
+    std::map<std::string, bool> results;
+};
+}
+
+ShutdownCoordinator::ShutdownCoordinator(std::shared_ptr<Logger> logger)
+    : logger_(logger)
+{
+}
+
+void ShutdownCoordinator::add(const std::string &name, int priority, Task task)
+{
+    entries_.push_back({name, priority, std::move(task)});
+}
+
+std::vector<std::string> ShutdownCoordinator::run(std::chrono::milliseconds budget)
+{
+    auto begin = std::chrono::steady_clock::now();
+    auto deadline = begin + budget;
+    std::vector<std::string> unfinished;
+
+    std::stable_sort(entries_.begin(), entries_.end(),
+                     [](const Entry &a, const Entry &b)
+                     { return a.priority < b.priority; });
+
+    size_t i = 0;
+    while (i < entries_.size())
+    {
+        int priority = entries_[i].priority;
+        size_t end = i;
+        while (end < entries_.size() && entries_[end].priority == priority)
+            end++;
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            for (; i < end; i++)
+                unfinished.push_back(entries_[i].name + " (not started)");
+            continue;
+        }
+
+        auto state = std::make_shared<LevelState>();
+        state->running = end - i;
+
+        for (size_t k = i; k < end; k++)
+        {
+            std::thread([state, entry = entries_[k], deadline, logger = logger_]()
+                        {
+                            bool ok = false;
+                            try
+                            {
+                                ok = entry.task(deadline);
+                            }
+                            catch (const std::exception &e)
+                            {
+                                logger->logError("Shutdown task " + entry.name + " threw: " + e.what());
+                            }
+
+                            std::lock_guard<std::mutex> lock(state->mutex);
+                            state->results[entry.name] = ok;
+                            state->running--;
+                            state->cv.notify_all();
+                        })
+                .detach();
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait_until(lock, deadline, [&state]
+                             { return state->running == 0; });
+
+        for (size_t k = i; k < end; k++)
+        {
+            auto it = state->results.find(entries_[k].name);
+            if (it == state->results.end())
+                unfinished.push_back(entries_[k].name + " (timed out)");
+            else if (!it->second)
+                unfinished.push_back(entries_[k].name + " (incomplete)");
+        }
+
+        i = end;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+    logger_->log("Shutdown finished in " + std::to_string(elapsed) + " ms (budget " +
+                 std::to_string(budget.count()) + " ms)");
+    for (const auto &name : unfinished)
+    {
+        logger_->logError("Shutdown: " + name);
+    }
+
+    return unfinished;
+}
@@ -0,0 +1,415 @@
+#include "StatusJournal.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+const char FILE_MAGIC[4] = {'P', 'F', 'S', 'J'};
+constexpr uint32_t FILE_VERSION = 1;
+constexpr size_t FILE_HEADER = 16;
+constexpr uint32_t CHUNK_MARKER = 0x4b4e4843; // "CHNK"
+constexpr size_t CHUNK_HEADER = 32;
+constexpr size_t MAX_ENTRY = 11;               // Status byte + 10-byte varint
+
+struct ChunkHeader
+{
+    uint32_t marker;
+    uint32_t count;  // 0 while the chunk is open
+    uint32_t bytes;
+    int64_t firstMs;
+    int64_t lastMs;
+};
+
+void put32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void put64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t get32(const uint8_t *p)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return value;
+}
+
+uint64_t get64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+void encodeHeader(const ChunkHeader &header, uint8_t *out)
+{
+    std::memset(out, 0, CHUNK_HEADER);
+    put32(out, header.marker);
+    put32(out + 4, header.count);
+    put32(out + 8, header.bytes);
+    put64(out + 16, static_cast<uint64_t>(header.firstMs));
+    put64(out + 24, static_cast<uint64_t>(header.lastMs));
+}
+
+ChunkHeader decodeHeader(const uint8_t *p)
+{
+    ChunkHeader header;
+    header.marker = get32(p);
+    header.count = get32(p + 4);
+    header.bytes = get32(p + 8);
+    header.firstMs = static_cast<int64_t>(get64(p + 16));
+    header.lastMs = static_cast<int64_t>(get64(p + 24));
+    return header;
+}
+
+size_t encodeEntry(uint8_t status, uint64_t deltaMs, uint8_t *out)
+{
+    size_t n = 0;
+    out[n++] = status;
+    while (deltaMs >= 0x80)
+    {
+        out[n++] = static_cast<uint8_t>(deltaMs | 0x80);
+        deltaMs >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(deltaMs);
+    return n;
+}
+
+// Decode up to maxCount entries from a chunk payload, calling fn(wallMs,
+// status) for each. Stops before a torn trailing entry; returns the bytes
+// of the complete entries and their number in count
+template <typename Fn>
+size_t decodeEntries(const uint8_t *p, size_t size, int64_t baseMs, uint32_t maxCount, uint32_t &count, Fn &&fn)
+{
+    size_t pos = 0;
+    int64_t ms = baseMs;
+    count = 0;
+    while (count < maxCount && pos < size)
+    {
+        size_t i = pos + 1;
+        uint64_t delta = 0;
+        int shift = 0;
+        bool complete = false;
+        while (i < size && shift < 64)
+        {
+            uint8_t byte = p[i++];
+            delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                complete = true;
+                break;
+            }
+            shift += 7;
+        }
+        if (!complete)
+            break;
+
+        ms += static_cast<int64_t>(delta);
+        fn(ms, p[pos]);
+        count++;
+        pos = i;
+    }
+    return pos;
+}
+}
+
+StatusJournal::StatusJournal(std::shared_ptr<Logger> logger)
+    : logger_(logger), fd_(-1), chunkOffset_(0), chunkCount_(0), chunkBytes_(0), chunkBaseMs_(0), lastMs_(0)
+{
+}
+
+StatusJournal::~StatusJournal()
+{
+    close();
+}
+
+bool StatusJournal::open(const std::string &path)
+{
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (fd_ < 0 || ::fstat(fd_, &st) != 0)
+    {
+        logger_->logError("StatusJournal: Cannot open " + path + " - " + strerror(errno));
+        close();
+        return false;
+    }
+    path_ = path;
+
+    if (st.st_size == 0)
+    {
+        uint8_t header[FILE_HEADER] = {};
+        std::memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+        put32(header + 4, FILE_VERSION);
+        if (::write(fd_, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)))
+        {
+            logger_->logError("StatusJournal: Cannot write " + path + " - " + strerror(errno));
+            close();
+            return false;
+        }
+    }
+    else if (!repair(static_cast<uint64_t>(st.st_size)))
+    {
+        logger_->logError("StatusJournal: " + path + " is not a status journal");
+        close();
+        return false;
+    }
+
+    off_t end = ::lseek(fd_, 0, SEEK_END);
+    logger_->log("StatusJournal: Appending to " + path + " (" + std::to_string(end) + " bytes)");
+    return true;
+}
+
+bool StatusJournal::repair(uint64_t fileSize)
+{
+    uint8_t fileHeader[FILE_HEADER];
+    if (fileSize < FILE_HEADER ||
+        ::pread(fd_, fileHeader, sizeof(fileHeader), 0) != static_cast<ssize_t>(sizeof(fileHeader)) ||
+        std::memcmp(fileHeader, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || get32(fileHeader + 4) != FILE_VERSION)
+    {
+        return false;
+    }
+
+    // Walk the chunk headers, skipping closed payloads; everything after
+    // the last intact chunk is a torn write and is cut off
+    uint64_t offset = FILE_HEADER;
+    while (offset + CHUNK_HEADER <= fileSize)
+    {
+        uint8_t raw[CHUNK_HEADER];
+        if (::pread(fd_, raw, sizeof(raw), static_cast<off_t>(offset)) != static_cast<ssize_t>(sizeof(raw)))
+            return false;
+        ChunkHeader header = decodeHeader(raw);
+        uint64_t payload = offset + CHUNK_HEADER;
+        if (header.marker != CHUNK_MARKER)
+            break;
+
+        if (header.count != 0)
+        {
+            if (payload + header.bytes > fileSize)
+                break;
+            offset = payload + header.bytes;
+            continue;
+        }
+
+        // Left open by a crash: close it over its complete entries. Only
+        // this payload is read, and it never holds more than a full chunk
+        std::vector<uint8_t> data(std::min<uint64_t>(fileSize - payload, uint64_t(CHUNK_ENTRIES) * MAX_ENTRY));
+        if (!data.empty() &&
+            ::pread(fd_, data.data(), data.size(), static_cast<off_t>(payload)) != static_cast<ssize_t>(data.size()))
+            return false;
+        uint32_t count;
+        int64_t lastMs = header.firstMs;
+        size_t bytes = decodeEntries(data.data(), data.size(), header.firstMs, CHUNK_ENTRIES, count,
+                                     [&lastMs](int64_t ms, uint8_t) { lastMs = ms; });
+        if (count > 0)
+        {
+            header.count = count;
+            header.bytes = static_cast<uint32_t>(bytes);
+            header.lastMs = lastMs;
+            uint8_t out[CHUNK_HEADER];
+            encodeHeader(header, out);
+            if (::pwrite(fd_, out, sizeof(out), static_cast<off_t>(offset)) != static_cast<ssize_t>(sizeof(out)))
+                return false;
+            offset = payload + bytes;
+            logger_->log("StatusJournal: Closed chunk left open in " + path_ + " (" + std::to_string(count) +
+                         " entries)");
+        }
+        break;
+    }
+
+    if (offset < fileSize)
+    {
+        logger_->log("StatusJournal: Dropping " + std::to_string(fileSize - offset) + " torn byte(s) from " + path_);
+        if (::ftruncate(fd_, static_cast<off_t>(offset)) != 0)
+            return false;
+    }
+    return true;
+}
+
+void StatusJournal::close()
+{
+    if (fd_ < 0)
+        return;
+
+    closeChunk();
+    ::fdatasync(fd_);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void StatusJournal::startChunk(int64_t wallMs)
+{
+    off_t offset = ::lseek(fd_, 0, SEEK_END);
+    uint8_t header[CHUNK_HEADER];
+    encodeHeader(ChunkHeader{CHUNK_MARKER, 0, 0, wallMs, wallMs}, header);
+    if (offset < 0 || ::write(fd_, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)))
+    {
+        logger_->logError("StatusJournal: Cannot write " + path_ + " - " + strerror(errno));
+        return;
+    }
+
+    chunkOffset_ = static_cast<uint64_t>(offset);
+    chunkCount_ = 0;
+    chunkBytes_ = 0;
+    chunkBaseMs_ = wallMs;
+    lastMs_ = wallMs;
+}
+
+void StatusJournal::closeChunk()
+{
+    if (chunkOffset_ == 0)
+        return;
+
+    uint8_t header[CHUNK_HEADER];
+    encodeHeader(ChunkHeader{CHUNK_MARKER, chunkCount_, chunkBytes_, chunkBaseMs_, lastMs_}, header);
+    if (chunkCount_ == 0)
+    {
+        // Nothing was appended after the header
+        if (::ftruncate(fd_, static_cast<off_t>(chunkOffset_)) != 0)
+            logger_->logError("StatusJournal: Cannot truncate " + path_);
+    }
+    else if (::pwrite(fd_, header, sizeof(header), static_cast<off_t>(chunkOffset_)) != static_cast<ssize_t>(sizeof(header)))
+    {
+        logger_->logError("StatusJournal: Cannot close chunk in " + path_ + " - " + strerror(errno));
+    }
+    chunkOffset_ = 0;
+}
+
+void StatusJournal::append(int64_t wallMs, uint8_t status)
+{
+    if (fd_ < 0)
+        return;
+
+    // Deltas are unsigned: a backwards clock step starts a new chunk
+    if (chunkOffset_ == 0 || chunkCount_ >= CHUNK_ENTRIES || wallMs < lastMs_)
+    {
+        closeChunk();
+        startChunk(wallMs);
+        if (chunkOffset_ == 0)
+            return;
+    }
+
+    uint8_t entry[MAX_ENTRY];
+    size_t n = encodeEntry(status, static_cast<uint64_t>(wallMs - lastMs_), entry);
+    if (::write(fd_, entry, n) != static_cast<ssize_t>(n))
+    {
+        logger_->logError("StatusJournal: Cannot append to " + path_ + " - " + strerror(errno));
+        return;
+    }
+
+    chunkCount_++;
+    chunkBytes_ += static_cast<uint32_t>(n);
+    lastMs_ = wallMs;
+}
+
+StatusJournalReader::~StatusJournalReader()
+{
+    if (data_)
+        ::munmap(const_cast<uint8_t *>(data_), size_);
+}
+
+bool StatusJournalReader::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+    {
+        error_ = "cannot open: " + std::string(strerror(errno));
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    void *address = size_ > 0 ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        error_ = size_ > 0 ? "cannot map: " + std::string(strerror(errno)) : "empty file";
+        size_ = 0;
+        return false;
+    }
+    data_ = static_cast<const uint8_t *>(address);
+
+    if (size_ < FILE_HEADER || std::memcmp(data_, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+    {
+        error_ = "not a status journal";
+        return false;
+    }
+    if (get32(data_ + 4) != FILE_VERSION)
+    {
+        error_ = "unsupported journal version " + std::to_string(get32(data_ + 4));
+        return false;
+    }
+
+    uint64_t offset = FILE_HEADER;
+    while (offset + CHUNK_HEADER <= size_)
+    {
+        ChunkHeader header = decodeHeader(data_ + offset);
+        uint64_t payload = offset + CHUNK_HEADER;
+        if (header.marker != CHUNK_MARKER)
+            break;
+
+        Chunk chunk{payload, header.count, header.bytes, header.firstMs, header.lastMs, header.count == 0};
+        if (chunk.open)
+        {
+            // Being written: runs to the end of the file
+            int64_t lastMs = header.firstMs;
+            chunk.bytes = static_cast<uint32_t>(
+                decodeEntries(data_ + payload, size_ - payload, header.firstMs,
+                              std::numeric_limits<uint32_t>::max(), chunk.count,
+                              [&lastMs](int64_t ms, uint8_t) { lastMs = ms; }));
+            chunk.lastMs = lastMs;
+        }
+        else if (payload + header.bytes > size_)
+        {
+            break;
+        }
+
+        chunks_.push_back(chunk);
+        if (chunk.open)
+            break;
+        offset = payload + header.bytes;
+    }
+    return true;
+}
+
+uint64_t StatusJournalReader::entryCount() const
+{
+    uint64_t count = 0;
+    for (const auto &chunk : chunks_)
+        count += chunk.count;
+    return count;
+}
+
+size_t StatusJournalReader::read(std::vector<Entry> &out, int64_t fromMs, int64_t toMs) const
+{
+    size_t before = out.size();
+    for (const auto &chunk : chunks_)
+    {
+        if (chunk.lastMs < fromMs || chunk.firstMs >= toMs)
+            continue;
+
+        uint32_t count;
+        decodeEntries(data_ + chunk.offset, chunk.bytes, chunk.firstMs, chunk.count, count,
+                      [&out, fromMs, toMs](int64_t ms, uint8_t status)
+                      {
+                          if (ms >= fromMs && ms < toMs)
+                              out.push_back(Entry{ms, status});
+                      });
+    }
+    return out.size() - before;
+}
@@ -0,0 +1,84 @@
+#include "StatusShm.h"
+#include <cerrno>
+
+StatusShmWriter::StatusShmWriter(std::shared_ptr<Logger> logger)
+    : logger_(logger), segment_(nullptr)
+{
+}
+
+StatusShmWriter::~StatusShmWriter()
+{
+    close();
+}
+
+bool StatusShmWriter::open(const std::string &name)
+{
+    close();
+
+    // World-readable: the display and diagnostics run as other users
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        logger_->logError("StatusShm: Cannot open " + name + " - " + strerror(errno));
+        return false;
+    }
+
+    void *address = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(StatusShmSegment)) == 0)
+    {
+        address = ::mmap(nullptr, sizeof(StatusShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        logger_->logError("StatusShm: Cannot map " + name + " - " + strerror(error));
+        return false;
+    }
+
+    // Readers attached to a previous run keep their mapping, so continue
+    // its sequence (made even again if that writer died mid-update)
+    segment_ = static_cast<StatusShmSegment *>(address);
+    uint32_t sequence = segment_->sequence.load(std::memory_order_relaxed);
+    if (segment_->magic != StatusShmSegment::MAGIC || segment_->version != StatusShmSegment::VERSION)
+    {
+        sequence = 0;
+    }
+    segment_->sequence.store((sequence + 1) & ~1u, std::memory_order_release);
+    segment_->magic = StatusShmSegment::MAGIC;
+    segment_->version = StatusShmSegment::VERSION;
+    segment_->size = sizeof(StatusShmSegment);
+
+    name_ = name;
+    logger_->log("StatusShm: Publishing live status in /dev/shm" + name + " (" +
+                 std::to_string(sizeof(StatusShmSegment)) + " bytes)");
+    return true;
+}
+
+void StatusShmWriter::close()
+{
+    if (!segment_)
+        return;
+
+    StatusShmData data = segment_->data;
+    data.running = 0;
+    data.linkUp = 0;
+    publish(data);
+
+    ::munmap(segment_, sizeof(StatusShmSegment));
+    segment_ = nullptr;
+}
+
+void StatusShmWriter::publish(const StatusShmData &data)
+{
+    if (!segment_)
+        return;
+
+    // Seqlock: odd while the data is inconsistent; readers retry on a
+    // change. The release fence keeps the data stores after the odd store
+    uint32_t sequence = segment_->sequence.load(std::memory_order_relaxed);
+    segment_->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&segment_->data, &data, sizeof(data));
+    segment_->sequence.store(sequence + 2, std::memory_order_release);
+}
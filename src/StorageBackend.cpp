@@ -0,0 +1,80 @@
+#include "StorageBackend.h"
+#include "Logger.h"
+#include "ConfigIni.h"
+#include <algorithm>
+#ifdef PASSFLOW_HAVE_MARIADB
+#include "MariaDbBackend.h"
+#endif
+#ifdef PASSFLOW_HAVE_SQLITE
+#include "SqliteBackend.h"
+#endif
+
+bool parseStatusBitRole(int bit, const std::string &role, int idx, StatusBitRole &entry)
+{
+    if (bit < 0 || bit > 7 || idx < 0 || idx >= MAX_DOORS)
+    {
+        return false;
+    }
+
+    entry.index = static_cast<uint8_t>(idx);
+    if (role == "door")
+        entry.kind = StatusBitKind::Door;
+    else if (role == "cover")
+        entry.kind = StatusBitKind::Cover;
+    else if (role == "mainSupply")
+        entry.kind = StatusBitKind::MainSupply;
+    else if (role == "ignition")
+        entry.kind = StatusBitKind::Ignition;
+    else
+        entry.kind = StatusBitKind::Unused;
+    return true;
+}
+
+std::vector<std::string> StorageBackend::available()
+{
+    std::vector<std::string> names;
+#ifdef PASSFLOW_HAVE_MARIADB
+    names.push_back("mariadb");
+#endif
+#ifdef PASSFLOW_HAVE_SQLITE
+    names.push_back("sqlite");
+#endif
+    return names;
+}
+
+std::unique_ptr<StorageBackend> StorageBackend::create(const ConfigIni &config,
+                                                       std::shared_ptr<Logger> logger)
+{
+    std::vector<std::string> names = available();
+    if (names.empty())
+    {
+        return nullptr; // The build requires at least one backend
+    }
+
+    std::string name = config.getString("Database", "Backend", names.front());
+    if (std::find(names.begin(), names.end(), name) == names.end())
+    {
+        logger->logError("MySqlComm: Storage backend '" + name + "' is not compiled in, using " +
+                         names.front());
+        name = names.front();
+    }
+
+#ifdef PASSFLOW_HAVE_MARIADB
+    if (name == "mariadb")
+    {
+        auto backend = std::make_unique<MariaDbBackend>(logger);
+        backend->configure(config);
+        return backend;
+    }
+#endif
+#ifdef PASSFLOW_HAVE_SQLITE
+    if (name == "sqlite")
+    {
+        auto backend = std::make_unique<SqliteBackend>(logger);
+        backend->configure(config);
+        return backend;
+    }
+#endif
+
+    return nullptr;
+}
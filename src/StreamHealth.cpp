@@ -0,0 +1,238 @@
+#include "StreamHealth.h"
+#include <algorithm>
+
+namespace
+{
+long long toMs(Timeline::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+}
+
+StreamHealth::StreamHealth(int cameraId, std::shared_ptr<Logger> logger)
+    : cameraId_(cameraId), logger_(logger), random_(std::random_device{}() ^ static_cast<unsigned>(cameraId)),
+      state_(State::Stopped), halfOpen_(false), failures_(0), lastBytes_(0), recovering_(false)
+{
+}
+
+const char *StreamHealth::stateName(State state)
+{
+    switch (state)
+    {
+    case State::Stopped:
+        return "stopped";
+    case State::Starting:
+        return "starting";
+    case State::Running:
+        return "running";
+    case State::Backoff:
+        return "backoff";
+    default:
+        return "circuit open";
+    }
+}
+
+const char *StreamHealth::failureName(Failure why)
+{
+    switch (why)
+    {
+    case Failure::Exited:
+        return "FFmpeg exited";
+    case Failure::Stalled:
+        return "stream stalled";
+    case Failure::NoData:
+        return "no data from camera";
+    default:
+        return "FFmpeg could not be started";
+    }
+}
+
+void StreamHealth::started(Timeline::Instant now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Open)
+    {
+        halfOpen_ = true;
+        logger_->log("Camera " + std::to_string(cameraId_) + ": circuit half-open, trying the stream once");
+    }
+    state_ = State::Starting;
+    startedAt_ = now;
+    lastGrowth_ = now;
+    lastBytes_ = 0;
+    metrics_.starts++;
+}
+
+void StreamHealth::stopped(Timeline::Instant now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Running)
+    {
+        endRun(now);
+    }
+    state_ = State::Stopped;
+    halfOpen_ = false;
+}
+
+void StreamHealth::failed(Timeline::Instant now, Failure why)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (why)
+    {
+    case Failure::Exited:
+        metrics_.exits++;
+        break;
+    case Failure::Stalled:
+        metrics_.stalls++;
+        break;
+    case Failure::NoData:
+        metrics_.noData++;
+        break;
+    case Failure::SpawnFailed:
+        metrics_.spawnFailures++;
+        break;
+    }
+
+    if (state_ == State::Running)
+    {
+        endRun(lastGrowth_);
+    }
+    if (!recovering_)
+    {
+        recovering_ = true;
+        downSince_ = now;
+    }
+    failures_++;
+
+    std::string prefix = "Camera " + std::to_string(cameraId_) + ": " + failureName(why);
+    if (halfOpen_ || failures_ >= BREAKER_THRESHOLD)
+    {
+        // Leave a dead camera alone instead of spawning ffmpeg every few seconds
+        state_ = State::Open;
+        halfOpen_ = false;
+        nextAttempt_ = now + BREAKER_OPEN;
+        metrics_.breakerTrips++;
+        logger_->logError(prefix + ", circuit open for " +
+                          std::to_string(std::chrono::duration_cast<std::chrono::seconds>(BREAKER_OPEN).count()) +
+                          " s after " + std::to_string(failures_) + " failures");
+        return;
+    }
+
+    auto delay = backoffDelay();
+    state_ = State::Backoff;
+    nextAttempt_ = now + delay;
+    logger_->logError(prefix + ", restarting in " + std::to_string(delay.count()) + " ms (failure " +
+                      std::to_string(failures_) + ")");
+}
+
+bool StreamHealth::check(Timeline::Instant now, uintmax_t outputBytes, Failure &why)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Starting)
+    {
+        if (outputBytes > 0)
+        {
+            state_ = State::Running;
+            firstDataAt_ = now;
+            lastGrowth_ = now;
+            lastBytes_ = outputBytes;
+            if (recovering_)
+            {
+                logger_->log("Camera " + std::to_string(cameraId_) + ": stream recovered after " +
+                             std::to_string(toMs(now - downSince_)) + " ms" +
+                             (halfOpen_ ? ", circuit closed" : ""));
+                recovering_ = false;
+            }
+            halfOpen_ = false;
+            return true;
+        }
+        if (now - startedAt_ >= FIRST_DATA_TIMEOUT)
+        {
+            why = Failure::NoData;
+            return false;
+        }
+        return true;
+    }
+
+    if (state_ == State::Running)
+    {
+        // Any change counts: a rotated file starts again from zero
+        if (outputBytes != lastBytes_)
+        {
+            lastBytes_ = outputBytes;
+            lastGrowth_ = now;
+            if (failures_ > 0 && now - firstDataAt_ >= STABLE_AFTER)
+            {
+                failures_ = 0;
+            }
+            return true;
+        }
+        if (now - lastGrowth_ >= STALL_TIMEOUT)
+        {
+            why = Failure::Stalled;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StreamHealth::restartDue(Timeline::Instant now) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (state_ == State::Backoff || state_ == State::Open) && now >= nextAttempt_;
+}
+
+void StreamHealth::wake(Timeline::Instant now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    failures_ = 0;
+    if (state_ == State::Backoff || state_ == State::Open)
+    {
+        logger_->log("Camera " + std::to_string(cameraId_) + ": powered on, retrying the stream now");
+        state_ = State::Backoff;
+        nextAttempt_ = now;
+    }
+}
+
+StreamHealth::State StreamHealth::state() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+}
+
+StreamHealth::Metrics StreamHealth::metrics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_;
+}
+
+std::string StreamHealth::summary() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::to_string(metrics_.starts) + " starts, " + std::to_string(metrics_.exits) + " exits, " +
+           std::to_string(metrics_.stalls) + " stalls, " + std::to_string(metrics_.noData) + " without data, " +
+           std::to_string(metrics_.spawnFailures) + " spawn failures, " + std::to_string(metrics_.breakerTrips) +
+           " breaker trips, uptime " + std::to_string(metrics_.uptime.count() / 1000) + " s, longest run " +
+           std::to_string(metrics_.longestRun.count() / 1000) + " s";
+}
+
+void StreamHealth::endRun(Timeline::Instant end)
+{
+    // Caller holds mutex_
+    auto run = std::chrono::duration_cast<std::chrono::milliseconds>(std::max(end, firstDataAt_) - firstDataAt_);
+    metrics_.uptime += run;
+    metrics_.longestRun = std::max(metrics_.longestRun, run);
+}
+
+std::chrono::milliseconds StreamHealth::backoffDelay()
+{
+    // Caller holds mutex_. Doubling from BACKOFF_BASE, then a random point
+    // in the upper half so cameras behind one switch don't retry in step
+    auto delay = std::chrono::milliseconds(BACKOFF_MAX);
+    int doublings = failures_ - 1;
+    if (doublings < 16)
+    {
+        delay = std::min(delay, BACKOFF_BASE * (1 << doublings));
+    }
+    std::uniform_int_distribution<long long> jitter(delay.count() / 2, delay.count());
+    return std::chrono::milliseconds(jitter(random_));
+}
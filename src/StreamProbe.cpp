@@ -0,0 +1,230 @@
+#include "StreamProbe.h"
+#include "ConfigIni.h"
+#include "Mp4Index.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+std::string toHex(const std::vector<uint8_t> &bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (uint8_t byte : bytes)
+    {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0f];
+    }
+    return hex;
+}
+}
+
+StreamProbe::StreamProbe(int cameraId, std::shared_ptr<Logger> logger)
+    : cameraId_(cameraId), logger_(logger), learnTransport_("tcp"), fast_(false), pendingChecks_(0)
+{
+}
+
+std::string StreamProbe::Params::describe() const
+{
+    std::string text = codec + " " + std::to_string(width) + "x" + std::to_string(height);
+    if (!transport.empty())
+        text += ", rtsp over " + transport;
+    if (!audioCodec.empty())
+        text += ", audio " + audioCodec;
+    return text;
+}
+
+bool StreamProbe::Params::sameStream(const Params &other) const
+{
+    return codec == other.codec && width == other.width && height == other.height &&
+           codecConfig == other.codecConfig && audioCodec == other.audioCodec;
+}
+
+bool StreamProbe::isRtsp(const std::string &url)
+{
+    return url.compare(0, 7, "rtsp://") == 0 || url.compare(0, 8, "rtsps://") == 0;
+}
+
+void StreamProbe::load(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = path;
+    }
+
+    ConfigIni ini;
+    if (!ini.load(path) || !ini.hasSection("Stream"))
+        return;
+
+    Params params;
+    params.url = ini.getString("Stream", "URL");
+    params.transport = ini.getString("Stream", "Transport");
+    params.codec = ini.getString("Stream", "Codec");
+    params.width = ini.getInt("Stream", "Width", 0);
+    params.height = ini.getInt("Stream", "Height", 0);
+    params.codecConfig = ini.getString("Stream", "CodecConfig");
+    params.audioCodec = ini.getString("Stream", "AudioCodec");
+    if (params.url.empty() || params.codec.empty() || params.codecConfig.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    cached_ = params;
+    logger_->log("Camera " + std::to_string(cameraId_) + ": cached stream parameters " + params.describe());
+}
+
+std::vector<std::string> StreamProbe::inputArgs(const std::string &url)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    url_ = url;
+    pendingChecks_ = 0;
+    fast_ = cached_ && cached_->url == url;
+
+    std::vector<std::string> args;
+    if (fast_)
+    {
+        transport_ = cached_->transport;
+        args = {"-probesize", std::to_string(FAST_PROBESIZE),
+                "-analyzeduration", std::to_string(FAST_ANALYZEDURATION_US)};
+    }
+    else
+    {
+        transport_ = isRtsp(url) ? learnTransport_ : "";
+    }
+
+    if (!transport_.empty())
+    {
+        args.insert(args.begin(), {"-rtsp_transport", transport_});
+    }
+    return args;
+}
+
+bool StreamProbe::fast() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fast_;
+}
+
+std::optional<StreamProbe::Params> StreamProbe::cached() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_;
+}
+
+StreamProbe::Verdict StreamProbe::recorded(const std::string &file)
+{
+    // The moov is written with the first bytes (empty_moov); a file this
+    // young may still be short of it
+    Mp4Index index;
+    const Mp4Index::Track *video = index.open(file) ? index.videoTrack() : nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!video || video->width == 0)
+    {
+        if (++pendingChecks_ < MAX_PENDING_CHECKS)
+            return Verdict::Pending;
+        logger_->logError("Camera " + std::to_string(cameraId_) + ": no video track in " + file +
+                          ", stream parameters not cached");
+        return Verdict::Unknown;
+    }
+
+    Params params;
+    params.url = url_;
+    params.transport = transport_;
+    params.codec = video->codec;
+    params.width = video->width;
+    params.height = video->height;
+    params.codecConfig = toHex(video->codecConfig);
+    for (const auto &track : index.tracks())
+    {
+        if (track.second.handler == "soun")
+        {
+            params.audioCodec = track.second.codec;
+            break;
+        }
+    }
+
+    if (fast_ && params.codecConfig.empty())
+    {
+        // Probing stopped before the parameter sets arrived; this file
+        // would not play
+        forget("fast start recorded without SPS/PPS");
+        return Verdict::Broken;
+    }
+    if (fast_ && params.sameStream(*cached_))
+    {
+        return Verdict::Verified;
+    }
+    if (params.codecConfig.empty())
+    {
+        logger_->logError("Camera " + std::to_string(cameraId_) +
+                          ": stream has no SPS/PPS in its moov, parameters not cached");
+        return Verdict::Unknown;
+    }
+
+    bool changed = fast_;
+    cached_ = params;
+    save(params);
+    logger_->log("Camera " + std::to_string(cameraId_) + (changed ? ": stream changed, now " : ": learned stream ") +
+                 params.describe());
+    return changed ? Verdict::Changed : Verdict::Learned;
+}
+
+void StreamProbe::startFailed()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fast_)
+    {
+        forget("start with cached parameters failed");
+    }
+    else if (isRtsp(url_))
+    {
+        // Still learning: try the other transport next time
+        learnTransport_ = learnTransport_ == "tcp" ? "udp" : "tcp";
+    }
+}
+
+void StreamProbe::forget(const std::string &reason)
+{
+    // Caller holds mutex_
+    logger_->log("Camera " + std::to_string(cameraId_) + ": " + reason + ", next start probes fully");
+    cached_.reset();
+    fast_ = false;
+    std::remove(path_.c_str());
+}
+
+bool StreamProbe::save(const Params &params)
+{
+    // Caller holds mutex_. The URL may carry credentials: owner-only file,
+    // written to a temporary and renamed so a power cut leaves the old one
+    std::string text = "# Learned by PassFlow; delete to force a full probe\n"
+                       "[Stream]\n"
+                       "URL = " + params.url + "\n"
+                       "Transport = " + params.transport + "\n"
+                       "Codec = " + params.codec + "\n"
+                       "Width = " + std::to_string(params.width) + "\n"
+                       "Height = " + std::to_string(params.height) + "\n"
+                       "CodecConfig = " + params.codecConfig + "\n"
+                       "AudioCodec = " + params.audioCodec + "\n";
+
+    std::string tmpPath = path_ + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        logger_->logError("Camera " + std::to_string(cameraId_) + ": cannot write " + tmpPath);
+        return false;
+    }
+
+    bool ok = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+    fsync(fd);
+    close(fd);
+
+    if (!ok || std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        logger_->logError("Camera " + std::to_string(cameraId_) + ": cannot write " + path_);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#include "Timeline.h"
+#include <atomic>
+#include <cstdint>
+
+namespace
+{
+// system_clock - steady_clock, in nanoseconds
+int64_t sampleOffset()
+{
+    auto wall = std::chrono::system_clock::now().time_since_epoch();
+    auto steady = Timeline::Clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count() -
+           std::chrono::duration_cast<std::chrono::nanoseconds>(steady).count();
+}
+
+std::atomic<int64_t> &offset()
+{
+    static std::atomic<int64_t> value{sampleOffset()};
+    return value;
+}
+}
+
+namespace Timeline {
+
+std::chrono::system_clock::time_point toWall(Instant instant)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(instant.time_since_epoch()).count() +
+              offset().load();
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+Instant fromWall(std::chrono::system_clock::time_point wall)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wall.time_since_epoch()).count() -
+              offset().load();
+    return Instant(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+std::chrono::milliseconds resync()
+{
+    int64_t sample = sampleOffset();
+    int64_t previous = offset().exchange(sample);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(sample - previous));
+}
+
+} // namespace Timeline
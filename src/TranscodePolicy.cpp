@@ -0,0 +1,166 @@
+#include "TranscodePolicy.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+
+TranscodePolicy::TranscodePolicy(std::shared_ptr<Logger> logger)
+    : logger_(logger), adaptive_(true), backlog_(0), restarted_(false), cpuBusyTicks_(0), cpuTotalTicks_(0),
+      cpuBusy_(0), cpuSampledAt_(std::chrono::steady_clock::now()),
+      cpuCount_(std::max(1, static_cast<int>(std::thread::hardware_concurrency()))), lastTier_(Tier::Full)
+{
+    readCpuTicks(cpuBusyTicks_, cpuTotalTicks_);
+}
+
+std::string TranscodePolicy::Params::describe() const
+{
+    return preset + " crf=" + std::to_string(crf) + " threads=" +
+           (threads > 0 ? std::to_string(threads) : "auto") + " " + std::to_string(width) + "x" +
+           std::to_string(height);
+}
+
+const char *TranscodePolicy::tierName(Tier tier)
+{
+    switch (tier)
+    {
+    case Tier::Full:
+        return "full";
+    case Tier::Reduced:
+        return "reduced";
+    default:
+        return "minimal";
+    }
+}
+
+void TranscodePolicy::configure(const Params &full, bool adaptive)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    full_ = full;
+    full_.tier = Tier::Full;
+    adaptive_ = adaptive;
+    logger_->log("TranscodePolicy: Full quality " + full_.describe() +
+                 (adaptive ? ", adapting to load" : ", fixed"));
+}
+
+void TranscodePolicy::jobQueued()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    backlog_++;
+}
+
+void TranscodePolicy::jobFinished()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    backlog_ = std::max(backlog_ - 1, 0);
+}
+
+void TranscodePolicy::recorderRestarted()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    restarted_ = true;
+    lastRestart_ = std::chrono::steady_clock::now();
+}
+
+TranscodePolicy::Params TranscodePolicy::paramsFor(Tier tier) const
+{
+    Params params = full_;
+    params.tier = tier;
+    if (tier == Tier::Reduced)
+    {
+        params.preset = "veryfast";
+        params.crf = full_.crf + 2;
+        params.threads = std::max(1, cpuCount_ / 2);
+    }
+    else if (tier == Tier::Minimal)
+    {
+        // Three quarters of the frame, kept even for the encoder
+        params.preset = "ultrafast";
+        params.crf = full_.crf + 5;
+        params.threads = 1;
+        params.width = full_.width * 3 / 4 / 2 * 2;
+        params.height = full_.height * 3 / 4 / 2 * 2;
+    }
+    return params;
+}
+
+TranscodePolicy::Params TranscodePolicy::choose()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!adaptive_)
+        return full_;
+
+    Load load;
+    load.backlog = backlog_;
+    auto now = std::chrono::steady_clock::now();
+    load.cpuBusy = now - cpuSampledAt_ < CPU_SAMPLE_MAX_AGE ? cpuBusy_ : sampleCpuLocked(now);
+    load.recorderTrouble = restarted_ &&
+                           now - lastRestart_ < RECORDER_TROUBLE_WINDOW;
+
+    Tier tier = Tier::Full;
+    if (load.backlog >= BACKLOG_MINIMAL || load.cpuBusy >= CPU_MINIMAL)
+    {
+        tier = Tier::Minimal;
+    }
+    else if (load.backlog >= BACKLOG_REDUCED || load.cpuBusy >= CPU_REDUCED || load.recorderTrouble)
+    {
+        tier = Tier::Reduced;
+    }
+
+    if (tier != lastTier_)
+    {
+        logger_->log(std::string("TranscodePolicy: ") + tierName(lastTier_) + " -> " + tierName(tier) +
+                     " (backlog " + std::to_string(load.backlog) + ", CPU " +
+                     std::to_string(static_cast<int>(load.cpuBusy * 100)) + "%" +
+                     (load.recorderTrouble ? ", recorder restarted recently" : "") + ")");
+        lastTier_ = tier;
+    }
+    return paramsFor(tier);
+}
+
+void TranscodePolicy::sampleCpu()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (adaptive_ && now - cpuSampledAt_ >= CPU_SAMPLE_INTERVAL)
+    {
+        sampleCpuLocked(now);
+    }
+}
+
+double TranscodePolicy::sampleCpuLocked(std::chrono::steady_clock::time_point now)
+{
+    // Caller holds mutex_
+    uint64_t busy;
+    uint64_t total;
+    if (readCpuTicks(busy, total) && total > cpuTotalTicks_)
+    {
+        cpuBusy_ = static_cast<double>(busy - std::min(busy, cpuBusyTicks_)) /
+                   static_cast<double>(total - cpuTotalTicks_);
+        cpuBusyTicks_ = busy;
+        cpuTotalTicks_ = total;
+        cpuSampledAt_ = now;
+    }
+    return cpuBusy_;
+}
+
+bool TranscodePolicy::readCpuTicks(uint64_t &busy, uint64_t &total)
+{
+    // "cpu  user nice system idle iowait irq softirq steal ..."
+    std::ifstream stat("/proc/stat");
+    std::string line;
+    if (!std::getline(stat, line) || line.compare(0, 4, "cpu ") != 0)
+        return false;
+
+    std::istringstream fields(line.substr(4));
+    uint64_t value;
+    uint64_t idle = 0;
+    total = 0;
+    for (int i = 0; i < 8 && fields >> value; i++)
+    {
+        total += value;
+        if (i == 3 || i == 4)
+            idle += value;
+    }
+    busy = total - idle;
+    return total > 0;
+}
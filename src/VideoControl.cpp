@@ -5,14 +5,22 @@
 #include <filesystem>
 #include <cmath>
 #include <algorithm>
+#include <csignal>
+#include <unistd.h>
+#include "Process.h"
+#include "Mp4Index.h"
 
 // CameraRecorder Implementation
 
 CameraRecorder::CameraRecorder(const CameraConfig &config, 
                                std::shared_ptr<Logger> logger,
-                               std::shared_ptr<MySqlComm> dbComm)
-    : config_(config), logger_(logger), dbComm_(dbComm), 
-      running_(false), ffmpegProcess_(nullptr), daysBeforeDeleteVideo_(30)
+                               std::shared_ptr<MySqlComm> dbComm,
+                               std::shared_ptr<Clock> clock)
+    : config_(config), logger_(logger), dbComm_(dbComm), clock_(clock), 
+      running_(false), loopWake_(false), ffmpegPid_(-1), health_(config.id, logger), probe_(config.id, logger),
+      probePending_(false), paused_(false), cleanupDue_(false), wakePending_(false), daysBeforeDeleteVideo_(30), activeJobs_(0),
+      reactor_(nullptr), pool_(nullptr), rotateTimer_(-1), cleanupTimer_(-1), firstDataTimer_(-1),
+      healthTimer_(-1)
 {
     // Setup directories
     const char *home = getenv("HOME");
@@ -23,6 +31,8 @@ CameraRecorder::CameraRecorder(const CameraConfig &config,
 
     std::filesystem::create_directories(sourceDir_);
     std::filesystem::create_directories(outputDir_);
+
+    probe_.load(sourceDir_ + "/stream.probe");
 }
 
 CameraRecorder::~CameraRecorder()
@@ -32,68 +42,581 @@ CameraRecorder::~CameraRecorder()
 
 std::string CameraRecorder::generateFilename()
 {
-    auto now = std::chrono::system_clock::now();
+    auto now = clock_->wallNow();
     auto time_t = std::chrono::system_clock::to_time_t(now);
 
     std::stringstream ss;
     ss << std::put_time(std::localtime(&time_t), "%Y%m%d_%H%M%S");
-    ss << "_cam" << config_.id << ".mp4";
+    ss << "_cam" << config_.id;
 
-    return sourceDir_ + "/" + ss.str();
+    // A restart within the same second must not overwrite the previous file
+    std::string base = sourceDir_ + "/" + ss.str();
+    std::string path = base + ".mp4";
+    for (int n = 2; std::filesystem::exists(path); n++)
+    {
+        path = base + "_" + std::to_string(n) + ".mp4";
+    }
+    return path;
 }
 
 bool CameraRecorder::startFFmpeg()
 {
     std::lock_guard<std::mutex> lock(fileMutex_);
 
-    currentVideoFile_ = generateFilename();
-    currentFileStartTime_ = std::chrono::system_clock::now();
+    if (ffmpegPid_ > 0 && !Process::hasExited(ffmpegPid_))
+    {
+        return true; // Already recording
+    }
+    if (paused_)
+    {
+        return false; // Started by resume()
+    }
+
+    if (!spawnFFmpegLocked())
+    {
+        health_.failed(clock_->now(), StreamHealth::Failure::SpawnFailed);
+        return false;
+    }
+    startedAt_ = clock_->now();
+    health_.started(startedAt_);
+
+    if (reactor_)
+    {
+        // Poll quickly until the first bytes arrive, so the time to first
+        // data is measured to the 50 ms
+        reactor_->cancelTimer(firstDataTimer_);
+        firstDataTimer_ = reactor_->addTimer(startedAt_ + FIRST_DATA_POLL, [this]()
+                                             { checkHealth(); },
+                                             FIRST_DATA_POLL);
+    }
+    return true;
+}
+
+bool CameraRecorder::spawnFFmpegLocked()
+{
+    auto now = clock_->now();
+    std::string file = generateFilename();
 
-    // Build ffmpeg command
-    std::stringstream cmd;
-    cmd << "ffmpeg -i \"" << config_.rtspUrl << "\" ";
-    cmd << "-c:v copy -c:a copy -f mp4 -y \"" << currentVideoFile_ << "\" ";
-    cmd << "2>&1 &"; // Run in background
+    // Record fragmented MP4: a fragment is flushed at least every second,
+    // so the file is readable while it grows and survives a power cut up
+    // to the last complete fragment
+    std::vector<std::string> args = {"ffmpeg", "-nostdin", "-loglevel", "error"};
+    std::vector<std::string> input = probe_.inputArgs(config_.rtspUrl);
+    args.insert(args.end(), input.begin(), input.end());
+    args.insert(args.end(), {
+        "-i", config_.rtspUrl,
+        "-c:v", "copy", "-c:a", "copy",
+        "-f", "mp4", "-movflags", "+frag_keyframe+empty_moov+default_base_moof",
+        "-frag_duration", "1000000", "-flush_packets", "1",
+        "-y", file});
 
     logger_->log("Starting FFmpeg for Camera " + std::to_string(config_.id) +
-                 ": " + currentVideoFile_);
+                 ": " + file);
 
-    int result = system(cmd.str().c_str());
+    pid_t pid = Process::spawn(args);
 
-    if (result != 0)
+    if (pid < 0)
     {
         logger_->logError("Failed to start FFmpeg for Camera " +
                           std::to_string(config_.id));
         return false;
     }
 
+    // The previous segment (if still open) ends where the new one begins
+    closeSourceSegmentLocked(now);
+    sourceHistory_.push_back({file, now, Timeline::Instant::max()});
+    if (clipIndex_)
+    {
+        clipIndex_->add({config_.id, ClipIndex::Kind::Source, ClipIndex::wallUs(Timeline::toWall(now)),
+                         ClipIndex::OPEN_END, file});
+    }
+    while (sourceHistory_.size() > MAX_SOURCE_HISTORY)
+    {
+        sourceHistory_.pop_front();
+    }
+
+    ffmpegPid_ = pid;
+    currentVideoFile_ = file;
+    currentFileStartTime_ = now;
+
+    if (reactor_)
+    {
+        watchFFmpeg(pid);
+
+        // Keep source files bounded; recording is never interrupted
+        reactor_->cancelTimer(rotateTimer_);
+        rotateTimer_ = reactor_->addTimer(now + SOURCE_ROTATE_INTERVAL, [this]()
+                                          { rotateSourceFile(); });
+    }
     return true;
 }
 
-void CameraRecorder::stopFFmpeg()
+void CameraRecorder::closeSourceSegmentLocked(Timeline::Instant end)
+{
+    if (!sourceHistory_.empty() && sourceHistory_.back().end == Timeline::Instant::max())
+    {
+        sourceHistory_.back().end = end;
+        if (clipIndex_)
+        {
+            clipIndex_->close(config_.id, sourceHistory_.back().path, ClipIndex::wallUs(Timeline::toWall(end)));
+        }
+    }
+}
+
+void CameraRecorder::markSourceStartLocked(Timeline::Instant start)
+{
+    if (!sourceHistory_.empty() && sourceHistory_.back().path == currentVideoFile_ &&
+        sourceHistory_.back().end == Timeline::Instant::max())
+    {
+        sourceHistory_.back().start = start;
+        if (clipIndex_)
+        {
+            clipIndex_->setStart(config_.id, currentVideoFile_, ClipIndex::wallUs(Timeline::toWall(start)));
+        }
+    }
+}
+
+void CameraRecorder::watchFFmpeg(pid_t pid)
+{
+    if (!reactor_->watchChild(pid, [this, pid]()
+                              { onFFmpegExited(pid); }))
+    {
+        logger_->logError("Camera " + std::to_string(config_.id) + ": cannot watch FFmpeg pid " +
+                          std::to_string(pid));
+    }
+}
+
+void CameraRecorder::onFFmpegExited(pid_t pid)
+{
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        Process::hasExited(pid);
+
+        // Rotated out, killed as stalled or stopped on purpose: nothing to
+        // do but reap it
+        if (pid != ffmpegPid_)
+            return;
+        ffmpegPid_ = -1;
+        closeSourceSegmentLocked(clock_->now());
+        currentVideoFile_.clear();
+    }
+
+    // The health timer restarts it once the backoff has run out
+    onRecorderFailed(clock_->now(), StreamHealth::Failure::Exited);
+}
+
+void CameraRecorder::onRecorderFailed(Timeline::Instant now, StreamHealth::Failure why)
+{
+    if (health_.state() == StreamHealth::State::Starting)
+    {
+        probe_.startFailed();
+    }
+    health_.failed(now, why);
+    if (transcodePolicy_)
+    {
+        transcodePolicy_->recorderRestarted();
+    }
+}
+
+void CameraRecorder::checkHealth()
+{
+    if (transcodePolicy_)
+    {
+        transcodePolicy_->sampleCpu();
+    }
+
+    auto now = clock_->now();
+    pid_t stalledPid = -1;
+    bool failed = false;
+    bool firstData = false;
+    bool woke = false;
+    std::string file;
+    Timeline::Instant startedAt;
+    Timeline::Instant wakeFrom;
+    StreamHealth::Failure why = StreamHealth::Failure::Exited;
+
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        if (ffmpegPid_ > 0 && !reactor_ && Process::hasExited(ffmpegPid_))
+        {
+            // The reactor learns about exits from the child watch instead
+            failed = true;
+        }
+        else if (ffmpegPid_ > 0)
+        {
+            // One stat per camera per check; fragments are flushed every
+            // second, so a healthy stream always grows between checks
+            std::error_code ec;
+            uintmax_t bytes = std::filesystem::file_size(currentVideoFile_, ec);
+            bool starting = health_.state() == StreamHealth::State::Starting;
+            if (!health_.check(now, ec ? 0 : bytes, why))
+            {
+                stalledPid = ffmpegPid_;
+                failed = true;
+            }
+            firstData = starting && health_.state() == StreamHealth::State::Running;
+            if (firstData)
+            {
+                // Time 0 of the file is the first packet received, not the
+                // spawn: clips are cut relative to this start
+                markSourceStartLocked(now);
+            }
+        }
+        file = currentVideoFile_;
+        startedAt = startedAt_;
+        if (firstData && wakePending_)
+        {
+            woke = true;
+            wakePending_ = false;
+            wakeFrom = wakeFrom_;
+        }
+
+        if (failed)
+        {
+            ffmpegPid_ = -1;
+            closeSourceSegmentLocked(now);
+            currentVideoFile_.clear();
+        }
+    }
+
+    if (stalledPid > 0)
+    {
+        // A file that stopped growing has nothing left to finalize
+        if (reactor_)
+        {
+            kill(stalledPid, SIGKILL);  // Reaped by the child watch
+        }
+        else
+        {
+            Process::stop(stalledPid, SIGKILL, std::chrono::steady_clock::now() + STOP_TIMEOUT);
+        }
+    }
+    if (failed)
+    {
+        onRecorderFailed(now, why);
+        probePending_ = false;
+    }
+
+    if (firstData)
+    {
+        logger_->log("Camera " + std::to_string(config_.id) + ": first data after " +
+                     std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - startedAt).count()) +
+                     " ms, " + (probe_.fast() ? "cached" : "full") + " probe (" +
+                     std::to_string(millisSinceStart()) + " ms since start)");
+        probePending_ = true;
+    }
+    if (woke)
+    {
+        std::string ready = "Camera " + std::to_string(config_.id) + ": ready " +
+                            std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - wakeFrom).count()) +
+                            " ms after wake-up";
+        if (now - wakeFrom > PowerPolicy::WAKE_LATENCY)
+        {
+            logger_->logError(ready + ", over the " + std::to_string(PowerPolicy::WAKE_LATENCY.count()) + " s target");
+        }
+        else
+        {
+            logger_->log(ready);
+        }
+    }
+    if (probePending_)
+    {
+        checkProbe(file);
+    }
+
+    if (reactor_ && health_.state() != StreamHealth::State::Starting)
+    {
+        reactor_->cancelTimer(firstDataTimer_);
+    }
+    if (running_ && health_.restartDue(now))
+    {
+        startFFmpeg();
+    }
+}
+
+void CameraRecorder::checkProbe(const std::string &file)
+{
+    StreamProbe::Verdict verdict = probe_.recorded(file);
+    if (verdict == StreamProbe::Verdict::Pending)
+        return;
+    probePending_ = false;
+
+    if (verdict == StreamProbe::Verdict::Broken && running_)
+    {
+        // This recording has no parameter sets and would not play
+        logger_->logError("Camera " + std::to_string(config_.id) + ": restarting with a full probe");
+        if (reactor_)
+        {
+            stopFFmpegInLoop();
+        }
+        else
+        {
+            stopFFmpeg(std::chrono::steady_clock::now() + STOP_TIMEOUT);
+        }
+        startFFmpeg();
+    }
+}
+
+void CameraRecorder::powerOn()
+{
+    health_.wake(clock_->now());
+    if (!running_)
+        return;
+
+    if (reactor_)
+    {
+        checkHealth();
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(loopMutex_);
+            loopWake_ = true;
+        }
+        loopCv_.notify_all();
+    }
+}
+
+void CameraRecorder::pause()
+{
+    if (!running_ || paused_.exchange(true))
+        return;
+
+    if (reactor_)
+    {
+        reactor_->cancelTimer(healthTimer_);
+        reactor_->cancelTimer(firstDataTimer_);
+        reactor_->cancelTimer(rotateTimer_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        wakePending_ = false;
+    }
+    if (reactor_)
+    {
+        stopFFmpegInLoop();
+    }
+    else
+    {
+        stopFFmpeg(std::chrono::steady_clock::now() + STOP_TIMEOUT);
+    }
+    logger_->log("Camera " + std::to_string(config_.id) + ": recording paused");
+}
+
+void CameraRecorder::resume(Timeline::Instant since)
+{
+    if (!running_ || !paused_)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        paused_ = false;
+        wakePending_ = true;
+        wakeFrom_ = since;
+    }
+    logger_->log("Camera " + std::to_string(config_.id) + ": recording resumed");
+
+    // Any backoff dates from before the pause
+    health_.wake(clock_->now());
+    startFFmpeg();
+
+    if (reactor_)
+    {
+        healthTimer_ = reactor_->addTimer(
+            clock_->now() + HEALTH_CHECK_INTERVAL, [this]()
+            { checkHealth(); },
+            HEALTH_CHECK_INTERVAL);
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(loopMutex_);
+            loopWake_ = true;
+        }
+        loopCv_.notify_all();
+    }
+}
+
+void CameraRecorder::cleanupSoon()
+{
+    if (!running_)
+        return;
+
+    if (reactor_)
+    {
+        pool_->submit([this]()
+                      { cleanupOldVideos(); });
+        return;
+    }
+
+    cleanupDue_ = true;
+    {
+        std::lock_guard<std::mutex> lock(loopMutex_);
+        loopWake_ = true;
+    }
+    loopCv_.notify_all();
+}
+
+bool CameraRecorder::stopFFmpeg(std::chrono::steady_clock::time_point deadline)
 {
     std::lock_guard<std::mutex> lock(fileMutex_);
 
-    if (!currentVideoFile_.empty())
+    bool finalized = true;
+    if (ffmpegPid_ > 0)
     {
-        // Kill ffmpeg processes for this camera
-        std::string killCmd = "pkill -f \"" + currentVideoFile_ + "\"";
-        system(killCmd.c_str());
+        // SIGINT makes ffmpeg write its last fragment and exit; wait for that
+        // instead of a fixed delay, and kill it only if the deadline passes
+        finalized = Process::stop(ffmpegPid_, SIGINT, deadline);
+        ffmpegPid_ = -1;
 
-        // Wait a bit for graceful shutdown
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (!finalized)
+        {
+            logger_->logError("FFmpeg for Camera " + std::to_string(config_.id) +
+                              " did not finish in time, killed: " + currentVideoFile_);
+        }
+    }
+
+    closeSourceSegmentLocked(clock_->now());
+    health_.stopped(clock_->now());
 
+    if (!currentVideoFile_.empty())
+    {
         logger_->log("Stopped recording: " + currentVideoFile_);
         currentVideoFile_.clear();
     }
+
+    return finalized;
+}
+
+void CameraRecorder::stopFFmpegInLoop()
+{
+    // Reactor runtime: the same as stopFFmpeg() without waiting for the
+    // exit, which would hold up the loop for up to STOP_TIMEOUT
+    pid_t pid;
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        pid = ffmpegPid_;
+        ffmpegPid_ = -1;
+
+        closeSourceSegmentLocked(clock_->now());
+        health_.stopped(clock_->now());
+
+        if (!currentVideoFile_.empty())
+        {
+            logger_->log("Stopped recording: " + currentVideoFile_);
+            currentVideoFile_.clear();
+        }
+    }
+
+    if (pid > 0)
+    {
+        interruptFFmpeg(pid);
+    }
+}
+
+void CameraRecorder::interruptFFmpeg(pid_t pid)
+{
+    // ffmpeg finalizes its file on SIGINT; the exit watch reaps it, the
+    // timer makes sure
+    kill(pid, SIGINT);
+    reactor_->addTimer(std::chrono::steady_clock::now() + STOP_TIMEOUT, [pid]()
+                       {
+                           if (!Process::hasExited(pid))
+                               kill(pid, SIGKILL);
+                       });
+}
+
+void CameraRecorder::rotateSourceFile()
+{
+    pid_t oldPid;
+    std::string oldFile;
+    std::string newFile;
+
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        oldPid = ffmpegPid_;
+        oldFile = currentVideoFile_;
+
+        // Nothing to rotate while the stream is down; the restart opens a new file
+        if (oldPid <= 0)
+        {
+            return;
+        }
+
+        // Start the new file first so there is no gap in the footage
+        if (!spawnFFmpegLocked())
+        {
+            return;
+        }
+        newFile = currentVideoFile_;
+    }
+
+    if (oldPid > 0 && reactor_)
+    {
+        interruptFFmpeg(oldPid);  // Don't block the loop
+    }
+    else if (oldPid > 0)
+    {
+        Process::stop(oldPid, SIGINT, std::chrono::steady_clock::now() + STOP_TIMEOUT);
+    }
+    logger_->log("Rotated source file: " + oldFile + " -> " + newFile);
+}
+
+void CameraRecorder::reconfigure(const std::string &rtspUrl)
+{
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        if (config_.rtspUrl == rtspUrl)
+        {
+            return;
+        }
+        config_.rtspUrl = rtspUrl;
+    }
+
+    logger_->log("Camera " + std::to_string(config_.id) + " stream changed to " + rtspUrl);
+
+    if (reactor_)
+    {
+        // Called from the settings watcher: restart on the loop, which
+        // owns the ffmpeg process and must not wait for it to exit
+        reactor_->post([this]()
+                       {
+                           if (running_)
+                           {
+                               stopFFmpegInLoop();
+                               startFFmpeg();
+                           }
+                       });
+    }
+    else if (running_)
+    {
+        stopFFmpeg(std::chrono::steady_clock::now() + STOP_TIMEOUT);
+        startFFmpeg();
+    }
 }
 
 void CameraRecorder::cleanupOldVideos()
 {
     // Delete video files older than daysBeforeDeleteVideo_
-    auto now = std::chrono::system_clock::now();
-    auto cutoffTime = now - std::chrono::hours(24 * daysBeforeDeleteVideo_);
-    
+    auto now = clock_->wallNow();
+    auto cutoffTime = now - std::chrono::hours(24 * daysBeforeDeleteVideo_.load());
+
+    if (clipIndex_) {
+        // The index knows where each clip and source recording ends in
+        // time; a file's mtime moves when it is copied or touched
+        int64_t cutoffUs = ClipIndex::wallUs(cutoffTime);
+        for (const auto& entry : clipIndex_->query(config_.id, 0, cutoffUs, true)) {
+            std::error_code ec;
+            if (entry.endUs < cutoffUs && std::filesystem::remove(entry.path, ec)) {
+                logger_->log("Deleted old video: " + entry.path);
+            }
+        }
+        clipIndex_->removeBefore(config_.id, ClipIndex::Kind::Clip, cutoffUs);
+        clipIndex_->removeBefore(config_.id, ClipIndex::Kind::Source, cutoffUs);
+    }
+
+    // Files the index does not list (a clip whose database row was lost)
+    // fall back to their mtime
     try {
         for (const auto& entry : std::filesystem::recursive_directory_iterator(outputDir_)) {
             if (entry.is_regular_file() && entry.path().extension() == ".mp4") {
@@ -111,178 +634,500 @@ void CameraRecorder::cleanupOldVideos()
     } catch (const std::exception& e) {
         logger_->logError("Error during video cleanup: " + std::string(e.what()));
     }
+
+    // Database rows for the same period go with the files
+    if (dbComm_) {
+        dbComm_->applyRetention(daysBeforeDeleteVideo_.load(), now);
+    }
+}
+
+void CameraRecorder::start()
+{
+    running_ = true;
+
+    if (reactor_)
+    {
+        startFFmpeg();
+
+        healthTimer_ = reactor_->addTimer(
+            clock_->now() + HEALTH_CHECK_INTERVAL, [this]()
+            { checkHealth(); },
+            HEALTH_CHECK_INTERVAL);
+
+        // The directory walk and retention queries run on the pool
+        cleanupTimer_ = reactor_->addTimer(
+            clock_->now() + CLEANUP_INTERVAL, [this]()
+            { pool_->submit([this]()
+                            { cleanupOldVideos(); }); },
+            CLEANUP_INTERVAL);
+    }
+    else
+    {
+        recordThread_ = std::thread(&CameraRecorder::recordLoop, this);
+    }
+    logger_->log("Camera " + std::to_string(config_.id) + " recorder started");
+}
+
+bool CameraRecorder::stop(std::chrono::steady_clock::time_point deadline)
+{
+    bool finalized = true;
+
+    if (running_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(loopMutex_);
+            running_ = false;
+        }
+        loopCv_.notify_all();
+
+        if (reactor_)
+        {
+            reactor_->cancelTimer(rotateTimer_);
+            reactor_->cancelTimer(cleanupTimer_);
+            reactor_->cancelTimer(firstDataTimer_);
+            reactor_->cancelTimer(healthTimer_);
+
+            // Clips still waiting for their footage are cut from what has
+            // been recorded so far, as in the threaded runtime
+            std::map<Reactor::TimerId, ClipJob> waiting;
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex_);
+                waiting.swap(waitingClips_);
+            }
+            for (const auto &clip : waiting)
+            {
+                reactor_->cancelTimer(clip.first);
+                submitClipJob(clip.second);
+            }
+        }
+
+        finalized = stopFFmpeg(deadline);
+
+        if (recordThread_.joinable())
+        {
+            recordThread_.join();
+        }
+
+        logger_->log("Camera " + std::to_string(config_.id) + " recorder stopped: " + health_.summary());
+    }
+
+    return finalized;
+}
+
+bool CameraRecorder::waitWhileRunning(std::chrono::milliseconds duration)
+{
+    std::unique_lock<std::mutex> lock(loopMutex_);
+    clock_->waitFor(lock, loopCv_, duration, [this] { return !running_ || loopWake_; });
+    loopWake_ = false;
+    return running_;
+}
+
+void CameraRecorder::recordLoop()
+{
+    // Start initial recording
+    startFFmpeg();
+    
+    // Periodic cleanup of old videos (every hour)
+    auto nextCleanup = clock_->now() + CLEANUP_INTERVAL;
+
+    // Poll quickly while a start waits for its first bytes, so the time to
+    // first data is measured to the 50 ms; hardly at all while paused
+    auto interval = [this]() -> std::chrono::milliseconds
+    {
+        if (paused_)
+            return PAUSED_CHECK_INTERVAL;
+        return health_.state() == StreamHealth::State::Starting ? FIRST_DATA_POLL : HEALTH_CHECK_INTERVAL;
+    };
+    while (waitWhileRunning(interval()))
+    {
+        // Exits, stalls and restarts after the backoff
+        checkHealth();
+
+        if (clock_->now() - currentFileStartTime_ >= SOURCE_ROTATE_INTERVAL)
+        {
+            // Keep source files bounded; recording is never interrupted
+            rotateSourceFile();
+        }
+        
+        if (clock_->now() >= nextCleanup || cleanupDue_.exchange(false)) {
+            cleanupOldVideos();
+            nextCleanup = clock_->now() + CLEANUP_INTERVAL;
+        }
+    }
+}
+
+void CameraRecorder::processStartStopMessage(const StartStopMessage &msg)
+{
+    ClipJob job{msg, clipFilename(msg.startTime, msg.stopTime)};
+    if (clipJobs_ &&
+        !clipJobs_->accepted({config_.id, msg.doorId, ClipIndex::wallUs(Timeline::toWall(msg.startTime)),
+                              ClipIndex::wallUs(Timeline::toWall(msg.stopTime)), job.outputFile},
+                             reactor_ != nullptr))
+    {
+        logger_->log("Camera " + std::to_string(config_.id) + ": clip " + job.outputFile + " already queued");
+        return;
+    }
+    if (clipJobs_ && reactor_)
+    {
+        // Called on the loop: the journal is synced on the pool, where
+        // requests arriving together share one fdatasync
+        auto journal = clipJobs_;
+        if (!pool_->submit([journal]()
+                           { journal->sync(); }))
+        {
+            journal->sync();
+        }
+    }
+
+    // Recording continues; the clip is cut from the growing fragmented
+    // source file(s) once its stop time has been recorded
+    if (transcodePolicy_)
+    {
+        transcodePolicy_->jobQueued();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        activeJobs_++;
+
+        if (reactor_)
+        {
+            // Wait for the footage on a timer, then transcode on the pool
+            auto timer = std::make_shared<Reactor::TimerId>(-1);
+            *timer = reactor_->addTimer(msg.stopTime + FRAGMENT_FLUSH_MARGIN, [this, timer]()
+                                        {
+                                            ClipJob clip;
+                                            {
+                                                std::lock_guard<std::mutex> lock(jobsMutex_);
+                                                auto it = waitingClips_.find(*timer);
+                                                if (it == waitingClips_.end())
+                                                    return;  // Taken over by stop()
+                                                clip = it->second;
+                                                waitingClips_.erase(it);
+                                            }
+                                            submitClipJob(clip);
+                                        });
+            if (*timer >= 0)
+            {
+                waitingClips_[*timer] = job;
+                return;
+            }
+        }
+    }
+
+    if (reactor_)
+    {
+        submitClipJob(job);
+        return;
+    }
+
+    std::thread([this, job]()
+                {
+                    waitForFootage(job.window.stopTime);
+                    runClipJob(job);
+                })
+        .detach();
+}
+
+void CameraRecorder::resumeClipJob(const ClipJob &job)
+{
+    if (transcodePolicy_)
+    {
+        transcodePolicy_->jobQueued();
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        activeJobs_++;
+    }
+    runClipJob(job);
+}
+
+void CameraRecorder::submitClipJob(const ClipJob &job)
+{
+    // A dropped job stays in the journal and is cut at the next start
+    if (!pool_->submit([this, job]()
+                       { runClipJob(job); }))
+    {
+        logger_->logError("Camera " + std::to_string(config_.id) + ": clip " +
+                          formatTimestamp(job.window.startTime) + " dropped");
+        if (transcodePolicy_)
+        {
+            transcodePolicy_->jobFinished();
+        }
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        activeJobs_--;
+        jobsCv_.notify_all();
+    }
+}
+
+void CameraRecorder::runClipJob(const ClipJob &job)
+{
+    const StartStopMessage &msg = job.window;
+    if (clipJobs_)
+    {
+        clipJobs_->started(job.outputFile);
+    }
+
+    TranscodePolicy::Params params = transcodePolicy_ ? transcodePolicy_->choose() : TranscodePolicy::Params();
+    bool written = extractAndProcessSegment(msg.startTime, msg.stopTime, job.outputFile, params, job.niceness);
+    if (written)
+    {
+        if (clipIndex_)
+        {
+            clipIndex_->add({config_.id, ClipIndex::Kind::Clip,
+                             ClipIndex::wallUs(Timeline::toWall(msg.startTime)),
+                             ClipIndex::wallUs(Timeline::toWall(msg.stopTime)), job.outputFile});
+        }
+        if (dbComm_)
+        {
+            dbComm_->logVideoSegment(config_.id, formatTimestamp(msg.startTime),
+                                     formatTimestamp(msg.stopTime), job.outputFile, params.describe());
+        }
+    }
+
+    // A clip that failed during shutdown (ffmpeg killed, footage still
+    // being finalized) is retried at the next start; any other failure
+    // would only fail again
+    if (clipJobs_ && (written || running_))
+    {
+        clipJobs_->finished(job.outputFile);
+    }
+
+    if (transcodePolicy_)
+    {
+        transcodePolicy_->jobFinished();
+    }
+
+    std::lock_guard<std::mutex> lock(jobsMutex_);
+    activeJobs_--;
+    jobsCv_.notify_all();
+}
+
+void CameraRecorder::waitForFootage(Timeline::Instant stopTime)
+{
+    // Wait until the fragment containing stopTime has been flushed; on
+    // shutdown, cut whatever has been recorded so far
+    std::unique_lock<std::mutex> lock(loopMutex_);
+    clock_->waitUntil(lock, loopCv_, stopTime + FRAGMENT_FLUSH_MARGIN, [this] { return !running_; });
+}
+
+std::string CameraRecorder::clipFilename(Timeline::Instant startTime,
+                                         Timeline::Instant stopTime) const
+{
+    // Output directory with current date, filename with start and stop times
+    std::string outputFile = outputDir_ + "/" + getCurrentDateString() + "/" +
+                             formatTimestamp(startTime) + "_" +
+                             formatTimestamp(stopTime) + ".mp4";
+
+    // Replace spaces and colons in filename
+    std::replace(outputFile.begin(), outputFile.end(), ' ', '_');
+    std::replace(outputFile.begin(), outputFile.end(), ':', '-');
+    return outputFile;
 }
 
-void CameraRecorder::start()
+int CameraRecorder::waitForJobs(std::chrono::steady_clock::time_point deadline)
 {
-    running_ = true;
-    recordThread_ = std::thread(&CameraRecorder::recordLoop, this);
-    logger_->log("Camera " + std::to_string(config_.id) + " recorder started");
+    std::unique_lock<std::mutex> lock(jobsMutex_);
+    jobsCv_.wait_until(lock, deadline, [this] { return activeJobs_ == 0; });
+    return activeJobs_;
 }
 
-void CameraRecorder::stop()
+std::vector<SourceSegment> CameraRecorder::sourcesFor(Timeline::Instant startTime,
+                                                      Timeline::Instant stopTime)
 {
-    if (running_)
+    // Source files overlapping the clip window (usually one, two if the
+    // window spans a rotation or ffmpeg restart)
+    std::vector<SourceSegment> sources;
     {
-        running_ = false;
-        stopFFmpeg();
-
-        if (recordThread_.joinable())
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        for (const auto &segment : sourceHistory_)
         {
-            recordThread_.join();
+            if (segment.start < stopTime && segment.end > startTime &&
+                std::filesystem::exists(segment.path))
+            {
+                sources.push_back(segment);
+            }
         }
+    }
+    if (!sources.empty() || !clipIndex_)
+        return sources;
 
-        logger_->log("Camera " + std::to_string(config_.id) + " recorder stopped");
+    // Footage recorded before this run (a resumed clip job): the index
+    // knows the source files found on disk at start
+    auto fromUs = [](int64_t us)
+    {
+        return Timeline::fromWall(std::chrono::system_clock::time_point(std::chrono::microseconds(us)));
+    };
+    for (const auto &entry : clipIndex_->query(config_.id, ClipIndex::wallUs(Timeline::toWall(startTime)),
+                                               ClipIndex::wallUs(Timeline::toWall(stopTime)), true))
+    {
+        if (entry.kind == ClipIndex::Kind::Source && std::filesystem::exists(entry.path))
+        {
+            sources.push_back({entry.path, fromUs(entry.startUs),
+                               entry.endUs == ClipIndex::OPEN_END ? Timeline::Instant::max() : fromUs(entry.endUs)});
+        }
     }
+    std::sort(sources.begin(), sources.end(),
+              [](const SourceSegment &a, const SourceSegment &b) { return a.start < b.start; });
+    return sources;
 }
 
-void CameraRecorder::recordLoop()
+bool CameraRecorder::extractAndProcessSegment(
+    Timeline::Instant startTime,
+    Timeline::Instant stopTime,
+    const std::string &outputFile,
+    const TranscodePolicy::Params &params,
+    int niceness)
 {
-    // Start initial recording
-    startFFmpeg();
-    
-    int cleanupCounter = 0;
+    std::vector<SourceSegment> sources = sourcesFor(startTime, stopTime);
+    if (sources.empty())
+    {
+        logger_->logError("No source file covers clip " + outputFile);
+        return false;
+    }
 
-    while (running_)
+    // Note: startTime and stopTime already have delays applied
+    auto toSeconds = [](Timeline::Clock::duration d)
+    {
+        return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(d).count() / 1000.0);
+    };
+    auto usToSeconds = [](int64_t us) { return std::to_string(us / 1000 / 1000.0); };
+    auto toUs = [](Timeline::Clock::duration d)
     {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+    auto startOffset = std::max(startTime - sources.front().start, Timeline::Clock::duration::zero());
+    auto duration = std::max(stopTime - startTime, Timeline::Clock::duration(std::chrono::seconds(1)));
 
-        // Check if ffmpeg is still running, restart if needed
-        std::string checkCmd = "pgrep -f \"" + currentVideoFile_ + "\" > /dev/null";
-        if (system(checkCmd.c_str()) != 0 && running_)
+    // Plan the cut on the files' own indexes: offsets count from each
+    // file's first sample, and the first file is entered on the keyframe
+    // at or before the cut (the concat demuxer cannot start a GOP midway);
+    // the frames up to the cut are decoded and dropped by the output -ss
+    std::vector<int64_t> firstSampleUs(sources.size(), 0);
+    int64_t entryUs = toUs(startOffset);
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        Mp4Index index;
+        if (!index.open(sources[i].path))
         {
-            logger_->logError("FFmpeg stopped unexpectedly, restarting...");
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-            startFFmpeg();
+            logger_->logError("Cannot index source " + sources[i].path + " (" + index.error() +
+                              "), cutting without keyframes");
+            continue;
         }
-        
-        // Periodic cleanup of old videos (every hour)
-        cleanupCounter++;
-        if (cleanupCounter >= 3600) {
-            cleanupOldVideos();
-            cleanupCounter = 0;
+        firstSampleUs[i] = index.firstSampleUs();
+        if (i == 0 && index.videoTrack() && !index.videoTrack()->keyframes.empty())
+        {
+            entryUs = std::max(index.keyframeAtOrBefore(firstSampleUs[0] + entryUs) - firstSampleUs[0],
+                               int64_t(0));
         }
     }
-}
+    int64_t trimUs = toUs(startOffset) - entryUs;
 
-void CameraRecorder::processStartStopMessage(const StartStopMessage &msg)
-{
-    std::string oldFile;
-    std::chrono::system_clock::time_point oldFileStart;
+    std::filesystem::create_directories(std::filesystem::path(outputFile).parent_path());
 
+    std::vector<std::string> args = {"ffmpeg", "-nostdin", "-loglevel", "error"};
+    std::string concatList;
+
+    if (sources.size() == 1)
     {
-        std::lock_guard<std::mutex> lock(fileMutex_);
-        oldFile = currentVideoFile_;
-        oldFileStart = currentFileStartTime_;
+        args.insert(args.end(), {"-ss", usToSeconds(entryUs), "-i", sources.front().path});
     }
+    else
+    {
+        // Join the files with the concat demuxer; each file is cut where
+        // the next one took over. inpoint/outpoint are file timestamps
+        concatList = outputFile + ".ffconcat";
+        std::ofstream list(concatList);
+        list << "ffconcat version 1.0\n";
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            list << "file '" << sources[i].path << "'\n";
+            if (i == 0)
+                list << "inpoint " << usToSeconds(firstSampleUs[0] + entryUs) << "\n";
+            if (i + 1 < sources.size())
+                list << "outpoint " << usToSeconds(firstSampleUs[i] + toUs(sources[i].end - sources[i].start)) << "\n";
+        }
+        list.close();
 
-    // Stop current recording and start new one
-    stopFFmpeg();
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    startFFmpeg();
-
-    // Extract and process segment in background thread
-    // msg already contains the adjusted start/stop times with delays applied
-    std::thread([this, oldFile, oldFileStart, msg]()
-                { 
-                    extractAndProcessSegment(oldFile, msg.startTime, msg.stopTime);
-                    
-                    // Log to database
-                    if (dbComm_) {
-                        std::string startTimeStr = formatTimestamp(msg.startTime);
-                        std::string stopTimeStr = formatTimestamp(msg.stopTime);
-                        
-                        // Generate output filename for logging
-                        std::string dateDir = outputDir_ + "/" + getCurrentDateString();
-                        std::string outputFile = dateDir + "/" +
-                                                 formatTimestamp(msg.startTime) + "_" +
-                                                 formatTimestamp(msg.stopTime) + ".mp4";
-                        std::replace(outputFile.begin(), outputFile.end(), ' ', '_');
-                        std::replace(outputFile.begin(), outputFile.end(), ':', '-');
-                        
-                        dbComm_->logVideoSegment(config_.id, startTimeStr, stopTimeStr, outputFile);
-                    }
-                })
-        .detach();
-}
-
-void CameraRecorder::extractAndProcessSegment(
-    const std::string &sourceFile,
-    std::chrono::system_clock::time_point startTime,
-    std::chrono::system_clock::time_point stopTime)
-{
-    if (sourceFile.empty() || !std::filesystem::exists(sourceFile))
+        args.insert(args.end(), {"-f", "concat", "-safe", "0", "-i", concatList});
+    }
+    if (trimUs > 0)
     {
-        logger_->logError("Source file not found: " + sourceFile);
-        return;
+        args.insert(args.end(), {"-ss", usToSeconds(trimUs)});
     }
 
-    // Calculate time offsets from file start
-    // Note: startTime and stopTime already have delays applied
-    auto fileStart = currentFileStartTime_;
-    auto startOffset = std::chrono::duration_cast<std::chrono::seconds>(
-                           startTime - fileStart)
-                           .count();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-                        stopTime - startTime)
-                        .count();
-
-    if (startOffset < 0)
-        startOffset = 0;
-    if (duration <= 0)
-        duration = 1;
-
-    // Create output directory with current date
-    std::string dateDir = outputDir_ + "/" + getCurrentDateString();
-    std::filesystem::create_directories(dateDir);
-
-    // Generate output filename with start and stop times
-    std::string outputFile = dateDir + "/" +
-                             formatTimestamp(startTime) + "_" +
-                             formatTimestamp(stopTime) + ".mp4";
-
-    // Replace spaces and colons in filename
-    std::replace(outputFile.begin(), outputFile.end(), ' ', '_');
-    std::replace(outputFile.begin(), outputFile.end(), ':', '-');
-
-    // Build ffmpeg command to extract, resize and recolor
-    std::stringstream cmd;
-    cmd << "ffmpeg -i \"" << sourceFile << "\" ";
-    cmd << "-ss " << startOffset << " -t " << duration << " ";
-    cmd << "-vf \"scale=640:480,hue=s=0.8\" "; // Resize and adjust color
-    cmd << "-c:v libx264 -preset fast -crf 23 ";
-    cmd << "-c:a copy -y \"" << outputFile << "\" ";
-    cmd << "2>&1";
+    // Extract, resize and recolor with the settings the load allows
+    args.insert(args.end(), {
+        "-t", toSeconds(duration),
+        "-vf", "scale=" + std::to_string(params.width) + ":" + std::to_string(params.height) + ",hue=s=0.8",
+        "-c:v", "libx264", "-preset", params.preset, "-crf", std::to_string(params.crf)});
+    if (params.threads > 0)
+    {
+        args.insert(args.end(), {"-threads", std::to_string(params.threads)});
+    }
+    args.insert(args.end(), {"-c:a", "copy", "-y", outputFile});
 
     logger_->log("Extracting segment: " + outputFile);
     logger_->log("  Start time: " + formatTimestamp(startTime));
     logger_->log("  Stop time: " + formatTimestamp(stopTime));
-    logger_->log("  Duration: " + std::to_string(duration) + " seconds");
+    logger_->log("  Duration: " + toSeconds(duration) + " seconds from " +
+                 std::to_string(sources.size()) + " source file(s)");
+    logger_->log("  Entry keyframe: " + usToSeconds(entryUs) + " s into the source, " +
+                 usToSeconds(trimUs) + " s trimmed");
+    logger_->log(std::string("  Encoding: ") + TranscodePolicy::tierName(params.tier) + " (" +
+                 params.describe() + ")");
 
-    int result = system(cmd.str().c_str());
+    int result = Process::run(args, niceness);
 
-    if (result == 0)
+    if (!concatList.empty())
     {
-        logger_->log("Successfully created segment: " + outputFile);
+        std::filesystem::remove(concatList);
     }
-    else
+
+    if (result != 0)
     {
         logger_->logError("Failed to create segment: " + outputFile);
+        return false;
+    }
+
+    // ffmpeg can exit 0 with an empty or truncated clip when the source
+    // was cut short; check what was actually written
+    Mp4Index clip;
+    if (!clip.open(outputFile) || clip.durationUs() == 0)
+    {
+        logger_->logError("Segment is not a valid MP4: " + outputFile +
+                          (clip.error().empty() ? "" : " (" + clip.error() + ")"));
+        return false;
     }
+
+    logger_->log("Successfully created segment: " + outputFile + " (" +
+                 std::to_string(clip.durationUs() / 1000) + " ms, " +
+                 std::to_string(clip.keyframesUs().size()) + " keyframes)");
+    return true;
 }
 
 // VideoControl Implementation
 
 VideoControl::VideoControl(std::shared_ptr<Logger> logger,
                            std::shared_ptr<MessageQueue<Message>> messageQueue,
-                           std::shared_ptr<MySqlComm> dbComm)
-    : logger_(logger), messageQueue_(messageQueue), dbComm_(dbComm), running_(false)
+                           std::shared_ptr<MySqlComm> dbComm,
+                           std::shared_ptr<Clock> clock)
+    : logger_(logger), messageQueue_(messageQueue), dbComm_(dbComm), clock_(clock), running_(false),
+      clipIndex_(std::make_shared<ClipIndex>()), clipServer_(logger, clipIndex_),
+      transcodePolicy_(std::make_shared<TranscodePolicy>(logger)),
+      clipJobs_(std::make_shared<ClipJobJournal>(logger)), resumeNice_(10),
+      reactor_(nullptr), pool_(nullptr)
 {
 }
 
 VideoControl::~VideoControl()
 {
     stop();
+
+    if (resumeThread_.joinable())
+    {
+        resumeThread_.join();
+    }
 }
 
 bool VideoControl::loadConfiguration()
@@ -293,39 +1138,42 @@ bool VideoControl::loadConfiguration()
         return false;
     }
     
-    const AppSettings& settings = dbComm_->getSettings();
-    
-    // Configure cameras based on database settings
-    int numDoors = settings.doors;
+    auto snapshot = dbComm_->getSettings();
+    const AppSettings& settings = *snapshot;
     
-    logger_->log("VideoControl: Configuring " + std::to_string(numDoors) + " camera(s) from database settings");
+    logger_->log("VideoControl: Configuring " + std::to_string(settings.cameras.size()) +
+                 " camera(s) for " + std::to_string(settings.doors) + " door(s) from database settings");
     
-    // Camera 0
-    if (numDoors >= 1 && !settings.cam0String.empty()) {
-        CameraConfig cam0;
-        cam0.id = 0;
-        cam0.rtspUrl = settings.cam0String;
-        cam0.enabled = true;
-        
-        auto recorder = std::make_unique<CameraRecorder>(cam0, logger_, dbComm_);
-        recorder->setDaysBeforeDeleteVideo(settings.daysBeforeDeleteVideo);
-        cameras_.push_back(std::move(recorder));
+    for (const auto& cam : settings.cameras) {
+        if (!cam.enabled || cam.rtspUrl.empty()) {
+            continue;
+        }
+        if (cam.doorId < 0 || cam.doorId >= MAX_DOORS) {
+            logger_->logError("Camera " + std::to_string(cam.id) + " has invalid door " +
+                              std::to_string(cam.doorId));
+            continue;
+        }
         
-        logger_->log("Camera 0 configured from DB: " + cam0.rtspUrl);
-    }
-    
-    // Camera 1
-    if (numDoors >= 2 && !settings.cam1String.empty()) {
-        CameraConfig cam1;
-        cam1.id = 1;
-        cam1.rtspUrl = settings.cam1String;
-        cam1.enabled = true;
+        CameraConfig config;
+        config.id = cam.id;
+        config.doorId = cam.doorId;
+        config.rtspUrl = cam.rtspUrl;
+        config.enabled = true;
         
-        auto recorder = std::make_unique<CameraRecorder>(cam1, logger_, dbComm_);
+        auto recorder = std::make_unique<CameraRecorder>(config, logger_, dbComm_, clock_);
         recorder->setDaysBeforeDeleteVideo(settings.daysBeforeDeleteVideo);
+        recorder->setClipIndex(clipIndex_);
+        recorder->setTranscodePolicy(transcodePolicy_);
+        clipIndex_->setCameraDoor(config.id, config.doorId);
+        
+        if (static_cast<size_t>(config.doorId) >= doorCameras_.size()) {
+            doorCameras_.resize(config.doorId + 1);
+        }
+        doorCameras_[config.doorId].push_back(recorder.get());
         cameras_.push_back(std::move(recorder));
         
-        logger_->log("Camera 1 configured from DB: " + cam1.rtspUrl);
+        logger_->log("Camera " + std::to_string(config.id) + " (door " +
+                     std::to_string(config.doorId) + ") configured from DB: " + config.rtspUrl);
     }
     
     if (cameras_.empty()) {
@@ -336,9 +1184,139 @@ bool VideoControl::loadConfiguration()
     return true;
 }
 
+void VideoControl::applySettings(const AppSettings &oldSettings, const AppSettings &newSettings)
+{
+    for (auto &camera : cameras_)
+    {
+        camera->setDaysBeforeDeleteVideo(newSettings.daysBeforeDeleteVideo);
+
+        auto it = std::find_if(newSettings.cameras.begin(), newSettings.cameras.end(),
+                               [&](const CameraSettings &cam)
+                               { return cam.id == camera->config().id; });
+
+        if (it == newSettings.cameras.end() || !it->enabled)
+        {
+            logger_->log("Camera " + std::to_string(camera->config().id) +
+                         " removed or disabled in settings - restart required to apply");
+            continue;
+        }
+
+        if (it->doorId != camera->config().doorId)
+        {
+            logger_->log("Camera " + std::to_string(camera->config().id) +
+                         " moved to another door - restart required to apply");
+            continue;
+        }
+
+        // Only cameras whose URL actually changed are restarted
+        camera->reconfigure(it->rtspUrl);
+    }
+
+    for (const auto &cam : newSettings.cameras)
+    {
+        bool known = std::any_of(cameras_.begin(), cameras_.end(),
+                                 [&](const std::unique_ptr<CameraRecorder> &camera)
+                                 { return camera->config().id == cam.id; });
+        if (!known && cam.enabled)
+        {
+            logger_->log("Camera " + std::to_string(cam.id) +
+                         " added in settings - restart required to apply");
+        }
+    }
+
+    if (oldSettings.daysBeforeDeleteVideo != newSettings.daysBeforeDeleteVideo)
+    {
+        logger_->log("VideoControl: daysBeforeDeleteVideo changed to " +
+                     std::to_string(newSettings.daysBeforeDeleteVideo));
+    }
+}
+
 bool VideoControl::initialize()
 {
-    return loadConfiguration();
+    if (!loadConfiguration())
+    {
+        return false;
+    }
+
+    // Pick up settings reloads; cameras_ is fixed after this point
+    dbComm_->addSettingsListener([this](const std::shared_ptr<const AppSettings> &oldSettings,
+                                        const std::shared_ptr<const AppSettings> &newSettings)
+                                 { applySettings(*oldSettings, *newSettings); });
+
+    buildClipIndex();
+
+    if (!clipJobPath_.empty() && clipJobs_->open(clipJobPath_))
+    {
+        for (auto &camera : cameras_)
+        {
+            camera->setClipJobJournal(clipJobs_);
+        }
+    }
+    return true;
+}
+
+void VideoControl::buildClipIndex()
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    for (auto &camera : cameras_)
+    {
+        clipIndex_->scanDirectory(camera->config().id, ClipIndex::Kind::Source, camera->sourceDir());
+    }
+
+    // Clips are listed in video_segments; only fall back to parsing file
+    // names when the database cannot be read
+    bool fromDb = false;
+    if (dbComm_->isConnected())
+    {
+        const size_t BATCH = 5000;
+        std::vector<StoredRecord> rows;
+        int64_t afterId = 0;
+        fromDb = true;
+        do
+        {
+            rows.clear();
+            if (!dbComm_->readVideoSegments(afterId, BATCH, rows))
+            {
+                fromDb = false;
+                break;
+            }
+            for (const auto &row : rows)
+            {
+                afterId = row.id;
+                const auto *segment = std::get_if<VideoSegmentRecord>(&row.record);
+                std::chrono::system_clock::time_point start, stop;
+                if (!segment || !parseTimestamp(segment->startTime, start) || !parseTimestamp(segment->stopTime, stop))
+                {
+                    continue;
+                }
+                bool known = std::any_of(cameras_.begin(), cameras_.end(),
+                                         [&](const std::unique_ptr<CameraRecorder> &camera)
+                                         { return camera->config().id == segment->cameraId; });
+                if (known)
+                {
+                    clipIndex_->add({segment->cameraId, ClipIndex::Kind::Clip, ClipIndex::wallUs(start),
+                                     ClipIndex::wallUs(stop), segment->filename});
+                }
+            }
+        } while (rows.size() == BATCH);
+    }
+
+    if (!fromDb)
+    {
+        for (auto &camera : cameras_)
+        {
+            // Drop whatever a failed database read added before scanning
+            clipIndex_->removeBefore(camera->config().id, ClipIndex::Kind::Clip, ClipIndex::OPEN_END);
+            clipIndex_->scanDirectory(camera->config().id, ClipIndex::Kind::Clip, camera->outputDir());
+        }
+    }
+
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+    logger_->log("VideoControl: Clip index built from " + std::string(fromDb ? "database" : "disk") + ": " + std::to_string(clipIndex_->size()) +
+                 " file(s) in " + std::to_string(elapsedMs) + " ms");
 }
 
 void VideoControl::start()
@@ -348,37 +1326,194 @@ void VideoControl::start()
     // Start all camera recorders
     for (auto &camera : cameras_)
     {
+        camera->setReactor(reactor_, pool_);
         camera->start();
     }
 
-    // Start message processing thread
-    messageThread_ = std::thread(&VideoControl::messageLoop, this);
+    if (reactor_)
+    {
+        // Each push wakes the loop, which takes everything queued so far
+        messageQueue_->setPushListener([this]()
+                                       { reactor_->post([this]()
+                                                        { drainMessages(); }); });
+        reactor_->post([this]()
+                       { drainMessages(); });
+    }
+    else
+    {
+        // Start message processing thread
+        messageThread_ = std::thread(&VideoControl::messageLoop, this);
+    }
+
+    if (!clipSocketPath_.empty())
+    {
+        clipServer_.start(clipSocketPath_);
+    }
+
+    std::vector<ClipJobJournal::Job> unfinished = clipJobs_->takePending();
+    if (!unfinished.empty())
+    {
+        resumeThread_ = std::thread(&VideoControl::resumeClipJobs, this, std::move(unfinished));
+    }
 
     logger_->log("VideoControl started");
 }
 
-void VideoControl::stop()
+void VideoControl::resumeClipJobs(std::vector<ClipJobJournal::Job> jobs)
+{
+    // One at a time in the background, so live clips and recording keep
+    // their share of the CPU and disk
+    size_t done = 0;
+    for (const auto &job : jobs)
+    {
+        if (!running_)
+            break;
+
+        auto camera = std::find_if(cameras_.begin(), cameras_.end(),
+                                   [&](const std::unique_ptr<CameraRecorder> &recorder)
+                                   { return recorder->config().id == job.cameraId; });
+        if (camera == cameras_.end())
+        {
+            logger_->log("VideoControl: Dropping clip job " + job.outputFile + " of unknown camera " +
+                         std::to_string(job.cameraId));
+            clipJobs_->finished(job.outputFile);
+            continue;
+        }
+
+        // Written and logged before the stop, but not marked finished
+        auto clips = clipIndex_->query(job.cameraId, job.startUs, job.stopUs, false);
+        if (std::any_of(clips.begin(), clips.end(), [&](const ClipIndex::Entry &entry)
+                        { return entry.path == job.outputFile; }) &&
+            std::filesystem::exists(job.outputFile))
+        {
+            clipJobs_->finished(job.outputFile);
+            continue;
+        }
+
+        auto toInstant = [](int64_t us)
+        {
+            return Timeline::fromWall(std::chrono::system_clock::time_point(std::chrono::microseconds(us)));
+        };
+        ClipJob clip{{job.doorId, toInstant(job.startUs), toInstant(job.stopUs)}, job.outputFile, resumeNice_};
+        logger_->log("VideoControl: Resuming clip job " + job.outputFile + " (attempt " +
+                     std::to_string(job.attempts + 1) + ")");
+        (*camera)->resumeClipJob(clip);
+        done++;
+    }
+
+    logger_->log("VideoControl: Resumed " + std::to_string(done) + " of " + std::to_string(jobs.size()) +
+                 " unfinished clip job(s)");
+}
+
+void VideoControl::stop(std::chrono::steady_clock::time_point deadline)
 {
     if (running_)
     {
         running_ = false;
+        messageQueue_->setPushListener(nullptr);
         messageQueue_->requestShutdown();
+        clipServer_.stop();
 
         if (messageThread_.joinable())
         {
             messageThread_.join();
         }
 
-        // Stop all camera recorders
+        // Stop all camera recorders in parallel so each ffmpeg gets the
+        // whole time budget to finalize its file
+        std::vector<std::thread> stoppers;
         for (auto &camera : cameras_)
         {
-            camera->stop();
+            stoppers.emplace_back([&camera, deadline]()
+                                  { camera->stop(deadline); });
+        }
+        for (auto &stopper : stoppers)
+        {
+            stopper.join();
         }
 
         logger_->log("VideoControl stopped");
     }
 }
 
+int VideoControl::waitForPendingJobs(std::chrono::steady_clock::time_point deadline)
+{
+    int pending = 0;
+    for (auto &camera : cameras_)
+    {
+        pending += camera->waitForJobs(deadline);
+    }
+    return pending;
+}
+
+void VideoControl::setPowerMode(const PowerModeMessage &power)
+{
+    if (power.mode == PowerMode::Active)
+    {
+        for (auto &camera : cameras_)
+        {
+            camera->resume(power.since);
+        }
+        return;
+    }
+
+    if (reactor_)
+    {
+        // pause() only signals ffmpeg here; the loop must not wait for it
+        for (auto &camera : cameras_)
+        {
+            camera->pause();
+        }
+    }
+    else
+    {
+        // Each ffmpeg finalizes its file in parallel, as in stop()
+        std::vector<std::thread> pausers;
+        for (auto &camera : cameras_)
+        {
+            if (!camera->isPaused())
+            {
+                pausers.emplace_back([&camera]()
+                                     { camera->pause(); });
+            }
+        }
+        for (auto &pauser : pausers)
+        {
+            pauser.join();
+        }
+    }
+
+    // Deferred work runs on mains power only
+    if (power.mode == PowerMode::Parked)
+    {
+        for (auto &camera : cameras_)
+        {
+            camera->cleanupSoon();
+        }
+    }
+
+    // Get the finalized recordings and buffered writes onto the SD card
+    // while there is power; not on the loop or message thread, which must
+    // stay free to wake up
+    if (reactor_)
+    {
+        // After the paused recorders have had their time to finalize
+        WorkerPool *pool = pool_;
+        reactor_->addTimer(std::chrono::steady_clock::now() + CameraRecorder::STOP_TIMEOUT, [pool]()
+                           { pool->submit([]()
+                                          { ::sync(); }); });
+    }
+    else
+    {
+        std::thread([]()
+                    { ::sync(); })
+            .detach();
+    }
+
+    logger_->log("VideoControl: " + std::string(powerModeName(power.mode)) + ", recording paused" +
+                 (power.mode == PowerMode::Parked ? ", running retention" : ""));
+}
+
 void VideoControl::messageLoop()
 {
     while (running_)
@@ -387,40 +1522,82 @@ void VideoControl::messageLoop()
 
         if (msgOpt.has_value())
         {
-            Message msg = msgOpt.value();
+            handleMessage(msgOpt.value());
+        }
+    }
+}
 
-            switch (msg.type)
-            {
-            case MessageType::StartStop:
+void VideoControl::drainMessages()
+{
+    while (running_)
+    {
+        auto msgOpt = messageQueue_->tryPop(std::chrono::milliseconds(0));
+        if (!msgOpt.has_value())
+            break;
+        handleMessage(msgOpt.value());
+    }
+}
+
+void VideoControl::handleMessage(const Message &msg)
+{
+    switch (msg.type)
+    {
+    case MessageType::StartStop:
+    {
+        auto startStop = std::get<StartStopMessage>(msg.data);
+        int doorId = startStop.doorId;
+
+        if (doorId >= 0 && static_cast<size_t>(doorId) < doorCameras_.size() &&
+            !doorCameras_[doorId].empty())
+        {
+            // The message now contains start_date_time and stop_date_time
+            // with delays already applied by MainControl
+            for (auto* camera : doorCameras_[doorId])
             {
-                auto startStop = std::get<StartStopMessage>(msg.data);
-                int camId = startStop.cameraId;
+                camera->processStartStopMessage(startStop);
 
-                if (camId >= 0 && static_cast<size_t>(camId) < cameras_.size())
-                {
-                    // The message now contains start_date_time and stop_date_time
-                    // with delays already applied by MainControl
-                    cameras_[camId]->processStartStopMessage(startStop);
-
-                    logger_->log("Processed StartStop for Camera " +
-                                 std::to_string(camId) + 
-                                 " - Start: " + formatTimestamp(startStop.startTime) +
-                                 " Stop: " + formatTimestamp(startStop.stopTime));
-                }
-                else
+                logger_->log("Processed StartStop for Camera " +
+                             std::to_string(camera->config().id) +
+                             " (door " + std::to_string(doorId) + ")" +
+                             " - Start: " + formatTimestamp(startStop.startTime) +
+                             " Stop: " + formatTimestamp(startStop.stopTime));
+            }
+        }
+        else
+        {
+            logger_->logError("No camera configured for door " + std::to_string(doorId));
+        }
+        break;
+    }
+
+    case MessageType::PeripheralCommand:
+    {
+        // Camera power-on from MainControl: the door's recorders retry now
+        // instead of waiting out a backoff started while the camera was off
+        auto command = std::get<PeripheralCommand>(msg.data);
+        for (size_t door = 0; door < doorCameras_.size(); door++)
+        {
+            auto cmds = doorCommands(static_cast<int>(door));
+            if (cmds && cmds->camOn == command)
+            {
+                for (auto* camera : doorCameras_[door])
                 {
-                    logger_->logError("Invalid camera ID: " + std::to_string(camId));
+                    camera->powerOn();
                 }
-                break;
             }
+        }
+        break;
+    }
 
-            case MessageType::Shutdown:
-                running_ = false;
-                break;
+    case MessageType::PowerMode:
+        setPowerMode(std::get<PowerModeMessage>(msg.data));
+        break;
 
-            default:
-                break;
-            }
-        }
+    case MessageType::Shutdown:
+        running_ = false;
+        break;
+
+    default:
+        break;
     }
 }
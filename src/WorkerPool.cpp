@@ -0,0 +1,63 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(std::shared_ptr<Logger> logger, size_t threads, size_t maxQueued)
+    : logger_(logger), maxQueued_(maxQueued), stopping_(false)
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+    {
+        threads_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+bool WorkerPool::submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (jobs_.size() >= maxQueued_)
+        {
+            logger_->logError("WorkerPool: Queue full (" + std::to_string(maxQueued_) + " jobs), job dropped");
+            return false;
+        }
+        jobs_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+size_t WorkerPool::queued() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+void WorkerPool::workerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
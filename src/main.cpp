@@ -1,59 +1,464 @@
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
+#include <pthread.h>
 #include <memory>
 #include <atomic>
+#include <filesystem>
+#include <cstring>
+#include <map>
+#include <algorithm>
 #include "Common.h"
 #include "Logger.h"
 #include "MessageQueue.h"
 #include "MainControl.h"
 #include "VideoControl.h"
 #include "MySqlComm.h"
+#include "ConfigIni.h"
+#include "InitGraph.h"
+#include "ShutdownCoordinator.h"
+#include "Mp4Index.h"
+#include "Replay.h"
+#include "StorageBackend.h"
+#include "Reactor.h"
+#include "WorkerPool.h"
+#include "StatusShm.h"
+#include "StatusJournal.h"
+#include <fstream>
 
-std::atomic<bool> g_running(true);
+// passflow --mp4-index FILE: print what the built-in MP4 reader sees and
+// how long it took (compare with `time ffprobe -show_packets FILE`)
+static int printMp4Index(const char *path)
+{
+    auto begin = std::chrono::steady_clock::now();
+    Mp4Index index;
+    bool ok = index.open(path);
+    auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+
+    if (!ok)
+    {
+        std::cerr << "mp4-index: " << index.error() << std::endl;
+        return 1;
+    }
+
+    std::cout << "file: " << path << std::endl;
+    std::cout << "fragmented: " << (index.fragmented() ? "yes" : "no")
+              << " (" << index.fragmentCount() << " fragments)" << std::endl;
+    std::cout << "duration_us: " << index.durationUs() << std::endl;
+    std::cout << "creation_time_us: " << index.creationTimeUs() << std::endl;
+    for (const auto &entry : index.tracks())
+    {
+        const Mp4Index::Track &track = entry.second;
+        std::cout << "track " << track.id << ": " << track.handler << " " << track.codec;
+        if (track.width)
+            std::cout << " " << track.width << "x" << track.height;
+        std::cout << ", " << track.sampleCount << " samples, "
+                  << track.keyframes.size() << " keyframes" << std::endl;
+    }
+
+    std::vector<int64_t> keyframes = index.keyframesUs();
+    std::cout << "keyframes_us:";
+    for (size_t i = 0; i < keyframes.size() && i < 20; i++)
+        std::cout << " " << keyframes[i];
+    if (keyframes.size() > 20)
+        std::cout << " ...";
+    std::cout << std::endl;
+    std::cout << "parse_time_us: " << elapsedUs << std::endl;
+    return 0;
+}
+
+// Resident set size in kB from /proc/<pid>/status (0 if unavailable)
+static long readRssKb(const std::string &statusPath)
+{
+    std::ifstream status(statusPath);
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// RSS of a running MariaDB/MySQL server, found by process name
+static long readDbServerRssKb()
+{
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator("/proc", ec))
+    {
+        std::ifstream comm(entry.path() / "comm");
+        std::string name;
+        if (std::getline(comm, name) && (name == "mariadbd" || name == "mysqld"))
+            return readRssKb((entry.path() / "status").string());
+    }
+    return 0;
+}
+
+// passflow --db-bench N: write N events through the configured storage
+// backend and report throughput and memory (client and database server)
+static int runDbBench(long count, const ConfigIni &config)
+{
+    auto logger = std::make_shared<Logger>(
+        config.getString("System", "LogDirectory", "~/PassFlow/Log") + "/bench");
+    std::unique_ptr<StorageBackend> backend = StorageBackend::create(config, logger);
+    if (!backend->connect())
+    {
+        std::cerr << "db-bench: cannot connect to " << backend->name() << " backend" << std::endl;
+        return 1;
+    }
+
+    long rssBefore = readRssKb("/proc/self/status");
+    auto begin = std::chrono::steady_clock::now();
+    long failed = 0;
+    for (long i = 0; i < count; i++)
+    {
+        EventRecord record{static_cast<int>(i % 8), "Bench event " + std::to_string(i),
+                           formatTimestamp(std::chrono::system_clock::now())};
+        if (backend->write(record) != WriteStatus::Ok)
+            failed++;
+    }
+    if (!backend->flush())
+        failed++;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "backend: " << backend->name() << std::endl;
+    std::cout << "rows: " << count << " (" << failed << " failed)" << std::endl;
+    std::cout << "seconds: " << seconds << std::endl;
+    std::cout << "rows_per_second: " << static_cast<long>(count / (seconds > 0 ? seconds : 1e-9)) << std::endl;
+    std::cout << "client_rss_kb: " << readRssKb("/proc/self/status")
+              << " (+" << readRssKb("/proc/self/status") - rssBefore << ")" << std::endl;
+    std::cout << "server_rss_kb: " << readDbServerRssKb() << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+// passflow --replicate: one replication pass to every remoteDB address,
+// then print each remote's marks and lag
+static int runReplicationPass(const ConfigIni &config)
+{
+    auto logger = std::make_shared<Logger>(config.getString("System", "LogDirectory", "~/PassFlow/Log"));
+    MySqlComm dbComm(logger);
+    dbComm.configure(config);
+    if (!dbComm.initialize())
+    {
+        std::cerr << "replicate: cannot load settings from the " << dbComm.backendName() << " database" << std::endl;
+        return 1;
+    }
+
+    bool caughtUp = dbComm.replicateOnce();
+    for (const auto &remote : dbComm.replicationStatus())
+    {
+        std::cout << remote.address << ": " << (remote.connected ? "connected" : "unreachable")
+                  << ", events<=" << remote.eventsMark << ", segments<=" << remote.segmentsMark
+                  << ", pushed " << remote.rowsPushed << ", behind " << remote.rowsBehind << " rows";
+        if (!remote.lastError.empty())
+            std::cout << " (" << remote.lastError << ")";
+        std::cout << std::endl;
+    }
+    return caughtUp ? 0 : 1;
+}
 
-void signalHandler(int signal)
+// passflow --door-stats YYYY-MM-DD: door activity of one day from the
+// door_stats summary, per bucket and per door
+static int printDoorStats(const std::string &day, const ConfigIni &config)
 {
-    std::cout << "\nReceived signal " << signal << ", shutting down..." << std::endl;
-    g_running = false;
+    std::chrono::system_clock::time_point dayStart;
+    if (!parseTimestamp(day + " 00:00:00.000", dayStart))
+    {
+        std::cerr << "door-stats: expected YYYY-MM-DD, got " << day << std::endl;
+        return 1;
+    }
+
+    auto logger = std::make_shared<Logger>(config.getString("System", "LogDirectory", "~/PassFlow/Log"));
+    MySqlComm dbComm(logger);
+    dbComm.configure(config);
+    // 36 hours on is always the next calendar day, DST change or not
+    std::string nextDay = formatTimestamp(dayStart + std::chrono::hours(36)).substr(0, 10);
+    std::vector<DoorStatsRecord> rows;
+    if (!dbComm.initialize() || !dbComm.readDoorStats(day + " 00:00:00", nextDay + " 00:00:00", rows))
+    {
+        std::cerr << "door-stats: cannot read door_stats from the " << dbComm.backendName() << " database" << std::endl;
+        return 1;
+    }
+
+    struct DayTotal
+    {
+        int opens = 0;
+        int64_t openMs = 0;
+        int64_t maxOpenMs = 0;
+        int coverOpens = 0;
+    };
+    std::map<int, DayTotal> totals;
+
+    std::cout << "bucket\t\t\tdoor\topens\topen_s\tmax_s\tcover_opens" << std::endl;
+    for (const auto &row : rows)
+    {
+        std::cout << row.bucketStart << '\t' << row.door << '\t' << row.openCount << '\t'
+                  << row.openMs / 1000 << '\t' << row.maxOpenMs / 1000 << '\t' << row.coverOpenCount << std::endl;
+        DayTotal &total = totals[row.door];
+        total.opens += row.openCount;
+        total.openMs += row.openMs;
+        total.maxOpenMs = std::max(total.maxOpenMs, row.maxOpenMs);
+        total.coverOpens += row.coverOpenCount;
+    }
+    for (const auto &entry : totals)
+    {
+        std::cout << day << " total\t" << entry.first << '\t' << entry.second.opens << '\t'
+                  << entry.second.openMs / 1000 << '\t' << entry.second.maxOpenMs / 1000 << '\t'
+                  << entry.second.coverOpens << std::endl;
+    }
+    return 0;
+}
+
+// passflow --clips "door=1 at=14:32": ask the running daemon which
+// recorded files cover a time window
+static int runClipQuery(const std::string &request, const ConfigIni &config)
+{
+    std::string socketPath = expandHomePath(config.getString("ClipIndex", "Socket", "~/PassFlow/clips.sock"));
+    std::string reply;
+    if (!ClipQueryServer::query(socketPath, request, reply))
+    {
+        std::cerr << "clips: no answer on " << socketPath << " (is passflow running?)" << std::endl;
+        return 1;
+    }
+    std::cout << reply;
+
+    // The last line is "OK <count> <us>" or "ERR <reason>"
+    size_t lastLine = reply.rfind('\n', reply.size() - 2);
+    lastLine = lastLine == std::string::npos ? 0 : lastLine + 1;
+    return reply.compare(lastLine, 3, "OK ") == 0 ? 0 : 1;
+}
+
+// passflow --status: read the live status the running daemon publishes in
+// shared memory, the way the display and diagnostics tools do
+static int printLiveStatus(const ConfigIni &config)
+{
+    std::string name = config.getString("Status", "SharedMemory", "/passflow-status");
+    StatusShmReader reader;
+    StatusShmData data;
+    if (name.empty() || !reader.open(name) || !reader.read(data))
+    {
+        std::cerr << "status: no status segment " << name << " (is passflow running?)" << std::endl;
+        return 1;
+    }
+
+    // Average over many reads; a single one is below the clock resolution
+    const int reads = 1000000;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < reads; i++)
+    {
+        reader.read(data);
+    }
+    auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+
+    auto wallText = [](int64_t us)
+    {
+        return formatTimestamp(std::chrono::system_clock::time_point(std::chrono::microseconds(us)));
+    };
+
+    std::cout << "running\t" << (data.running ? "yes" : "no") << std::endl;
+    std::cout << "link\t" << (data.linkUp ? "up" : "down") << " (" << data.linkLosses << " loss(es))" << std::endl;
+    std::cout << "status\t0x" << std::hex << static_cast<int>(data.status) << std::dec << std::endl;
+    std::cout << "frames\t" << data.frames << std::endl;
+    std::cout << "updated\t" << wallText(data.updatedWallUs) << std::endl;
+    for (int door = 0; door < data.doorCount && door < MAX_DOORS; door++)
+    {
+        std::cout << "door " << door << "\t"
+                  << (data.doorOpenedWallUs[door] ? "open since " + wallText(data.doorOpenedWallUs[door]) : "closed")
+                  << ", " << data.doorOpenCount[door] << " opening(s)" << std::endl;
+    }
+    std::cout << "read\t" << elapsedNs / reads << " ns" << std::endl;
+    return 0;
+}
+
+// passflow --journal FILE: chunk index and decode speed of a status
+// journal; --journal-dump FILE prints it in the log format --replay reads
+static int printStatusJournal(const char *path, bool dump)
+{
+    StatusJournalReader reader;
+    if (!reader.open(path))
+    {
+        std::cerr << "journal: " << path << ": " << reader.error() << std::endl;
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<StatusJournalReader::Entry> entries;
+    entries.reserve(reader.entryCount());
+    reader.read(entries);
+    auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+
+    auto wallText = [](int64_t ms)
+    {
+        return formatTimestamp(std::chrono::system_clock::time_point(std::chrono::milliseconds(ms)));
+    };
+
+    if (dump)
+    {
+        for (const auto &entry : entries)
+        {
+            std::cout << wallText(entry.wallMs) << " - Received valid SystemStatus: 0x"
+                      << "0123456789ABCDEF"[entry.status >> 4] << "0123456789ABCDEF"[entry.status & 0x0F] << '\n';
+        }
+        return 0;
+    }
+
+    uint64_t payload = 0;
+    std::cout << "chunk\tentries\tbytes\tfirst\t\t\t\tlast" << std::endl;
+    for (size_t i = 0; i < reader.chunks().size(); i++)
+    {
+        const auto &chunk = reader.chunks()[i];
+        payload += chunk.bytes;
+        std::cout << i << '\t' << chunk.count << '\t' << chunk.bytes << '\t' << wallText(chunk.firstMs) << '\t'
+                  << wallText(chunk.lastMs) << (chunk.open ? "\t(open)" : "") << std::endl;
+    }
+    std::cout << "entries: " << entries.size() << " in " << reader.chunks().size() << " chunk(s)";
+    if (!entries.empty())
+        std::cout << ", " << static_cast<double>(payload) / entries.size() << " bytes/entry";
+    std::cout << std::endl;
+    std::cout << "decoded in " << elapsedUs << " us";
+    if (elapsedUs > 0)
+        std::cout << " (" << static_cast<uint64_t>(entries.size()) * 1000000 / elapsedUs << " entries/s)";
+    std::cout << std::endl;
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
+    if (argc == 3 && std::strcmp(argv[1], "--mp4-index") == 0)
+    {
+        return printMp4Index(argv[2]);
+    }
+
+    if (argc == 3 && std::strcmp(argv[1], "--replay") == 0)
+    {
+        // Recorded SystemStatus traffic through MainControl on a simulated clock
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return Replay::run(argv[2], config);
+    }
+
+    if (argc == 3 && std::strcmp(argv[1], "--db-bench") == 0)
+    {
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return runDbBench(std::atol(argv[2]), config);
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--replicate") == 0)
+    {
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return runReplicationPass(config);
+    }
+
+    if (argc == 3 && std::strcmp(argv[1], "--door-stats") == 0)
+    {
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return printDoorStats(argv[2], config);
+    }
+
+    if (argc == 3 && std::strcmp(argv[1], "--clips") == 0)
+    {
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return runClipQuery(argv[2], config);
+    }
+
+    if (argc == 3 && (std::strcmp(argv[1], "--journal") == 0 || std::strcmp(argv[1], "--journal-dump") == 0))
+    {
+        return printStatusJournal(argv[2], std::strcmp(argv[1], "--journal-dump") == 0);
+    }
+
+    if (argc == 2 && std::strcmp(argv[1], "--status") == 0)
+    {
+        ConfigIni config;
+        config.load(expandHomePath("~/PassFlow/config.ini"));
+        return printLiveStatus(config);
+    }
+
+    processStartTime();
     std::cout << "PassFlow System Starting..." << std::endl;
 
-    // Setup signal handlers
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // Block SIGINT/SIGTERM before any thread exists; the main thread
+    // receives them synchronously with sigwait() and reacts immediately
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
 
     try
     {
+        // Local configuration (optional)
+        ConfigIni config;
+        bool haveConfig = config.load(expandHomePath("~/PassFlow/config.ini"));
+
         // Create shared logger
-        auto logger = std::make_shared<Logger>();
+        auto logger = std::make_shared<Logger>(config.getString("System", "LogDirectory", "~/PassFlow/Log"));
         logger->log("=== PassFlow System Started ===");
+        if (!haveConfig)
+        {
+            logger->log("No config.ini found, using built-in defaults");
+        }
 
         // Create MySqlComm module for database communication
-        // This reads all settings from MariaDB on startup
+        // Settings come from the local cache (or config.ini) so recording can
+        // start immediately; the database is reconciled in the background
         std::cout << "Initializing MySqlComm..." << std::endl;
         auto dbComm = std::make_shared<MySqlComm>(logger);
-        
-        if (!dbComm->initialize())
+        dbComm->configure(config);
+
+        if (!dbComm->loadLocalSettings(config))
         {
-            std::cerr << "Failed to initialize MySqlComm - database connection failed" << std::endl;
-            logger->logError("Failed to initialize database connection");
-            return 1;
+            // First boot without cache or cameras in config.ini: the database is required
+            logger->log("No local settings available, waiting for database");
+            if (!dbComm->initialize())
+            {
+                std::cerr << "Failed to initialize MySqlComm - database connection failed" << std::endl;
+                logger->logError("Failed to initialize database connection");
+                return 1;
+            }
         }
         
-        // Get settings from database
-        const AppSettings& settings = dbComm->getSettings();
-        logger->log("Settings loaded from database:");
+        // Get current settings snapshot
+        auto snapshot = dbComm->getSettings();
+        const AppSettings& settings = *snapshot;
+        logger->log("Settings loaded:");
         logger->log("  - doors: " + std::to_string(settings.doors));
         logger->log("  - stopBeginDelay: " + std::to_string(settings.stopBeginDelay) + "s");
         logger->log("  - stopEndDelay: " + std::to_string(settings.stopEndDelay) + "s");
         logger->log("  - daysBeforeDeleteVideo: " + std::to_string(settings.daysBeforeDeleteVideo));
-        logger->log("  - cam0_string: " + settings.cam0String);
-        logger->log("  - cam1_string: " + settings.cam1String);
+        logger->log("  - cameras: " + std::to_string(settings.cameras.size()));
         logger->log("  - Remote DB addresses: " + std::to_string(settings.remoteDBAddresses.size()));
 
+        // Optional single-threaded runtime for low-memory boards: serial,
+        // queue, child exits, timers and signals on the main thread, clip
+        // transcodes on a small pool
+        std::unique_ptr<Reactor> reactor;
+        std::unique_ptr<WorkerPool> workerPool;
+        if (config.getString("System", "Runtime", "threads") == "reactor")
+        {
+            reactor = std::make_unique<Reactor>(logger);
+            if (!reactor->valid())
+            {
+                logger->logError("Reactor runtime unavailable, using threads");
+                reactor.reset();
+            }
+            else
+            {
+                int workers = std::max(config.getInt("System", "WorkerThreads", 1), 1);
+                workerPool = std::make_unique<WorkerPool>(logger, workers);
+                logger->log("Runtime: reactor with " + std::to_string(workers) + " worker thread(s)");
+            }
+        }
+
         // Create message queue for VideoControl
         auto videoControlQueue = std::make_shared<MessageQueue<Message>>();
 
@@ -62,48 +467,210 @@ int main(int argc, char *argv[])
         
         // Update MainControl with delay settings from database
         mainControl->updateSettings(settings.stopBeginDelay, settings.stopEndDelay);
+        mainControl->configureDoors(settings.doors, settings.statusBits);
+        mainControl->setGlitchThreshold(std::chrono::milliseconds(config.getInt("System", "DoorGlitchMs", 300)));
+        mainControl->setLowPowerAfter(std::chrono::seconds(config.getInt("Power", "LowPowerAfterSeconds", 120)));
+        mainControl->setStatsBucket(std::chrono::minutes(config.getInt("Stats", "BucketMinutes", 60)));
+        mainControl->setReactor(reactor.get());
+        std::string statusShm = config.getString("Status", "SharedMemory", "/passflow-status");
+        if (!statusShm.empty())
+        {
+            mainControl->setStatusSharedMemory(statusShm);
+        }
+        std::string journalPath = config.getString("Journal", "Path", "~/PassFlow/status.journal");
+        if (!journalPath.empty())
+        {
+            mainControl->setStatusJournal(expandHomePath(journalPath));
+        }
 
         // Create VideoControl block with database connection
         auto videoControl = std::make_unique<VideoControl>(logger, videoControlQueue, dbComm);
+        videoControl->setClipQuerySocket(
+            expandHomePath(config.getString("ClipIndex", "Socket", "~/PassFlow/clips.sock")));
+        videoControl->setClipJobJournal(
+            expandHomePath(config.getString("ClipJobs", "Journal", "~/PassFlow/clipjobs.journal")),
+            config.getInt("ClipJobs", "ResumeNice", 10));
+        videoControl->setReactor(reactor.get(), workerPool.get());
+        TranscodePolicy::Params fullQuality;
+        fullQuality.preset = config.getString("Video", "VideoPreset", "fast");
+        fullQuality.crf = config.getInt("Video", "VideoCRF", 23);
+        fullQuality.width = config.getInt("Video", "OutputWidth", 640);
+        fullQuality.height = config.getInt("Video", "OutputHeight", 480);
+        videoControl->configureTranscode(fullQuality, config.getBool("Video", "AdaptiveTranscode", true));
 
-        // Initialize components
-        std::cout << "Initializing MainControl..." << std::endl;
-        if (!mainControl->initialize())
-        {
-            std::cerr << "Failed to initialize MainControl" << std::endl;
-            return 1;
-        }
+        // Apply delay changes from later settings reloads; the door layout
+        // is fixed for the lifetime of the process
+        MainControl *mainControlPtr = mainControl.get();
+        dbComm->addSettingsListener(
+            [mainControlPtr, logger](const std::shared_ptr<const AppSettings> &oldSettings,
+                                     const std::shared_ptr<const AppSettings> &newSettings)
+            {
+                mainControlPtr->updateSettings(newSettings->stopBeginDelay, newSettings->stopEndDelay);
+
+                if (oldSettings->doors != newSettings->doors ||
+                    oldSettings->statusBits != newSettings->statusBits)
+                {
+                    logger->log("Door layout changed in settings - restart required to apply");
+                }
+            });
+
+        // Bring up independent components concurrently; recording starts as
+        // soon as the cameras are configured, without waiting for the serial port
+        std::cout << "Initializing components..." << std::endl;
+        InitGraph init(logger);
+
+        init.add("directories", {}, [&]()
+                 {
+                     for (const auto &cam : settings.cameras)
+                     {
+                         std::string base = expandHomePath("~/PassFlow/Cam") + std::to_string(cam.id);
+                         std::filesystem::create_directories(base);
+                         std::filesystem::create_directories(base + "Source");
+                     }
+                     return true;
+                 });
+
+        init.add("serial", {}, [&]()
+                 { return mainControl->initialize(); });
+
+        init.add("video.init", {"directories"}, [&]()
+                 { return videoControl->initialize(); });
+
+        init.add("video.start", {"video.init"}, [&]()
+                 {
+                     videoControl->start();
+                     return true;
+                 });
+
+        init.add("control.start", {"serial"}, [&]()
+                 {
+                     mainControl->start();
+                     return true;
+                 });
+
+        // Connect to the database in the background and watch
+        // settings.updated_at for hot reloads
+        init.add("db.watcher", {}, [&]()
+                 {
+                     dbComm->startSettingsWatcher(std::chrono::seconds(10));
+                     dbComm->startReplication();
+                     dbComm->startUploads();
+                     return true;
+                 },
+                 false);
+
+        bool initialized = init.run();
+        init.logReport();
 
-        std::cout << "Initializing VideoControl..." << std::endl;
-        if (!videoControl->initialize())
+        if (!initialized)
         {
-            std::cerr << "Failed to initialize VideoControl" << std::endl;
+            std::cerr << "Failed to initialize components" << std::endl;
+            logger->logError("Component initialization failed");
+            dbComm->stopSettingsWatcher();
+            dbComm->stopReplication();
+            dbComm->stopUploads();
+            mainControl->stop();
+            videoControl->stop();
             return 1;
         }
 
-        // Start components
-        std::cout << "Starting components..." << std::endl;
-        videoControl->start();
-        mainControl->start();
-
         logger->log("All components started successfully");
         std::cout << "PassFlow System running. Press Ctrl+C to stop." << std::endl;
 
-        // Main loop
-        while (g_running)
+        // Main loop: sleep until a shutdown signal arrives, or run the
+        // reactor until one does
+        int signal = 0;
+        if (reactor)
+        {
+            reactor->addSignals(shutdownSignals, [&](int received)
+                                {
+                                    signal = received;
+                                    reactor->stop();
+                                });
+            reactor->run();
+        }
+        else
         {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            sigwait(&shutdownSignals, &signal);
         }
+        std::cout << "\nReceived signal " << signal << ", shutting down..." << std::endl;
 
-        // Shutdown
+        // Shutdown: stop everything in parallel, then flush in priority order,
+        // all within the supercap budget
         std::cout << "Shutting down components..." << std::endl;
         logger->log("Shutdown initiated");
 
-        mainControl->stop();
-        videoControl->stop();
+        ShutdownCoordinator shutdown(logger);
+        shutdown.add("MainControl", 0, [&](ShutdownCoordinator::Deadline)
+                     {
+                         mainControl->stop();
+                         return true;
+                     });
+        shutdown.add("VideoControl", 0, [&](ShutdownCoordinator::Deadline deadline)
+                     {
+                         videoControl->stop(deadline);
+                         return true;
+                     });
+        shutdown.add("settings watcher", 0, [&](ShutdownCoordinator::Deadline)
+                     {
+                         dbComm->stopSettingsWatcher();
+                         return true;
+                     });
+        shutdown.add("replication", 0, [&](ShutdownCoordinator::Deadline)
+                     {
+                         dbComm->stopReplication();
+                         return true;
+                     });
+        shutdown.add("uploads", 0, [&](ShutdownCoordinator::Deadline)
+                     {
+                         dbComm->stopUploads();
+                         return true;
+                     });
+        shutdown.add("DB spool", 1, [&](ShutdownCoordinator::Deadline)
+                     {
+                         dbComm->flushPendingWrites();
+                         size_t pending = dbComm->pendingWriteCount();
+                         if (pending > 0)
+                         {
+                             logger->logError("Shutdown: " + std::to_string(pending) + " DB write(s) not persisted");
+                         }
+                         return pending == 0;
+                     });
+        shutdown.add("clip jobs", 2, [&](ShutdownCoordinator::Deadline deadline)
+                     {
+                         int pending = videoControl->waitForPendingJobs(deadline);
+                         if (pending > 0)
+                         {
+                             logger->logError("Shutdown: " + std::to_string(pending) + " clip job(s) unfinished");
+                         }
+
+                         // Segments logged by the jobs that just finished
+                         // were spooled after the "DB spool" flush
+                         dbComm->flushPendingWrites();
+                         size_t spooled = dbComm->pendingWriteCount();
+                         if (spooled > 0)
+                         {
+                             logger->logError("Shutdown: " + std::to_string(spooled) + " DB write(s) not persisted");
+                         }
+                         return pending == 0 && spooled == 0;
+                     });
+
+        auto budget = std::chrono::milliseconds(config.getInt("System", "ShutdownBudgetMs", 4000));
+        auto unfinished = shutdown.run(budget);
 
         logger->log("=== PassFlow System Stopped ===");
+        logger->flush();
         std::cout << "PassFlow System stopped." << std::endl;
+
+        if (!unfinished.empty())
+        {
+            // Abandoned tasks may still be using the components; skip their
+            // destructors rather than block past the power budget
+            std::_Exit(1);
+        }
+
+        // Pool jobs still queued (cleanup) use the cameras: finish them first
+        workerPool.reset();
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+PassFlow Depot Test Server
+
+Stands in for the depot's clip upload endpoint ([Upload] URL) and
+implements the resumable protocol of ClipUploader: HEAD reports the bytes
+held in Upload-Offset, PATCH appends a chunk after checking its offset
+and CRC-32, and the last chunk is checked against the whole-file CRC-32.
+Finished clips are stored under the root directory by their URL path.
+
+Usage:
+    python3 test_depot.py [--port 8080] [--root ./depot] [--cut-every N]
+
+    --cut-every N   drop the connection in the middle of every Nth chunk,
+                    to watch uploads resume
+"""
+
+import argparse
+import os
+import socket
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class DepotHandler(BaseHTTPRequestHandler):
+    """One clip per URL path; partial uploads are kept as <path>.part"""
+
+    protocol_version = 'HTTP/1.1'
+    chunks = 0
+
+    def paths(self):
+        relative = os.path.normpath(self.path.split('?')[0]).lstrip('/')
+        if relative.startswith('..'):
+            return None, None
+        target = os.path.join(self.server.root, relative)
+        return target, target + '.part'
+
+    def held(self, target, part):
+        if os.path.exists(target):
+            return os.path.getsize(target)
+        if os.path.exists(part):
+            return os.path.getsize(part)
+        return None
+
+    def answer(self, status, offset=None):
+        self.send_response(status)
+        if offset is not None:
+            self.send_header('Upload-Offset', str(offset))
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
+    def do_HEAD(self):
+        target, part = self.paths()
+        offset = self.held(target, part) if target else None
+        self.answer(404 if offset is None else 200, offset)
+
+    def do_PATCH(self):
+        target, part = self.paths()
+        length = int(self.headers.get('Content-Length', 0))
+        if not target:
+            self.rfile.read(length)
+            self.answer(400)
+            return
+
+        held = self.held(target, part) or 0
+        offset = int(self.headers.get('Upload-Offset', -1))
+        total = int(self.headers.get('Upload-Length', -1))
+
+        DepotHandler.chunks += 1
+        if self.server.cut_every and DepotHandler.chunks % self.server.cut_every == 0:
+            self.rfile.read(length // 2)
+            self.log_message('cutting the connection in chunk %d', DepotHandler.chunks)
+            self.connection.shutdown(socket.SHUT_RDWR)
+            self.close_connection = True
+            return
+
+        body = self.rfile.read(length)
+        if len(body) < length:
+            self.close_connection = True  # Sender went away mid-chunk
+            return
+        if offset != held or os.path.exists(target):
+            self.answer(409, held)
+            return
+
+        algorithm, _, checksum = self.headers.get('Upload-Checksum', '').partition(' ')
+        if algorithm != 'crc32' or int(checksum, 16) != zlib.crc32(body):
+            self.log_message('chunk checksum mismatch at %d', offset)
+            self.answer(460, held)
+            return
+
+        os.makedirs(os.path.dirname(part), exist_ok=True)
+        with open(part, 'ab') as f:
+            f.write(body)
+        held += len(body)
+
+        if held == total:
+            crc = 0
+            with open(part, 'rb') as f:
+                for block in iter(lambda: f.read(1 << 20), b''):
+                    crc = zlib.crc32(block, crc)
+            if int(self.headers.get('Upload-CRC32', '-1'), 16) != crc:
+                self.log_message('file checksum mismatch, starting over')
+                os.remove(part)
+                self.answer(460, 0)
+                return
+            os.rename(part, target)
+            self.log_message('received %s (%d bytes)', self.path, held)
+
+        self.answer(204, held)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='PassFlow depot upload endpoint')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--root', default='./depot')
+    parser.add_argument('--cut-every', type=int, default=0)
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(('', args.port), DepotHandler)
+    server.root = os.path.abspath(args.root)
+    server.cut_every = args.cut_every
+    print('Depot listening on port %d, storing in %s' % (args.port, server.root))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()